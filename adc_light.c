@@ -0,0 +1,123 @@
+// Ambient light measurement ... see adc_light.h.
+//
+// About system_adc_read_fast: it is MUCH quicker than calling system_adc_read
+// in a loop, but the SDK only allows it while the radio is off (opmode NULL_MODE)
+// and with interrupts locked. Our unit is normally a softAP so most of the time we
+// have to fall back to the slow loop. We pick whichever is allowed for each burst.
+//
+// Every burst is timed with CCOUNT. With the fast read the burst time is exactly
+// how long WiFi was locked out; with the slow loop it is how long we held the CPU.
+// adc_light_report prints the worst burst and how much of the CPU the bursts use.
+
+#include "ets_sys.h"
+#include "osapi.h"
+#include "os_type.h"
+#include "user_interface.h"
+#include "adc_light.h"
+#include "user_config.h"
+#include "ccount.h"
+#include "typed_timer.h"
+
+LOCAL uint16 samples[ADC_LIGHT_BURST];
+LOCAL os_timer_t adc_timer;
+
+LOCAL uint16 light_level;         // filtered reading that set the current brightness
+LOCAL uint8 brightness = ADC_LIGHT_MAX_BRIGHTNESS;
+LOCAL bool have_level;
+
+// Burst statistics
+LOCAL uint32 bursts;
+LOCAL uint32 fast_bursts;
+LOCAL uint32 burst_cycles_last;
+LOCAL uint32 burst_cycles_max;
+
+// Fill samples[] one way or the other. Returns the time it took in CPU cycles.
+LOCAL uint32 ICACHE_FLASH_ATTR take_burst(void) {
+  uint32 start;
+  uint32 i;
+
+  if (wifi_get_opmode() == NULL_MODE) {
+    // Radio is off so we are allowed the fast read
+    system_soft_wdt_stop();
+    ets_intr_lock();
+    start = get_ccount();
+    system_adc_read_fast(samples, ADC_LIGHT_BURST, ADC_LIGHT_CLK_DIV);
+    start = get_ccount() - start;
+    ets_intr_unlock();
+    system_soft_wdt_restart();
+    fast_bursts++;
+    return start;
+  }
+
+  start = get_ccount();
+  for (i = 0; i < ADC_LIGHT_BURST; i++)
+    samples[i] = system_adc_read();
+  return get_ccount() - start;
+}
+
+// Sort the burst (insertion sort ... it's 32 values) and return the mean of the
+// middle values, dropping ADC_LIGHT_TRIM samples from each end. With a trim of
+// (ADC_LIGHT_BURST - 1) / 2 this is just the median.
+LOCAL uint16 ICACHE_FLASH_ATTR trimmed_mean(void) {
+  uint32 sum = 0;
+  uint32 i, j;
+  uint16 v;
+
+  for (i = 1; i < ADC_LIGHT_BURST; i++) {
+    v = samples[i];
+    for (j = i; j > 0 && samples[j - 1] > v; j--)
+      samples[j] = samples[j - 1];
+    samples[j] = v;
+  }
+
+  for (i = ADC_LIGHT_TRIM; i < ADC_LIGHT_BURST - ADC_LIGHT_TRIM; i++)
+    sum += samples[i];
+
+  return sum / (ADC_LIGHT_BURST - 2 * ADC_LIGHT_TRIM);
+}
+
+// Measure, filter and (maybe) update the brightness
+LOCAL void ICACHE_FLASH_ATTR adc_timer_function(void *arg) {
+  uint32 cycles = take_burst();
+  uint16 level = trimmed_mean();
+
+  bursts++;
+  burst_cycles_last = cycles;
+  if (cycles > burst_cycles_max)
+    burst_cycles_max = cycles;
+
+  // Hysteresis ... only move when the light has changed by a fair bit
+  if (have_level && level + ADC_LIGHT_HYSTERESIS > light_level &&
+      level < light_level + ADC_LIGHT_HYSTERESIS)
+    return;
+
+  if (level > 1023)
+    level = 1023;
+
+  have_level = true;
+  light_level = level;
+  brightness = ADC_LIGHT_MIN_BRIGHTNESS +
+               (uint32)level * (ADC_LIGHT_MAX_BRIGHTNESS - ADC_LIGHT_MIN_BRIGHTNESS) / 1023;
+  adc_light_report();
+}
+
+void ICACHE_FLASH_ATTR adc_light_init(void) {
+  os_timer_disarm(&adc_timer);
+  TYPED_TIMER_SETFN(&adc_timer, adc_timer_function, NULL);
+  os_timer_arm(&adc_timer, ADC_LIGHT_PERIOD_MS, 1);
+  adc_timer_function(NULL);
+}
+
+// Current LED brightness setpoint (0 - 255)
+uint8 ICACHE_FLASH_ATTR adc_light_brightness(void) {
+  return brightness;
+}
+
+void ICACHE_FLASH_ATTR adc_light_report(void) {
+  uint32 mhz = system_get_cpu_freq();
+
+  os_printf("adc light: level %u, brightness %u, %u bursts (%u fast), burst %u us (max %u us), cpu %u permille\n",
+            light_level, brightness, bursts, fast_bursts,
+            burst_cycles_last / mhz, burst_cycles_max / mhz,
+            burst_cycles_last / mhz / ADC_LIGHT_PERIOD_MS);
+}
@@ -0,0 +1,19 @@
+// Ambient light measurement on the ADC (TOUT) pin, used to dim the LED at night.
+// A light sensor divider (an LDR and a resistor) goes on TOUT so that more light
+// means a higher reading. Every ADC_LIGHT_PERIOD_MS we take a burst of samples,
+// filter them and turn the result into an LED brightness with some hysteresis so
+// the LED doesn't flicker when the light level sits right at a boundary.
+//
+// NOTE: the ADC only reads TOUT (and not VDD33) if byte 107 of esp_init_data
+// is set to 33 or less ... that's the default for most modules.
+
+#ifndef ADC_LIGHT_H
+#define ADC_LIGHT_H
+
+#include "c_types.h"
+
+void adc_light_init(void);
+uint8 adc_light_brightness(void);
+void adc_light_report(void);
+
+#endif
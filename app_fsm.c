@@ -0,0 +1,151 @@
+// softAP lifecycle state machine ... see app_fsm.h.
+//
+// The transition table is const and marked ICACHE_RODATA_ATTR so it lives in
+// flash instead of eating RAM. Careful: the ESP8266 can only read flash 32 bits at
+// a time, so every field of a table entry is 32 bits wide (no uint8 in there or
+// you get a LoadStoreError exception).
+//
+// Dispatching is one table lookup and one indirect call. Every dispatch is put in a
+// small ring log with a timestamp and its cost in CPU cycles, so you can see what
+// happened (and how long it took) with app_fsm_report.
+
+#include "ets_sys.h"
+#include "osapi.h"
+#include "user_interface.h"
+#include "app_fsm.h"
+#include "ccount.h"
+
+typedef void (*app_action_t)(void);
+
+struct transition {
+  app_action_t action;
+  uint32 next;
+};
+
+// Shorthands to keep the table readable
+#define T(action, next)  { app_action_##action, next }
+#define STAY(state)      { app_action_none, state }
+
+LOCAL const struct transition transitions[APP_STATE_COUNT][APP_EVENT_COUNT] ICACHE_RODATA_ATTR STORE_ATTR = {
+  // APP_BOOTING
+  {
+    T(ap_up, APP_AP_IDLE),                  // INIT_DONE
+    STAY(APP_BOOTING),                      // STA_CONNECTED
+    STAY(APP_BOOTING),                      // STA_LEFT
+    STAY(APP_BOOTING),                      // NO_CLIENTS
+    T(degraded, APP_DEGRADED),              // FAULT
+    STAY(APP_BOOTING),                      // RECOVERED
+    STAY(APP_BOOTING),                      // SLEEP
+    STAY(APP_BOOTING),                      // WAKE
+  },
+  // APP_AP_IDLE
+  {
+    STAY(APP_AP_IDLE),                      // INIT_DONE
+    T(client_joined, APP_SERVING),          // STA_CONNECTED
+    STAY(APP_AP_IDLE),                      // STA_LEFT
+    STAY(APP_AP_IDLE),                      // NO_CLIENTS
+    T(degraded, APP_DEGRADED),              // FAULT
+    STAY(APP_AP_IDLE),                      // RECOVERED
+    T(sleep, APP_SLEEPING),                 // SLEEP
+    STAY(APP_AP_IDLE),                      // WAKE
+  },
+  // APP_SERVING
+  {
+    STAY(APP_SERVING),                      // INIT_DONE
+    T(client_joined, APP_SERVING),          // STA_CONNECTED
+    STAY(APP_SERVING),                      // STA_LEFT
+    T(all_left, APP_AP_IDLE),               // NO_CLIENTS
+    T(degraded, APP_DEGRADED),              // FAULT
+    STAY(APP_SERVING),                      // RECOVERED
+    STAY(APP_SERVING),                      // SLEEP (not while clients are here)
+    STAY(APP_SERVING),                      // WAKE
+  },
+  // APP_DEGRADED
+  {
+    STAY(APP_DEGRADED),                     // INIT_DONE
+    STAY(APP_DEGRADED),                     // STA_CONNECTED
+    STAY(APP_DEGRADED),                     // STA_LEFT
+    STAY(APP_DEGRADED),                     // NO_CLIENTS
+    STAY(APP_DEGRADED),                     // FAULT
+    T(recovered, APP_AP_IDLE),              // RECOVERED
+    STAY(APP_DEGRADED),                     // SLEEP
+    STAY(APP_DEGRADED),                     // WAKE
+  },
+  // APP_SLEEPING
+  {
+    STAY(APP_SLEEPING),                     // INIT_DONE
+    T(client_joined, APP_SERVING),          // STA_CONNECTED
+    STAY(APP_SLEEPING),                     // STA_LEFT
+    STAY(APP_SLEEPING),                     // NO_CLIENTS
+    T(degraded, APP_DEGRADED),              // FAULT
+    STAY(APP_SLEEPING),                     // RECOVERED
+    STAY(APP_SLEEPING),                     // SLEEP
+    T(wake, APP_AP_IDLE),                   // WAKE
+  },
+};
+
+#if (APP_FSM_LOG_SIZE & (APP_FSM_LOG_SIZE - 1)) != 0
+#error "APP_FSM_LOG_SIZE must be a power of two"
+#endif
+
+LOCAL uint8 state;
+LOCAL struct app_fsm_log_entry fsm_log[APP_FSM_LOG_SIZE];
+LOCAL uint32 log_next;
+LOCAL uint32 dispatches;
+LOCAL uint32 dispatch_cycles_max;
+
+// The do-nothing action for transitions that only change (or keep) the state
+void ICACHE_FLASH_ATTR app_action_none(void) {
+}
+
+void ICACHE_FLASH_ATTR app_fsm_init(void) {
+  state = APP_BOOTING;
+  log_next = 0;
+  dispatches = 0;
+  dispatch_cycles_max = 0;
+}
+
+// Run the action for (state, event) and move to the next state. Events we don't
+// know are ignored.
+void ICACHE_FLASH_ATTR app_fsm_dispatch(uint8 event) {
+  uint32 start = get_ccount();
+  uint32 time_us = system_get_time();
+  const struct transition *t;
+  struct app_fsm_log_entry *entry;
+  uint8 from = state;
+
+  if (event >= APP_EVENT_COUNT)
+    return;
+
+  t = &transitions[state][event];
+  t->action();
+  state = t->next;
+
+  entry = &fsm_log[log_next++ & (APP_FSM_LOG_SIZE - 1)];
+  entry->time_us = time_us;
+  entry->from = from;
+  entry->event = event;
+  entry->to = state;
+  entry->cycles = get_ccount() - start;
+
+  dispatches++;
+  if (entry->cycles > dispatch_cycles_max)
+    dispatch_cycles_max = entry->cycles;
+}
+
+uint8 ICACHE_FLASH_ATTR app_fsm_state(void) {
+  return state;
+}
+
+// Print the transition log (oldest first) and the dispatch cost
+void ICACHE_FLASH_ATTR app_fsm_report(void) {
+  uint32 mhz = system_get_cpu_freq();
+  uint32 first = (log_next > APP_FSM_LOG_SIZE) ? log_next - APP_FSM_LOG_SIZE : 0;
+  uint32 i;
+
+  os_printf("fsm: state %d, %u dispatches, max %u cycles\n", state, dispatches, dispatch_cycles_max);
+  for (i = first; i < log_next; i++) {
+    struct app_fsm_log_entry *e = &fsm_log[i & (APP_FSM_LOG_SIZE - 1)];
+    os_printf("  %u us: %d --%d--> %d (%u us)\n", e->time_us, e->from, e->event, e->to, e->cycles / mhz);
+  }
+}
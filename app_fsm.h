@@ -0,0 +1,63 @@
+// The softAP lifecycle as an explicit state machine. Instead of spreading the
+// "what do we do now" logic across user_init, init_done_callback and the WiFi
+// event handler, everything that happens is turned into an event and handed to
+// app_fsm_dispatch. A table indexed by [state][event] says which action to run
+// and which state we end up in.
+//
+// The actions themselves live next to the code they drive (in user_main.c) and
+// are declared at the bottom of this file.
+
+#ifndef APP_FSM_H
+#define APP_FSM_H
+
+#include "c_types.h"
+
+enum app_state {
+  APP_BOOTING,      // waiting for the SDK to finish its init
+  APP_AP_IDLE,      // softAP up, nobody connected
+  APP_SERVING,      // at least one client connected
+  APP_DEGRADED,     // something went wrong, limping along
+  APP_SLEEPING,     // power saving
+  APP_STATE_COUNT
+};
+
+enum app_event {
+  APP_EV_INIT_DONE,       // system init done, softAP configured
+  APP_EV_STA_CONNECTED,   // a client joined
+  APP_EV_STA_LEFT,        // a client left but others are still here
+  APP_EV_NO_CLIENTS,      // the last client left
+  APP_EV_FAULT,           // the softAP config failed
+  APP_EV_RECOVERED,       // ... and worked on a retry
+  APP_EV_SLEEP,           // nobody around for a while (power.c)
+  APP_EV_WAKE,            // a probe request while sleeping (power.c)
+  APP_EVENT_COUNT
+};
+
+// One entry of the transition log
+struct app_fsm_log_entry {
+  uint32 time_us;         // system_get_time() when the event came in
+  uint32 cycles;          // how long the dispatch took (CPU cycles)
+  uint8 from;
+  uint8 event;
+  uint8 to;
+  uint8 pad;
+};
+
+#define APP_FSM_LOG_SIZE  16
+
+void app_fsm_init(void);
+void app_fsm_dispatch(uint8 event);
+uint8 app_fsm_state(void);
+void app_fsm_report(void);
+
+// Actions (see user_main.c)
+void app_action_none(void);
+void app_action_ap_up(void);
+void app_action_client_joined(void);
+void app_action_all_left(void);
+void app_action_degraded(void);
+void app_action_recovered(void);
+void app_action_sleep(void);
+void app_action_wake(void);
+
+#endif
@@ -0,0 +1,198 @@
+// Captive portal DNS ... see captive_dns.h.
+//
+// A DNS message is a 12 byte header, the question (the name as length prefixed
+// labels, then type and class) and whatever records follow. Our answer is the
+// header and question of the query with:
+//   flags    QR (it's an answer) and AA set, RD copied, everything else 0
+//   counts   1 answer (or 0 if it's not an A question), nothing else ... so any
+//            EDNS record the phone sent after the question is left off
+//   answer   c0 0c (pointer to the name in the question), type A, class IN,
+//            the TTL, length 4 and our address
+//
+// Before a tx pbuf gets used again its payload pointer goes back to where it was
+// when we allocated it: udp_sendto moves it to put the headers in front.
+
+#include "ets_sys.h"
+#include "osapi.h"
+#include "user_interface.h"
+#include "lwip/pbuf.h"
+#include "lwip/udp.h"
+#include "captive_dns.h"
+#include "ccount.h"
+
+#define HEADER_LEN     12
+#define ANSWER_LEN     16
+#define TYPE_A         1
+#define TYPE_ANY       255
+#define CLASS_IN       1
+
+LOCAL struct udp_pcb *dns_pcb;
+LOCAL struct pbuf *tx_pbufs[CAPTIVE_DNS_TX_PBUFS];
+LOCAL void *tx_payloads[CAPTIVE_DNS_TX_PBUFS];
+LOCAL uint8 ap_addr[4];
+
+LOCAL struct {
+  uint32 queries;
+  uint32 answers;
+  uint32 bad;          // not a query we understand
+  uint32 busy;         // every tx pbuf still on its way out
+  uint32 cycles_max;   // one query, in to out
+  uint32 second;       // which second we're counting in
+  uint32 this_second;
+  uint32 peak_qps;
+} dns_stats;
+
+// A tx pbuf nobody else holds (the driver has let go of it), CAPTIVE_DNS_TX_PBUFS
+// if there isn't one
+LOCAL uint8 ICACHE_FLASH_ATTR free_tx(void) {
+  uint8 i;
+
+  for (i = 0; i < CAPTIVE_DNS_TX_PBUFS; i++)
+    if (tx_pbufs[i]->ref == 1)
+      return i;
+  return CAPTIVE_DNS_TX_PBUFS;
+}
+
+// Where the question ends (after type and class), 0 if it runs off the end of the
+// message or isn't a name
+LOCAL uint16 ICACHE_FLASH_ATTR question_end(const uint8 *msg, uint16 len) {
+  uint16 pos = HEADER_LEN;
+
+  while (pos < len && msg[pos] != 0) {
+    if (msg[pos] > 63)          // compression pointer or junk, not in a question
+      return 0;
+    pos += msg[pos] + 1;
+  }
+  pos += 1 + 4;                 // the 0 at the end of the name, type and class
+  return pos <= len ? pos : 0;
+}
+
+// Count queries per second to find the peak
+LOCAL void ICACHE_FLASH_ATTR count_query(void) {
+  uint32 second = system_get_time() / 1000000;
+
+  if (second != dns_stats.second) {
+    dns_stats.second = second;
+    dns_stats.this_second = 0;
+  }
+  if (++dns_stats.this_second > dns_stats.peak_qps)
+    dns_stats.peak_qps = dns_stats.this_second;
+  dns_stats.queries++;
+}
+
+// lwIP calls this for every datagram to port 53. We own p and have to free it.
+LOCAL void ICACHE_FLASH_ATTR dns_recv(void *arg, struct udp_pcb *pcb, struct pbuf *p,
+                                      ip_addr_t *addr, u16_t port) {
+  uint32 start = get_ccount();
+  const uint8 *query = p->payload;
+  uint16 len = p->len;         // a query fits in one pbuf, anything chained is junk to us
+  uint16 end;
+  uint8 *answer;
+  uint8 tx;
+  bool want_a;
+
+  count_query();
+
+  // A standard query (QR 0, opcode 0) with exactly one question
+  if (len < HEADER_LEN || (query[2] & 0xf8) != 0 || query[4] != 0 || query[5] != 1 ||
+      (end = question_end(query, len)) == 0 || end + ANSWER_LEN > CAPTIVE_DNS_MAX_LEN) {
+    dns_stats.bad++;
+    pbuf_free(p);
+    return;
+  }
+
+  tx = free_tx();
+  if (tx == CAPTIVE_DNS_TX_PBUFS) {
+    dns_stats.busy++;
+    pbuf_free(p);
+    return;
+  }
+
+  // Header and question as they came
+  answer = tx_payloads[tx];
+  os_memcpy(answer, query, end);
+  want_a = query[end - 4] == 0 && (query[end - 3] == TYPE_A || query[end - 3] == TYPE_ANY) &&
+           query[end - 2] == 0 && query[end - 1] == CLASS_IN;
+  pbuf_free(p);
+
+  answer[2] = 0x84 | (answer[2] & 0x01);    // QR, AA, RD as asked
+  answer[3] = 0;                            // no RA, no error
+  answer[6] = 0;
+  answer[7] = want_a ? 1 : 0;               // answers
+  os_bzero(&answer[8], 4);                  // no authority, no additional
+
+  if (want_a) {
+    uint8 *rr = &answer[end];
+
+    rr[0] = 0xc0;                           // the name is the one at offset 12
+    rr[1] = HEADER_LEN;
+    rr[2] = 0;
+    rr[3] = TYPE_A;
+    rr[4] = 0;
+    rr[5] = CLASS_IN;
+    rr[6] = CAPTIVE_DNS_TTL >> 24;
+    rr[7] = CAPTIVE_DNS_TTL >> 16;
+    rr[8] = CAPTIVE_DNS_TTL >> 8;
+    rr[9] = CAPTIVE_DNS_TTL & 0xff;
+    rr[10] = 0;
+    rr[11] = 4;
+    os_memcpy(&rr[12], ap_addr, 4);
+    end += ANSWER_LEN;
+  }
+
+  tx_pbufs[tx]->payload = tx_payloads[tx];
+  tx_pbufs[tx]->len = end;
+  tx_pbufs[tx]->tot_len = end;
+  if (udp_sendto(pcb, tx_pbufs[tx], addr, port) == ERR_OK)
+    dns_stats.answers++;
+
+  start = get_ccount() - start;
+  if (start > dns_stats.cycles_max)
+    dns_stats.cycles_max = start;
+}
+
+// Start answering on the softAP address (call once the softAP is up). False if
+// lwIP hasn't got the memory ... this is the only time we ask it for any.
+bool ICACHE_FLASH_ATTR captive_dns_start(void) {
+  struct ip_info info;
+  uint8 i;
+
+  if (dns_pcb != NULL)
+    return true;
+
+  wifi_get_ip_info(SOFTAP_IF, &info);
+  os_memcpy(ap_addr, &info.ip.addr, 4);
+
+  for (i = 0; i < CAPTIVE_DNS_TX_PBUFS; i++) {
+    tx_pbufs[i] = pbuf_alloc(PBUF_TRANSPORT, CAPTIVE_DNS_MAX_LEN, PBUF_RAM);
+    if (tx_pbufs[i] == NULL) {
+      os_printf("captive dns: no memory for the tx pbufs\n");
+      while (i > 0)
+        pbuf_free(tx_pbufs[--i]);
+      return false;
+    }
+    tx_payloads[i] = tx_pbufs[i]->payload;
+  }
+
+  // Bound to the softAP address only, so it doesn't answer on any other interface
+  dns_pcb = udp_new();
+  if (dns_pcb == NULL || udp_bind(dns_pcb, (ip_addr_t *)&info.ip, CAPTIVE_DNS_PORT) != ERR_OK) {
+    os_printf("captive dns: can't bind port %u\n", CAPTIVE_DNS_PORT);
+    if (dns_pcb != NULL)
+      udp_remove(dns_pcb);
+    dns_pcb = NULL;
+    for (i = 0; i < CAPTIVE_DNS_TX_PBUFS; i++)
+      pbuf_free(tx_pbufs[i]);
+    return false;
+  }
+  udp_recv(dns_pcb, dns_recv, NULL);
+
+  os_printf("captive dns: answering with " IPSTR "\n", IP2STR(&info.ip));
+  return true;
+}
+
+void ICACHE_FLASH_ATTR captive_dns_report(void) {
+  os_printf("captive dns: %u queries, %u answered, %u bad, %u dropped (busy), peak %u/s, "
+            "max %u us per query\n", dns_stats.queries, dns_stats.answers, dns_stats.bad,
+            dns_stats.busy, dns_stats.peak_qps, dns_stats.cycles_max / system_get_cpu_freq());
+}
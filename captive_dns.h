@@ -0,0 +1,27 @@
+// Captive portal DNS: answer every A query that reaches the softAP with our own
+// address, so whatever name a phone looks up it ends up at us. Other query types
+// (AAAA and friends) get an empty answer, which makes the phone fall back to A.
+//
+// It talks to lwIP directly (the raw UDP API) instead of going through espconn,
+// and it never allocates while running:
+//   - the query is read straight out of the pbuf lwIP hands us
+//   - the answer is the query copied into one of CAPTIVE_DNS_TX_PBUFS pbufs we
+//     allocated at start, with the flags patched and the answer record added
+// The WiFi driver holds on to a pbuf until it's on the air, so with a burst of
+// queries the next one may not be free yet. Then the query is dropped (and
+// counted) ... the phone asks again.
+
+#ifndef CAPTIVE_DNS_H
+#define CAPTIVE_DNS_H
+
+#include "c_types.h"
+
+#define CAPTIVE_DNS_PORT       53
+#define CAPTIVE_DNS_TX_PBUFS   4
+#define CAPTIVE_DNS_MAX_LEN    256    // biggest answer we send (query + 16 bytes)
+#define CAPTIVE_DNS_TTL        60     // seconds
+
+bool captive_dns_start(void);
+void captive_dns_report(void);
+
+#endif
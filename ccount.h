@@ -0,0 +1,32 @@
+// Cycle counter helper. The lx106 core has a free running 32 bit counter
+// (the CCOUNT special register) that increments once per CPU clock, so at
+// 80MHz it wraps roughly every 53 seconds. It is the cheapest and most accurate
+// way we have to time short stretches of code or stamp interrupts.
+//
+// Always subtract two readings (later - earlier) as uint32 ... the unsigned
+// math takes care of the wrap for us as long as the interval is shorter
+// than one full wrap.
+
+#ifndef CCOUNT_H
+#define CCOUNT_H
+
+#include "c_types.h"
+
+#ifdef __XTENSA__
+
+// Read CCOUNT. It's inline because calling a function to read one register
+// would cost more than the read itself.
+static inline uint32 get_ccount(void) {
+  uint32 ccount;
+  __asm__ __volatile__("rsr %0, ccount" : "=a"(ccount));
+  return ccount;
+}
+
+#else
+
+// Host builds (test/host) have no CCOUNT, the fake SDK counts instead
+uint32 get_ccount(void);
+
+#endif
+
+#endif
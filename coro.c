@@ -0,0 +1,278 @@
+// Stackless coroutines ... see coro.h.
+//
+// Every coroutine that is running sits in coros[]. When one is ready to run we
+// post BIT(its index) to our task (a client on TASK_PRIO_NORMAL, see tasks.h) and
+// the task calls it. Bits, because posts can get coalesced when the queue is full. Waiting coroutines
+// are woken by coro_signal (events), by the wake timer (timeouts) or by a
+// coro_queue_put.
+//
+// There is just ONE os_timer for all the timeouts, always armed for the earliest
+// deadline.
+
+#include "ets_sys.h"
+#include "osapi.h"
+#include "os_type.h"
+#include "user_interface.h"
+#include "coro.h"
+#include "typed_timer.h"
+#include "ccount.h"
+#include "tasks.h"
+
+#define SIG_BENCH         BIT31  // used by coro_bench for the plain callback run
+
+enum {
+  CORO_IDLE,
+  CORO_READY,       // posted, waiting for the task to run it
+  CORO_SLEEPING     // waiting for an event, a timeout or a queue
+};
+
+LOCAL struct coro *coros[CORO_MAX];
+LOCAL sint8 task_client = -1;
+LOCAL os_timer_t wake_timer;
+
+// Benchmark state
+LOCAL struct coro bench_coro;
+LOCAL uint32 bench_steps;
+LOCAL uint32 bench_left;
+LOCAL uint32 bench_start;
+
+LOCAL uint32 ICACHE_FLASH_ATTR now_ms(void) {
+  return system_get_time() / 1000;
+}
+
+// Post a coroutine to the task (only once, however often we are asked)
+LOCAL void ICACHE_FLASH_ATTR make_ready(uint8 idx) {
+  struct coro *c = coros[idx];
+
+  if (c->state == CORO_READY)
+    return;
+  c->state = CORO_READY;
+  if (task_client >= 0)
+    task_post(TASK_PRIO_NORMAL, task_client, BIT(idx));
+}
+
+LOCAL sint8 ICACHE_FLASH_ATTR find(struct coro *c) {
+  sint8 i;
+
+  for (i = 0; i < CORO_MAX; i++)
+    if (coros[i] == c)
+      return i;
+  return -1;
+}
+
+// Arm the wake timer for the earliest deadline (if anybody has one)
+LOCAL void ICACHE_FLASH_ATTR rearm(void) {
+  uint32 now = now_ms();
+  sint32 earliest = 0x7fffffff;
+  uint32 i;
+
+  os_timer_disarm(&wake_timer);
+  for (i = 0; i < CORO_MAX; i++) {
+    struct coro *c = coros[i];
+    if (c != NULL && c->state == CORO_SLEEPING && c->deadline != 0) {
+      sint32 left = (sint32)(c->deadline - now);
+      if (left < earliest)
+        earliest = left;
+    }
+  }
+
+  if (earliest != 0x7fffffff)
+    os_timer_arm(&wake_timer, earliest > 0 ? earliest : 1, 0);
+}
+
+// Wake timer: everybody whose deadline has passed gets to run (woken by timeout,
+// so events = 0)
+LOCAL void ICACHE_FLASH_ATTR wake_timer_function(void *arg) {
+  uint32 now = now_ms();
+  uint32 i;
+
+  for (i = 0; i < CORO_MAX; i++) {
+    struct coro *c = coros[i];
+    if (c != NULL && c->state == CORO_SLEEPING && c->deadline != 0 &&
+        (sint32)(now - c->deadline) >= 0) {
+      c->events = 0;
+      make_ready(i);
+    }
+  }
+  rearm();
+}
+
+// Run one coroutine until it waits, yields or finishes
+LOCAL void ICACHE_FLASH_ATTR run(uint8 idx) {
+  struct coro *c = coros[idx];
+  uint8 result;
+
+  c->state = CORO_IDLE;
+  result = c->fn(c);
+
+  switch (result) {
+    case CORO_DONE:
+      coros[idx] = NULL;
+      break;
+    case CORO_YIELDED:
+      make_ready(idx);
+      break;
+    default:
+      // coro_wait already set us up to sleep
+      if (c->deadline != 0)
+        rearm();
+      break;
+  }
+}
+
+LOCAL uint8 bench_coro_fn(struct coro *c);
+
+// Plain callback version of the benchmark loop, to compare against
+LOCAL void ICACHE_FLASH_ATTR bench_callback_step(void) {
+  if (--bench_left != 0) {
+    task_post(TASK_PRIO_NORMAL, task_client, SIG_BENCH);
+    return;
+  }
+  os_printf("coro bench: callback %u cycles/step\n", (get_ccount() - bench_start) / bench_steps);
+
+  // Now the same number of steps as a coroutine (see bench_coro_fn)
+  bench_left = bench_steps;
+  bench_start = get_ccount();
+  coro_start(&bench_coro, bench_coro_fn);
+}
+
+// The task. Every bit in par is a coroutine to run.
+LOCAL void ICACHE_FLASH_ATTR coro_task(uint32 par) {
+  uint32 i;
+
+  if (par & SIG_BENCH)
+    bench_callback_step();
+
+  for (i = 0; i < CORO_MAX; i++)
+    if ((par & BIT(i)) && coros[i] != NULL && coros[i]->state == CORO_READY)
+      run(i);
+}
+
+void ICACHE_FLASH_ATTR coro_init(void) {
+  os_bzero(coros, sizeof(coros));
+  task_client = task_register(TASK_PRIO_NORMAL, coro_task);
+  os_timer_disarm(&wake_timer);
+  TYPED_TIMER_SETFN(&wake_timer, wake_timer_function, NULL);
+}
+
+// Start fn as a coroutine (from the top). If c is already running it starts
+// over. Returns false if all CORO_MAX slots are taken.
+bool ICACHE_FLASH_ATTR coro_start(struct coro *c, coro_fn_t fn) {
+  sint8 idx = find(c);
+
+  if (idx < 0)
+    idx = find(NULL);
+  if (idx < 0)
+    return false;
+
+  c->lc = 0;
+  c->events = 0;
+  c->pending = 0;
+  c->deadline = 0;
+  c->state = CORO_IDLE;
+  c->fn = fn;
+  coros[idx] = c;
+  make_ready(idx);
+  return true;
+}
+
+// Stop a coroutine wherever it is
+void ICACHE_FLASH_ATTR coro_stop(struct coro *c) {
+  sint8 idx = find(c);
+
+  if (idx >= 0)
+    coros[idx] = NULL;
+}
+
+// Has c been started and not finished or been stopped yet?
+bool ICACHE_FLASH_ATTR coro_running(struct coro *c) {
+  return find(c) >= 0;
+}
+
+// Signal events to every running coroutine. The ones waiting for any of them
+// wake up. Everybody else keeps them in pending, whatever they're doing (waiting
+// for a timer, posted and not run yet), for the next wait that asks for them.
+void ICACHE_FLASH_ATTR coro_signal(uint8 events) {
+  uint32 i;
+
+  for (i = 0; i < CORO_MAX; i++) {
+    struct coro *c = coros[i];
+    if (c == NULL)
+      continue;
+    c->pending |= events;
+    if (c->state == CORO_SLEEPING && (c->events & c->pending)) {
+      c->events &= c->pending;
+      c->pending &= ~c->events;
+      c->deadline = 0;
+      make_ready(i);
+    }
+  }
+}
+
+// Used by the CORO_WAIT macros: go to sleep until one of the events, the timeout
+// or an explicit wake up. If one of the events is pending already they're taken
+// (and left in c->events) right away: returns true and doesn't sleep.
+bool ICACHE_FLASH_ATTR coro_wait(struct coro *c, uint8 events, uint32 ms) {
+  if (c->pending & events) {
+    c->events = c->pending & events;
+    c->pending &= ~events;
+    c->deadline = 0;
+    return true;
+  }
+
+  c->events = events;
+  c->deadline = 0;
+  if (ms != 0) {
+    c->deadline = now_ms() + ms;
+    if (c->deadline == 0)
+      c->deadline = 1;
+  }
+  c->state = CORO_SLEEPING;
+  return false;
+}
+
+// Put an item in a queue and wake whoever is waiting on it. Returns false if
+// the queue is full.
+bool ICACHE_FLASH_ATTR coro_queue_put(struct coro_queue *q, uint32 item) {
+  sint8 idx;
+
+  if ((uint8)(q->head - q->tail) >= CORO_QUEUE_SIZE)
+    return false;
+  q->items[q->head++ & (CORO_QUEUE_SIZE - 1)] = item;
+
+  if (q->waiter != NULL) {
+    idx = find(q->waiter);
+    q->waiter = NULL;
+    if (idx >= 0 && coros[idx]->state == CORO_SLEEPING)
+      make_ready(idx);
+  }
+  return true;
+}
+
+bool ICACHE_FLASH_ATTR coro_queue_get(struct coro_queue *q, uint32 *item) {
+  if (q->head == q->tail)
+    return false;
+  *item = q->items[q->tail++ & (CORO_QUEUE_SIZE - 1)];
+  return true;
+}
+
+// The coroutine side of the benchmark: just yield bench_left times
+LOCAL uint8 ICACHE_FLASH_ATTR bench_coro_fn(struct coro *c) {
+  CORO_BEGIN(c);
+  while (--bench_left != 0)
+    CORO_YIELD(c);
+  os_printf("coro bench: coroutine %u cycles/step\n", (get_ccount() - bench_start) / bench_steps);
+  CORO_END(c);
+}
+
+// Compare the cost of one step through a coroutine (resume, yield, repost) with a
+// hand written callback that reposts itself. Both go through the same task, so
+// the difference is the coroutine overhead. Prints the results when done.
+void ICACHE_FLASH_ATTR coro_bench(uint32 steps) {
+  if (steps == 0 || task_client < 0)
+    return;
+  bench_steps = steps;
+  bench_left = steps;
+  bench_start = get_ccount();
+  task_post(TASK_PRIO_NORMAL, task_client, SIG_BENCH);
+}
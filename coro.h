@@ -0,0 +1,106 @@
+// Stackless coroutines (protothreads style) on top of the task layer (tasks.h).
+//
+// Chains of callbacks (user_init -> init_done_callback -> event handler -> timer)
+// get hard to follow once a behaviour has more than one step. A coroutine lets
+// you write the steps one after the other:
+//
+//   LOCAL uint8 ICACHE_FLASH_ATTR hello(struct coro *c) {
+//     CORO_BEGIN(c);
+//     led_on();
+//     CORO_AWAIT_TIMER(c, 500);           // come back in 500ms
+//     led_off();
+//     CORO_AWAIT_EVENT(c, MY_EVENT);      // come back on coro_signal(MY_EVENT)
+//     ...
+//     CORO_END(c);
+//   }
+//
+// How it works: CORO_BEGIN is a switch on the line number we stopped at and every
+// await is a "case __LINE__:" so calling the function again jumps right back in.
+// That's why there's no stack to save, and also why LOCAL VARIABLES DON'T SURVIVE
+// AN AWAIT ... keep anything you need across an await in a static or a struct.
+// Also no switch statements of your own around an await.
+//
+// Events are latched: a coro_signal that comes while the coroutine is busy with
+// something else (a CORO_AWAIT_TIMER, say) is kept in pending, and the next
+// CORO_WAIT for that event returns straight away instead of sleeping.
+//
+// A coroutine costs 16 bytes of RAM (struct coro) plus a slot in the scheduler.
+
+#ifndef CORO_H
+#define CORO_H
+
+#include "c_types.h"
+
+#define CORO_MAX          4     // coroutines that can run at the same time
+#define CORO_QUEUE_SIZE   8     // items in a coro_queue (power of two)
+
+// What a coroutine function returns (the macros take care of it)
+#define CORO_WAITING  0
+#define CORO_YIELDED  1
+#define CORO_DONE     2
+
+struct coro;
+typedef uint8 (*coro_fn_t)(struct coro *c);
+
+struct coro {
+  uint16 lc;          // line to resume at
+  uint8 events;       // while waiting: events we wait for. After: events that woke us (0 = timeout)
+  uint8 state;
+  uint8 pending;      // events signalled that no wait has taken yet
+  uint32 deadline;    // wake up time in ms (0 = no timeout)
+  coro_fn_t fn;
+};
+
+// A small mailbox a coroutine can wait on
+struct coro_queue {
+  uint32 items[CORO_QUEUE_SIZE];
+  uint8 head;
+  uint8 tail;
+  struct coro *waiter;
+};
+
+#define CORO_BEGIN(c)   switch ((c)->lc) { case 0:
+#define CORO_END(c)     } (c)->lc = 0; return CORO_DONE
+
+// Wait for any of the events in ev, or ms milliseconds, whichever comes first.
+// Either can be 0 (no events / no timeout). Doesn't wait at all if one of the
+// events is pending already.
+#define CORO_WAIT(c, ev, ms)                                         \
+  do {                                                               \
+    (c)->lc = __LINE__;                                              \
+    if (!coro_wait((c), (ev), (ms)))                                 \
+      return CORO_WAITING;                                           \
+    case __LINE__:;                                                  \
+  } while (0)
+
+#define CORO_AWAIT_TIMER(c, ms)   CORO_WAIT(c, 0, ms)
+#define CORO_AWAIT_EVENT(c, ev)   CORO_WAIT(c, ev, 0)
+
+// Wait until there is something in the queue and take it out into item
+#define CORO_AWAIT_QUEUE(c, q, item)                                 \
+  do {                                                               \
+    (c)->lc = __LINE__; case __LINE__:                               \
+    if (!coro_queue_get((q), &(item))) {                             \
+      (q)->waiter = (c);                                             \
+      coro_wait((c), 0, 0);                                          \
+      return CORO_WAITING;                                           \
+    }                                                                \
+  } while (0)
+
+// Let everybody else run and come straight back
+#define CORO_YIELD(c)                                                \
+  do {                                                               \
+    (c)->lc = __LINE__; return CORO_YIELDED; case __LINE__:;         \
+  } while (0)
+
+void coro_init(void);
+bool coro_start(struct coro *c, coro_fn_t fn);
+void coro_stop(struct coro *c);
+bool coro_running(struct coro *c);
+void coro_signal(uint8 events);
+bool coro_wait(struct coro *c, uint8 events, uint32 ms);
+bool coro_queue_put(struct coro_queue *q, uint32 item);
+bool coro_queue_get(struct coro_queue *q, uint32 *item);
+void coro_bench(uint32 steps);
+
+#endif
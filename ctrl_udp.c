@@ -0,0 +1,300 @@
+// UDP control service ... see ctrl_udp.h.
+//
+// Requests come in one pbuf (they're a few bytes). Anything chained is ignored
+// past the first pbuf, that's more than any request we know.
+//
+// A tx slot is a static buffer and the PBUF_REF pbuf pointing at it. While the
+// driver still has the reply (the header pbuf lwIP put in front holds a
+// reference to ours) the slot is busy; with all of them busy a request gets no
+// answer and is counted, the client asks again.
+
+#include "ets_sys.h"
+#include "osapi.h"
+#include "user_interface.h"
+#include "espconn.h"
+#include "lwip/pbuf.h"
+#include "lwip/udp.h"
+#include "user_config.h"
+#include "ctrl_udp.h"
+#include "softap_tune.h"
+#include "mac_filter.h"
+#include "ccount.h"
+
+// What one path (raw lwIP or espconn) has done so far
+struct path_stats {
+  uint32 requests;
+  uint32 dropped;        // no tx slot free
+  uint32 cycles_sum;     // receive callback to reply sent
+  uint32 cycles_max;
+  uint32 held_sum;       // heap still out when we returned, bytes
+  uint32 heap_min;
+};
+
+LOCAL struct udp_pcb *ctrl_pcb;
+LOCAL struct pbuf *tx_pbufs[CTRL_UDP_TX_SLOTS];
+LOCAL uint8 tx_buffers[CTRL_UDP_TX_SLOTS][CTRL_UDP_MAX_REPLY];
+LOCAL struct path_stats raw_stats;
+
+#if CTRL_UDP_ESPCONN_BENCH
+LOCAL struct espconn espconn_conn;
+LOCAL esp_udp espconn_udp;
+LOCAL uint8 espconn_reply[CTRL_UDP_MAX_REPLY];
+LOCAL struct path_stats espconn_stats;
+#endif
+
+// Does the request start with this word?
+LOCAL bool ICACHE_FLASH_ATTR is_command(const char *req, uint16 len, const char *word) {
+  uint16 n = os_strlen(word);
+
+  return len >= n && os_strncmp(req, word, n) == 0 && (len == n || req[n] == ' ' || req[n] == '\n');
+}
+
+// Read a number, move *pos past it. False if there isn't one, or if it doesn't
+// fit in 32 bits (instead of wrapping around to something that might pass the
+// range checks).
+LOCAL bool ICACHE_FLASH_ATTR next_number(const char *req, uint16 len, uint16 *pos, uint32 *value) {
+  while (*pos < len && req[*pos] == ' ')
+    (*pos)++;
+  if (*pos >= len || req[*pos] < '0' || req[*pos] > '9')
+    return false;
+
+  *value = 0;
+  while (*pos < len && req[*pos] >= '0' && req[*pos] <= '9') {
+    uint32 digit = req[(*pos)++] - '0';
+
+    if (*value > (0xffffffff - digit) / 10)
+      return false;
+    *value = *value * 10 + digit;
+  }
+  return true;
+}
+
+LOCAL sint8 ICACHE_FLASH_ATTR hex_digit(char c) {
+  if (c >= '0' && c <= '9')
+    return c - '0';
+  if (c >= 'a' && c <= 'f')
+    return c - 'a' + 10;
+  if (c >= 'A' && c <= 'F')
+    return c - 'A' + 10;
+  return -1;
+}
+
+// aa:bb:cc:dd:ee:ff starting at req[pos]
+LOCAL bool ICACHE_FLASH_ATTR parse_mac(const char *req, uint16 len, uint16 pos, uint8 *mac) {
+  uint8 i;
+
+  while (pos < len && req[pos] == ' ')
+    pos++;
+  if (pos + 17 > len)
+    return false;
+
+  for (i = 0; i < 6; i++, pos += 3) {
+    sint8 hi = hex_digit(req[pos]), lo = hex_digit(req[pos + 1]);
+
+    if (hi < 0 || lo < 0 || (i < 5 && req[pos + 2] != ':'))
+      return false;
+    mac[i] = (hi << 4) | lo;
+  }
+  return true;
+}
+
+// One line of numbers into reply, cut short to fit size bytes (with its 0). With
+// every counter at its maximum the line is longer than a whole reply, so it has
+// to be cut. Returns the length written.
+LOCAL uint16 ICACHE_FLASH_ATTR path_report(char *reply, uint16 size, const char *name,
+                                           const struct path_stats *s) {
+  uint32 mhz = system_get_cpu_freq();
+  int n;
+
+  n = os_snprintf(reply, size, "%s: %u requests, %u dropped, avg %u us, max %u us, %u bytes held, heap min %u\n",
+                  name, s->requests, s->dropped, s->requests ? s->cycles_sum / s->requests / mhz : 0,
+                  s->cycles_max / mhz, s->requests ? s->held_sum / s->requests : 0, s->heap_min);
+  if (n < 0)
+    return 0;
+  return n < size ? n : size - 1;
+}
+
+// Handle one request, write the answer into reply (CTRL_UDP_MAX_REPLY bytes) and
+// return its length. Shared by both paths so they do exactly the same work.
+LOCAL uint16 ICACHE_FLASH_ATTR handle_request(const char *req, uint16 len, char *reply) {
+  struct softap_params params;
+  uint32 values[4];
+  uint16 pos;
+  uint8 mac[6];
+  uint8 i;
+
+  if (is_command(req, len, "ping"))
+    return os_sprintf(reply, "pong\n");
+
+  if (is_command(req, len, "stats"))
+    return os_sprintf(reply, "clients %u heap %u uptime %u s\n", wifi_softap_get_station_num(),
+                      system_get_free_heap_size(), system_get_time() / 1000000);
+
+  if (is_command(req, len, "ap")) {
+    pos = 2;
+    for (i = 0; i < 4; i++)
+      if (!next_number(req, len, &pos, &values[i]))
+        return os_sprintf(reply, "usage: ap <clients> <beacon ms> <channel> <hidden>\n");
+    // softap_tune_apply checks the ranges, but only after they fit the fields
+    if (values[0] > 0xff || values[1] > 0xffff || values[2] > 0xff || values[3] > 0xff)
+      return os_sprintf(reply, "rejected\n");
+    params.max_connection = values[0];
+    params.beacon_interval = values[1];
+    params.channel = values[2];
+    params.hidden = values[3];
+    return os_sprintf(reply, softap_tune_apply(&params) ? "ok\n" : "rejected\n");
+  }
+
+  if (is_command(req, len, "mac")) {
+    if (!parse_mac(req, len, 3, mac))
+      return os_sprintf(reply, "usage: mac aa:bb:cc:dd:ee:ff\n");
+#if FEATURE_MAC_FILTER
+    return os_sprintf(reply, mac_filter_lookup(mac) ? "allowed\n" : "refused\n");
+#else
+    return os_sprintf(reply, "no mac filter in this firmware\n");
+#endif
+  }
+
+  if (is_command(req, len, "bench")) {
+    pos = path_report(reply, CTRL_UDP_MAX_REPLY, "raw", &raw_stats);
+#if CTRL_UDP_ESPCONN_BENCH
+    pos += path_report(reply + pos, CTRL_UDP_MAX_REPLY - pos, "espconn", &espconn_stats);
+#endif
+    return pos;
+  }
+
+  return os_sprintf(reply, "commands: ping stats ap mac bench\n");
+}
+
+// Book one request: how long it took and how much heap the send path still has
+LOCAL void ICACHE_FLASH_ATTR path_count(struct path_stats *s, uint32 start, uint32 heap_before) {
+  uint32 cycles = get_ccount() - start;
+  uint32 heap = system_get_free_heap_size();
+
+  s->requests++;
+  s->cycles_sum += cycles;
+  if (cycles > s->cycles_max)
+    s->cycles_max = cycles;
+  if (heap < heap_before)
+    s->held_sum += heap_before - heap;
+  if (s->heap_min == 0 || heap < s->heap_min)
+    s->heap_min = heap;
+}
+
+// A tx slot the driver is done with, CTRL_UDP_TX_SLOTS if there isn't one
+LOCAL uint8 ICACHE_FLASH_ATTR free_slot(void) {
+  uint8 i;
+
+  for (i = 0; i < CTRL_UDP_TX_SLOTS; i++)
+    if (tx_pbufs[i]->ref == 1)
+      return i;
+  return CTRL_UDP_TX_SLOTS;
+}
+
+// lwIP calls this for every datagram to our port. We own p.
+LOCAL void ICACHE_FLASH_ATTR ctrl_recv(void *arg, struct udp_pcb *pcb, struct pbuf *p,
+                                       ip_addr_t *addr, u16_t port) {
+  uint32 start = get_ccount();
+  uint32 heap_before = system_get_free_heap_size();
+  uint8 slot = free_slot();
+  uint16 len;
+
+  if (slot == CTRL_UDP_TX_SLOTS) {
+    raw_stats.dropped++;
+    pbuf_free(p);
+    return;
+  }
+
+  len = handle_request(p->payload, p->len, (char *)tx_buffers[slot]);
+  pbuf_free(p);
+
+  // The PBUF_REF points at the buffer already, only the length changes
+  tx_pbufs[slot]->payload = tx_buffers[slot];
+  tx_pbufs[slot]->len = len;
+  tx_pbufs[slot]->tot_len = len;
+  udp_sendto(pcb, tx_pbufs[slot], addr, port);
+
+  path_count(&raw_stats, start, heap_before);
+}
+
+#if CTRL_UDP_ESPCONN_BENCH
+
+// The same service the way we'd have written it with espconn (logic_capture.c):
+// espconn copies the request out for us and copies the reply in again.
+LOCAL void ICACHE_FLASH_ATTR espconn_recv(void *arg, char *data, unsigned short len) {
+  struct espconn *conn = arg;
+  remot_info *remote = NULL;
+  uint32 start = get_ccount();
+  uint32 heap_before = system_get_free_heap_size();
+  uint16 reply_len;
+
+  reply_len = handle_request(data, len, (char *)espconn_reply);
+
+  // Reply to whoever sent it
+  if (espconn_get_connection_info(conn, &remote, 0) == 0) {
+    os_memcpy(conn->proto.udp->remote_ip, remote->remote_ip, 4);
+    conn->proto.udp->remote_port = remote->remote_port;
+    if (espconn_sendto(conn, espconn_reply, reply_len) != 0)
+      espconn_stats.dropped++;
+  }
+
+  path_count(&espconn_stats, start, heap_before);
+}
+
+#endif
+
+// Open the service (call once the softAP is up). False if lwIP hasn't got the
+// memory or the port is taken.
+bool ICACHE_FLASH_ATTR ctrl_udp_start(void) {
+  uint8 i;
+
+  if (ctrl_pcb != NULL)
+    return true;
+
+  for (i = 0; i < CTRL_UDP_TX_SLOTS; i++) {
+    tx_pbufs[i] = pbuf_alloc(PBUF_TRANSPORT, CTRL_UDP_MAX_REPLY, PBUF_REF);
+    if (tx_pbufs[i] == NULL) {
+      os_printf("ctrl udp: no memory for the tx pbufs\n");
+      while (i > 0)
+        pbuf_free(tx_pbufs[--i]);
+      return false;
+    }
+    tx_pbufs[i]->payload = tx_buffers[i];
+  }
+
+  ctrl_pcb = udp_new();
+  if (ctrl_pcb == NULL || udp_bind(ctrl_pcb, IP_ADDR_ANY, CTRL_UDP_PORT) != ERR_OK) {
+    os_printf("ctrl udp: can't bind port %u\n", CTRL_UDP_PORT);
+    if (ctrl_pcb != NULL)
+      udp_remove(ctrl_pcb);
+    ctrl_pcb = NULL;
+    for (i = 0; i < CTRL_UDP_TX_SLOTS; i++)
+      pbuf_free(tx_pbufs[i]);
+    return false;
+  }
+  udp_recv(ctrl_pcb, ctrl_recv, NULL);
+
+#if CTRL_UDP_ESPCONN_BENCH
+  os_bzero(&espconn_udp, sizeof(espconn_udp));
+  espconn_udp.local_port = CTRL_UDP_PORT + 1;
+  espconn_conn.type = ESPCONN_UDP;
+  espconn_conn.state = ESPCONN_NONE;
+  espconn_conn.proto.udp = &espconn_udp;
+  espconn_regist_recvcb(&espconn_conn, espconn_recv);
+  espconn_create(&espconn_conn);
+#endif
+
+  os_printf("ctrl udp: listening on port %u\n", CTRL_UDP_PORT);
+  return true;
+}
+
+void ICACHE_FLASH_ATTR ctrl_udp_report(void) {
+  char line[CTRL_UDP_MAX_REPLY];
+
+  path_report(line, sizeof(line), "ctrl udp raw", &raw_stats);
+  os_printf("%s", line);
+#if CTRL_UDP_ESPCONN_BENCH
+  path_report(line, sizeof(line), "ctrl udp espconn", &espconn_stats);
+  os_printf("%s", line);
+#endif
+}
@@ -0,0 +1,35 @@
+// Control service on UDP port CTRL_UDP_PORT. One datagram in, one out, plain
+// text so "nc -u 192.168.4.1 4210" will do:
+//   ping                         pong
+//   stats                        clients, free heap, uptime
+//   ap <clients> <beacon ms> <channel> <hidden>
+//                                change the softAP settings (softap_tune.h)
+//   mac <aa:bb:cc:dd:ee:ff>      what the MAC filter says about a station
+//   bench                        the numbers below
+//
+// It's built on the raw lwIP API instead of espconn:
+//   - a request is read straight out of the pbuf lwIP hands us (no copy) and
+//     answered right there in the receive callback
+//   - a reply is built in one of CTRL_UDP_TX_SLOTS static buffers and sent through
+//     a PBUF_REF pbuf that points at it (allocated once, at start)
+// lwIP still needs room for the UDP and IP headers in front of a PBUF_REF, so it
+// allocates a small header pbuf for every reply. That's the only allocation left.
+//
+// To see what that buys us, with CTRL_UDP_ESPCONN_BENCH the same requests are also
+// served through espconn on CTRL_UDP_PORT + 1. Both paths count how long a request
+// takes from the receive callback to the reply being sent, and how much heap is
+// still out when we return (what the send path allocated and hasn't got back yet).
+
+#ifndef CTRL_UDP_H
+#define CTRL_UDP_H
+
+#include "c_types.h"
+
+#define CTRL_UDP_PORT         4210
+#define CTRL_UDP_TX_SLOTS     2
+#define CTRL_UDP_MAX_REPLY    256
+
+bool ctrl_udp_start(void);
+void ctrl_udp_report(void);
+
+#endif
@@ -0,0 +1,164 @@
+// Event bus ... see event_bus.h.
+//
+// The static subscription table is one 32 bit mask per SDK event, with a bit set
+// for every static subscriber that wants it. Dispatch walks the set bits, so it
+// costs one call per subscriber and nothing for the ones that didn't subscribe.
+// The masks are in flash (ICACHE_RODATA_ATTR) ... they are 32 bits wide so that's
+// safe to read.
+//
+// To add a static subscriber: give it an id in the enum, put its function in
+// static_handlers and set its bit for the events it wants in subscriptions.
+//
+// The status LED isn't a subscriber on purpose. What it shows is the state
+// machine's call (the actions in user_main.c start and stop the patterns), and a
+// second subscriber driving it from the raw events would fight the actions, for
+// example blink for a station the MAC filter turned away or a duplicate connect.
+
+#include "ets_sys.h"
+#include "osapi.h"
+#include "user_interface.h"
+#include "user_config.h"
+#include "event_bus.h"
+#include "wifi_stats.h"
+#include "power.h"
+#include "ccount.h"
+
+#if EVENT_MAX > 32
+#error "The event masks only have room for 32 SDK events"
+#endif
+
+enum {
+  SUB_APP,          // wifi_event_handler_callback in user_main.c (the state machine)
+#if FEATURE_STATS
+  SUB_WIFI_STATS,   // wifi_stats.c
+#endif
+  SUB_POWER,        // power.c (wakes the state machine up on a probe request)
+#if FEATURE_TELEMETRY
+  SUB_TELEMETRY,    // telemetry_on_event in user_main.c (a line for every client change)
+#endif
+  SUB_STATIC_COUNT
+};
+
+#define SUB(id)  BIT(id)
+
+// Subscribers that aren't built in (see the features in user_config.h) subscribe
+// to nothing
+#if FEATURE_STATS
+#define SUB_STATS  SUB(SUB_WIFI_STATS)
+#else
+#define SUB_STATS  0
+#endif
+#if FEATURE_TELEMETRY
+#define SUB_TELEM  SUB(SUB_TELEMETRY)
+#else
+#define SUB_TELEM  0
+#endif
+
+LOCAL const event_bus_handler_t static_handlers[SUB_STATIC_COUNT] = {
+  wifi_event_handler_callback,
+#if FEATURE_STATS
+  wifi_stats_on_event,
+#endif
+  power_on_event,
+#if FEATURE_TELEMETRY
+  telemetry_on_event,
+#endif
+};
+
+LOCAL const uint32 subscriptions[EVENT_MAX] ICACHE_RODATA_ATTR STORE_ATTR = {
+  [EVENT_SOFTAPMODE_STACONNECTED]      = SUB(SUB_APP) | SUB_STATS | SUB_TELEM,
+  [EVENT_SOFTAPMODE_STADISCONNECTED]   = SUB(SUB_APP) | SUB_STATS | SUB_TELEM,
+  [EVENT_SOFTAPMODE_PROBEREQRECVED]    = SUB_STATS | SUB(SUB_POWER),
+  [EVENT_SOFTAPMODE_DISTRIBUTE_STA_IP] = SUB(SUB_APP),
+};
+
+// Dynamic slots
+LOCAL struct {
+  event_bus_handler_t handler;
+  uint32 event_mask;
+} dynamic[EVENT_BUS_DYNAMIC_SLOTS];
+
+// Per subscriber timing: static subscribers first, then the dynamic slots
+#define SUB_TOTAL  (SUB_STATIC_COUNT + EVENT_BUS_DYNAMIC_SLOTS)
+
+LOCAL struct {
+  uint32 calls;
+  uint32 cycles_total;
+  uint32 cycles_max;
+} timing[SUB_TOTAL];
+
+LOCAL uint32 unknown_events;
+
+// Call one subscriber and keep track of how long it took
+LOCAL void ICACHE_FLASH_ATTR call(uint32 id, event_bus_handler_t handler, System_Event_t *event) {
+  uint32 start = get_ccount();
+
+  handler(event);
+
+  start = get_ccount() - start;
+  timing[id].calls++;
+  timing[id].cycles_total += start;
+  if (start > timing[id].cycles_max)
+    timing[id].cycles_max = start;
+}
+
+// This is what we register with wifi_set_event_handler_cb
+void ICACHE_FLASH_ATTR event_bus_dispatch(System_Event_t *event) {
+  uint32 mask;
+  uint32 i;
+
+  // Newer SDKs may send events we have never heard of
+  if (event->event >= EVENT_MAX) {
+    unknown_events++;
+    return;
+  }
+
+  mask = subscriptions[event->event];
+  while (mask != 0) {
+    i = __builtin_ctz(mask);
+    mask &= mask - 1;
+    call(i, static_handlers[i], event);
+  }
+
+  for (i = 0; i < EVENT_BUS_DYNAMIC_SLOTS; i++)
+    if (dynamic[i].handler != NULL && (dynamic[i].event_mask & EVENT_BUS_MASK(event->event)))
+      call(SUB_STATIC_COUNT + i, dynamic[i].handler, event);
+}
+
+// Add a dynamic subscriber for the events in event_mask (EVENT_BUS_MASK(...) | ...).
+// Returns the slot number (for event_bus_unsubscribe) or -1 if all slots are taken.
+sint8 ICACHE_FLASH_ATTR event_bus_subscribe(event_bus_handler_t handler, uint32 event_mask) {
+  sint8 i;
+
+  for (i = 0; i < EVENT_BUS_DYNAMIC_SLOTS; i++) {
+    if (dynamic[i].handler == NULL) {
+      dynamic[i].handler = handler;
+      dynamic[i].event_mask = event_mask;
+      os_bzero(&timing[SUB_STATIC_COUNT + i], sizeof(timing[0]));
+      return i;
+    }
+  }
+  return -1;
+}
+
+void ICACHE_FLASH_ATTR event_bus_unsubscribe(sint8 slot) {
+  if (slot >= 0 && slot < EVENT_BUS_DYNAMIC_SLOTS)
+    dynamic[slot].handler = NULL;
+}
+
+// Calls, average and worst time per subscriber
+void ICACHE_FLASH_ATTR event_bus_report(void) {
+  uint32 mhz = system_get_cpu_freq();
+  uint32 i;
+
+  os_printf("event bus: %u unknown events\n", unknown_events);
+  for (i = 0; i < SUB_TOTAL; i++) {
+    if (timing[i].calls == 0)
+      continue;
+    os_printf("  %s %u: %u calls, avg %u us, max %u us\n",
+              i < SUB_STATIC_COUNT ? "static" : "slot",
+              i < SUB_STATIC_COUNT ? i : i - SUB_STATIC_COUNT,
+              timing[i].calls, timing[i].cycles_total / timing[i].calls / mhz,
+              timing[i].cycles_max / mhz);
+  }
+}
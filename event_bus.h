@@ -0,0 +1,37 @@
+// Event bus for the SDK WiFi events. wifi_set_event_handler_cb only takes ONE
+// handler, but the state machine (and through it the LED), the stats, the power
+// saving and the telemetry all want to know when a client comes or goes. So the SDK calls event_bus_dispatch and the
+// bus hands the event to everybody that subscribed to it.
+//
+// There are two kinds of subscribers:
+//   - static ones, listed in the table in event_bus.c. That's decided at compile
+//     time and costs nothing at run time.
+//   - dynamic ones, added with event_bus_subscribe into one of the
+//     EVENT_BUS_DYNAMIC_SLOTS slots (for things that come and go).
+//
+// Every subscriber call is timed with CCOUNT so we can see who is slow.
+
+#ifndef EVENT_BUS_H
+#define EVENT_BUS_H
+
+#include "c_types.h"
+#include "user_interface.h"
+
+#define EVENT_BUS_DYNAMIC_SLOTS  4
+
+// Turn an SDK event id into a bit for the event masks
+#define EVENT_BUS_MASK(event)    BIT(event)
+#define EVENT_BUS_ALL            (BIT(EVENT_MAX) - 1)
+
+typedef void (*event_bus_handler_t)(System_Event_t *event);
+
+void event_bus_dispatch(System_Event_t *event);
+sint8 event_bus_subscribe(event_bus_handler_t handler, uint32 event_mask);
+void event_bus_unsubscribe(sint8 slot);
+void event_bus_report(void);
+
+// Static subscribers (see the table in event_bus.c)
+void wifi_event_handler_callback(System_Event_t *event);
+void telemetry_on_event(System_Event_t *event);
+
+#endif
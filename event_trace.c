@@ -0,0 +1,216 @@
+// WiFi event record and replay ... see event_trace.h.
+//
+// A recorded line is the 16 bytes of the record, little endian. This is a
+// client with AID 1 connecting 1420ms after the recording started:
+//   trace: 8c050000050100003c286d1122330200
+// To put it in event_traces.h read it back as time_ms (4 bytes), event, aid,
+// rssi, ip, mac (6 bytes) and seq (2 bytes).
+
+#include "ets_sys.h"
+#include "osapi.h"
+#include "gpio.h"
+#include "user_interface.h"
+#include "event_trace.h"
+#include "event_bus.h"
+#include "app_fsm.h"
+#include "typed_timer.h"
+#include "ccount.h"
+
+#define RECORD_BYTES  16
+#define LED_BIT       BIT2   // the status LED on GPIO2
+
+LOCAL sint8 record_slot = -1;
+LOCAL uint32 record_start_us;
+LOCAL uint16 record_seq;
+
+LOCAL os_timer_t replay_timer;
+LOCAL const struct event_trace_record *replay_trace;
+LOCAL uint16 replay_count;
+LOCAL uint16 replay_next;
+LOCAL uint8 replay_speed;
+LOCAL uint32 replay_cycles_max;
+LOCAL uint32 replay_cycles_sum;
+LOCAL uint32 replay_live_dropped;
+
+// The record the way it goes out on the UART, byte by byte so it doesn't matter
+// how the compiler lays the struct out.
+LOCAL void ICACHE_FLASH_ATTR record_to_bytes(const struct event_trace_record *r, uint8 *b) {
+  b[0] = r->time_ms;
+  b[1] = r->time_ms >> 8;
+  b[2] = r->time_ms >> 16;
+  b[3] = r->time_ms >> 24;
+  b[4] = r->event;
+  b[5] = r->aid;
+  b[6] = r->rssi;
+  b[7] = r->ip;
+  os_memcpy(&b[8], r->mac, 6);
+  b[14] = r->seq;
+  b[15] = r->seq >> 8;
+}
+
+// Dynamic event bus subscriber: one "trace:" line per event
+LOCAL void ICACHE_FLASH_ATTR record_event(System_Event_t *event) {
+  static const char hex[] = "0123456789abcdef";
+  struct event_trace_record r;
+  uint8 bytes[RECORD_BYTES];
+  char line[RECORD_BYTES * 2 + 1];
+  uint8 i;
+
+  os_bzero(&r, sizeof(r));
+  r.time_ms = (system_get_time() - record_start_us) / 1000;
+  r.event = event->event;
+  r.seq = record_seq++;
+
+  switch (event->event) {
+    case EVENT_SOFTAPMODE_STACONNECTED:
+      r.aid = event->event_info.sta_connected.aid;
+      os_memcpy(r.mac, event->event_info.sta_connected.mac, 6);
+      break;
+    case EVENT_SOFTAPMODE_STADISCONNECTED:
+      r.aid = event->event_info.sta_disconnected.aid;
+      os_memcpy(r.mac, event->event_info.sta_disconnected.mac, 6);
+      break;
+    case EVENT_SOFTAPMODE_PROBEREQRECVED:
+      r.rssi = event->event_info.ap_probereqrecved.rssi;
+      os_memcpy(r.mac, event->event_info.ap_probereqrecved.mac, 6);
+      break;
+    case EVENT_SOFTAPMODE_DISTRIBUTE_STA_IP:
+      r.aid = event->event_info.distribute_sta_ip.aid;
+      r.ip = event->event_info.distribute_sta_ip.ip.addr >> 24;   // network order, last byte on top
+      os_memcpy(r.mac, event->event_info.distribute_sta_ip.mac, 6);
+      break;
+    default:
+      break;    // only the event and the time for the rest
+  }
+
+  record_to_bytes(&r, bytes);
+  for (i = 0; i < RECORD_BYTES; i++) {
+    line[i * 2] = hex[bytes[i] >> 4];
+    line[i * 2 + 1] = hex[bytes[i] & 0xf];
+  }
+  line[RECORD_BYTES * 2] = '\0';
+  os_printf("trace: %s\n", line);
+}
+
+// Start printing every WiFi event
+void ICACHE_FLASH_ATTR event_trace_record_start(void) {
+  if (record_slot >= 0 || replay_trace != NULL)
+    return;
+
+  record_start_us = system_get_time();
+  record_seq = 0;
+  record_slot = event_bus_subscribe(record_event, EVENT_BUS_ALL);
+  if (record_slot < 0)
+    os_printf("event trace: no free event bus slot, not recording\n");
+}
+
+void ICACHE_FLASH_ATTR event_trace_record_stop(void) {
+  if (record_slot < 0)
+    return;
+
+  event_bus_unsubscribe(record_slot);
+  record_slot = -1;
+}
+
+// Turn a record back into the event the SDK would have given us
+LOCAL void ICACHE_FLASH_ATTR record_to_event(const struct event_trace_record *r, System_Event_t *event) {
+  os_bzero(event, sizeof(*event));
+  event->event = r->event;
+
+  switch (r->event) {
+    case EVENT_SOFTAPMODE_STACONNECTED:
+      event->event_info.sta_connected.aid = r->aid;
+      os_memcpy(event->event_info.sta_connected.mac, r->mac, 6);
+      break;
+    case EVENT_SOFTAPMODE_STADISCONNECTED:
+      event->event_info.sta_disconnected.aid = r->aid;
+      os_memcpy(event->event_info.sta_disconnected.mac, r->mac, 6);
+      break;
+    case EVENT_SOFTAPMODE_PROBEREQRECVED:
+      event->event_info.ap_probereqrecved.rssi = r->rssi;
+      os_memcpy(event->event_info.ap_probereqrecved.mac, r->mac, 6);
+      break;
+    case EVENT_SOFTAPMODE_DISTRIBUTE_STA_IP:
+      event->event_info.distribute_sta_ip.aid = r->aid;
+      IP4_ADDR(&event->event_info.distribute_sta_ip.ip, 192, 168, 4, r->ip);
+      os_memcpy(event->event_info.distribute_sta_ip.mac, r->mac, 6);
+      break;
+    default:
+      break;
+  }
+}
+
+// The SDK's handler while a replay runs: real events are only counted
+LOCAL void ICACHE_FLASH_ATTR replay_drop_live(System_Event_t *event) {
+  replay_live_dropped++;
+}
+
+// Wait for the gap to the next record, shortened by the replay speed
+LOCAL void ICACHE_FLASH_ATTR replay_arm(void) {
+  uint32 gap_ms = 0;
+
+  if (replay_next > 0)
+    gap_ms = replay_trace[replay_next].time_ms - replay_trace[replay_next - 1].time_ms;
+  os_timer_arm(&replay_timer, gap_ms / replay_speed, 0);
+}
+
+// One event per timer call, then the timeline line for it
+LOCAL void ICACHE_FLASH_ATTR replay_timer_function(void *arg) {
+  const struct event_trace_record *r = &replay_trace[replay_next];
+  System_Event_t event;
+  uint32 start, cycles;
+  uint32 mhz = system_get_cpu_freq();
+
+  record_to_event(r, &event);
+  start = get_ccount();
+  event_bus_dispatch(&event);
+  cycles = get_ccount() - start;
+
+  replay_cycles_sum += cycles;
+  if (cycles > replay_cycles_max)
+    replay_cycles_max = cycles;
+
+  // The LED column is the level of GPIO2 right after the event (1 is what
+  // led_blink drives for the "on" steps of a pattern)
+  os_printf("replay %u: %u ms event %u aid %u -> state %u, led %u, %u us\n",
+            r->seq, r->time_ms, r->event, r->aid, app_fsm_state(),
+            (GPIO_REG_READ(GPIO_OUT_ADDRESS) & LED_BIT) ? 1 : 0, cycles / mhz);
+
+  if (++replay_next < replay_count) {
+    replay_arm();
+    return;
+  }
+
+  os_printf("replay done: %u events at %ux, handler avg %u us, max %u us, %u live events dropped\n",
+            replay_count, replay_speed, replay_cycles_sum / replay_count / mhz,
+            replay_cycles_max / mhz, replay_live_dropped);
+  replay_trace = NULL;
+  wifi_set_event_handler_cb(event_bus_dispatch);
+}
+
+// Play a trace back through the event bus, speed times faster than it was
+// recorded (1 for real time). False if a replay or a recording is going on.
+bool ICACHE_FLASH_ATTR event_trace_replay(const struct event_trace_record *trace, uint16 count, uint8 speed) {
+  if (replay_trace != NULL || record_slot >= 0 || count == 0)
+    return false;
+
+  replay_trace = trace;
+  replay_count = count;
+  replay_next = 0;
+  replay_speed = speed > 0 ? speed : 1;
+  replay_cycles_max = 0;
+  replay_cycles_sum = 0;
+  replay_live_dropped = 0;
+
+  // The real events wait until we're done (see event_trace.h)
+  wifi_set_event_handler_cb(replay_drop_live);
+  os_printf("replay: %u events at %ux\n", count, replay_speed);
+  TYPED_TIMER_SETFN(&replay_timer, replay_timer_function, NULL);
+  replay_arm();
+  return true;
+}
+
+// Is a replay going on? Subscribers that act on the radio check this.
+bool ICACHE_FLASH_ATTR event_trace_replaying(void) {
+  return replay_trace != NULL;
+}
@@ -0,0 +1,47 @@
+// Record and replay of WiFi event traces.
+//
+// Record: every SDK WiFi event the event bus sees is turned into a 16 byte
+// record and printed on the UART as one line, "trace: " and the record in hex.
+// Hex because the UART is shared with os_printf and raw bytes would garble it.
+//
+// Replay: feed a list of records back through event_bus_dispatch, with the gaps
+// between them as recorded or EVENT_TRACE_REPLAY_SPEED times faster. Every event
+// is timed and a line with the state machine state and the status LED afterwards
+// is printed, so two firmware versions can be compared line by line on the same
+// trace. Traces to replay live in event_traces.h.
+//
+// Only one of the two at a time: the events we replay would be recorded again.
+//
+// A replay goes through the real subscribers, that's what it's for, so it does
+// what the events would do: the state machine moves, the LED blinks, the stats
+// and the MAC filter count the replayed clients. Two things it doesn't do: while
+// it runs the SDK's own events are dropped (counted, and the count printed at
+// the end), so real and replayed clients don't get mixed up; and
+// event_trace_replaying() tells the subscribers to leave the radio alone (no
+// deauth of a replayed MAC that happens to belong to a real client).
+
+#ifndef EVENT_TRACE_H
+#define EVENT_TRACE_H
+
+#include "c_types.h"
+
+#define EVENT_TRACE_RECORD  0
+#define EVENT_TRACE_REPLAY  1
+
+// One event, 16 bytes (little endian on the wire, like the ESP8266)
+struct event_trace_record {
+  uint32 time_ms;     // since recording started
+  uint8 event;        // EVENT_SOFTAPMODE_... from user_interface.h
+  uint8 aid;          // connects, disconnects and DHCP
+  sint8 rssi;         // probe requests
+  uint8 ip;           // last byte of the address handed out (DHCP)
+  uint8 mac[6];
+  uint16 seq;         // record number, so you can tell if a line got lost
+};
+
+void event_trace_record_start(void);
+void event_trace_record_stop(void);
+bool event_trace_replay(const struct event_trace_record *trace, uint16 count, uint8 speed);
+bool event_trace_replaying(void);
+
+#endif
@@ -0,0 +1,31 @@
+// WiFi event traces for event_trace_replay. Record one on a unit that's seeing
+// the trouble (see event_trace.h), turn the "trace:" lines into entries here and
+// every firmware after that can be run against exactly the same events.
+//
+// The records are read with byte accesses so they stay in RAM (no
+// ICACHE_RODATA_ATTR).
+
+#ifndef EVENT_TRACES_H
+#define EVENT_TRACES_H
+
+#include "c_types.h"
+#include "user_interface.h"
+#include "event_trace.h"
+
+// A phone and a laptop, including the things the SDK does now and then: a
+// connect twice for the same AID, a disconnect for an AID we never saw connect,
+// and a static IP client that never asks for DHCP.
+LOCAL const struct event_trace_record trace_two_clients[] = {
+  {     0, EVENT_SOFTAPMODE_PROBEREQRECVED,    0, -62, 0, { 0x3c, 0x28, 0x6d, 0x11, 0x22, 0x33 },  0 },
+  {   180, EVENT_SOFTAPMODE_PROBEREQRECVED,    0, -61, 0, { 0x3c, 0x28, 0x6d, 0x11, 0x22, 0x33 },  1 },
+  {  1420, EVENT_SOFTAPMODE_STACONNECTED,      1,   0, 0, { 0x3c, 0x28, 0x6d, 0x11, 0x22, 0x33 },  2 },
+  {  1790, EVENT_SOFTAPMODE_DISTRIBUTE_STA_IP, 1,   0, 2, { 0x3c, 0x28, 0x6d, 0x11, 0x22, 0x33 },  3 },
+  {  9050, EVENT_SOFTAPMODE_STACONNECTED,      2,   0, 0, { 0xa4, 0x5e, 0x60, 0x44, 0x55, 0x66 },  4 },
+  {  9060, EVENT_SOFTAPMODE_STACONNECTED,      2,   0, 0, { 0xa4, 0x5e, 0x60, 0x44, 0x55, 0x66 },  5 },
+  { 21500, EVENT_SOFTAPMODE_STADISCONNECTED,   3,   0, 0, { 0x00, 0x11, 0x22, 0x33, 0x44, 0x55 },  6 },
+  { 30200, EVENT_SOFTAPMODE_STADISCONNECTED,   1,   0, 0, { 0x3c, 0x28, 0x6d, 0x11, 0x22, 0x33 },  7 },
+  { 30950, EVENT_SOFTAPMODE_STADISCONNECTED,   2,   0, 0, { 0xa4, 0x5e, 0x60, 0x44, 0x55, 0x66 },  8 },
+  { 31000, EVENT_SOFTAPMODE_STADISCONNECTED,   2,   0, 0, { 0xa4, 0x5e, 0x60, 0x44, 0x55, 0x66 },  9 },
+};
+
+#endif
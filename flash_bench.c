@@ -0,0 +1,172 @@
+// Flash benchmark ... see flash_bench.h.
+//
+// The image header (the first 4 bytes of flash) tells us how the bootloader set
+// up the flash:
+//   byte 2  mode: 0 QIO, 1 QOUT, 2 DIO, 3 DOUT
+//   byte 3  low 4 bits clock: 0 40MHz, 1 26MHz, 2 20MHz, 0xf 80MHz
+//           high 4 bits size
+//
+// Every timed call runs with interrupts off so a WiFi interrupt doesn't end up
+// in the numbers. One phase per slice_sched call: evicting the cache reads 64KB
+// of flash, which takes a few milliseconds at the slower settings.
+
+#include "ets_sys.h"
+#include "osapi.h"
+#include "spi_flash.h"
+#include "user_interface.h"
+#include "user_config.h"
+#include "flash_bench.h"
+#include "slice_sched.h"
+#include "ccount.h"
+
+#define FLASH_CACHE_BASE  0x40200000
+#define CACHE_STEP        16            // bytes between reads when evicting (no bigger than a cache line)
+
+enum {
+  SMALL_COLD,
+  SMALL_WARM,
+  BIG_COLD,
+  BIG_WARM,
+  BIG_IRAM,
+  RESULT_COUNT
+};
+
+LOCAL const char *result_names[RESULT_COUNT] = {
+  "small cold", "small warm", "big cold", "big warm", "big iram"
+};
+
+LOCAL struct slice_job bench_job;
+LOCAL uint32 round;
+LOCAL uint8 phase;
+LOCAL uint32 cycles_min[RESULT_COUNT];
+LOCAL uint32 cycles_sum[RESULT_COUNT];
+
+// Where the timed calls leave their result. Volatile, so the call has an effect
+// the compiler has to keep.
+LOCAL volatile uint32 bench_sink;
+
+// The test functions must really be called, and be the code we put where we
+// put it:
+//   - noinline, noclone: not copied into the caller (or into a clone of theirs,
+//     which could land in the other memory)
+//   - BENCH_BARRIER: an empty asm the compiler can't see through. Without it the
+//     functions have no side effects, GCC treats them as const and drops a call
+//     whose result isn't used, timing two CCOUNT reads back to back
+// (GCC 8 has noipa for all of this, the SDK's compiler is older.)
+// The big one can't be folded into a few instructions either: every step
+// depends on the last one in a way the compiler can't simplify.
+#define BENCH_FN        __attribute__((noinline, noclone))
+#define BENCH_BARRIER   __asm__ __volatile__("" : "+r"(x) : : "memory")
+#define STEP(n)    x = (x << 5) ^ (x >> 3) ^ (n);
+#define STEP8(n)   STEP(n) STEP(n + 1) STEP(n + 2) STEP(n + 3) STEP(n + 4) STEP(n + 5) STEP(n + 6) STEP(n + 7)
+#define STEP64(n)  STEP8(n) STEP8(n + 8) STEP8(n + 16) STEP8(n + 24) STEP8(n + 32) STEP8(n + 40) STEP8(n + 48) STEP8(n + 56)
+#define BIG_BODY   STEP64(0) STEP64(64) STEP64(128) STEP64(192)
+
+LOCAL uint32 ICACHE_FLASH_ATTR BENCH_FN small_flash(uint32 x) {
+  BENCH_BARRIER;
+  return x + 1;
+}
+
+LOCAL uint32 ICACHE_FLASH_ATTR BENCH_FN big_flash(uint32 x) {
+  BENCH_BARRIER;
+  BIG_BODY
+  return x;
+}
+
+// The same code in IRAM (no ICACHE_FLASH_ATTR)
+LOCAL uint32 BENCH_FN big_iram(uint32 x) {
+  BENCH_BARRIER;
+  BIG_BODY
+  return x;
+}
+
+// Read enough other flash through the cache to push everything else out
+LOCAL void ICACHE_FLASH_ATTR evict_cache(void) {
+  volatile const uint32 *p = (volatile const uint32 *)FLASH_CACHE_BASE;
+  uint32 i;
+
+  for (i = 0; i < FLASH_BENCH_EVICT_BYTES; i += CACHE_STEP)
+    (void)p[i / 4];
+}
+
+// Call fn once with interrupts off and return how long it took. Timing is
+// done in IRAM so the caller being in flash doesn't matter, which only holds if
+// it isn't inlined into that caller.
+LOCAL uint32 __attribute__((noinline)) time_call(uint32 (*fn)(uint32)) {
+  uint32 start, cycles;
+
+  ets_intr_lock();
+  start = get_ccount();
+  bench_sink = fn(start);
+  cycles = get_ccount() - start;
+  ets_intr_unlock();
+  return cycles;
+}
+
+LOCAL void ICACHE_FLASH_ATTR record(uint8 which, uint32 cycles) {
+  cycles_sum[which] += cycles;
+  if (round == 0 || cycles < cycles_min[which])
+    cycles_min[which] = cycles;
+}
+
+LOCAL void ICACHE_FLASH_ATTR report(void) {
+  static const char *modes[4] = { "QIO", "QOUT", "DIO", "DOUT" };
+  uint32 header;
+  uint32 mhz = system_get_cpu_freq();
+  uint8 mode, clock;
+  uint32 i;
+
+  // Bytes 0 - 3 of the image header (little endian, byte 0 is the 0xe9 magic)
+  if (spi_flash_read(0, &header, 4) != SPI_FLASH_RESULT_OK || (header & 0xff) != 0xe9) {
+    os_printf("flash bench: can't read the image header\n");
+    mode = 0xff;
+    clock = 0xff;
+  } else {
+    mode = (header >> 16) & 0xff;
+    clock = (header >> 24) & 0x0f;
+  }
+
+  os_printf("flash bench: %s, %s flash clock, CPU %uMHz, %u rounds\n",
+            mode < 4 ? modes[mode] : "?",
+            clock == 0x0 ? "40MHz" : clock == 0x1 ? "26MHz" : clock == 0x2 ? "20MHz" : clock == 0xf ? "80MHz" : "?",
+            mhz, FLASH_BENCH_ROUNDS);
+  for (i = 0; i < RESULT_COUNT; i++)
+    os_printf("  %s: min %u cycles, avg %u cycles (%u us)\n", result_names[i],
+              cycles_min[i], cycles_sum[i] / FLASH_BENCH_ROUNDS,
+              cycles_sum[i] / FLASH_BENCH_ROUNDS / mhz);
+}
+
+// One phase of one round per call
+LOCAL uint8 ICACHE_FLASH_ATTR flash_bench_step(void *arg) {
+  if (phase == 0) {
+    evict_cache();
+    record(SMALL_COLD, time_call(small_flash));
+    record(SMALL_WARM, time_call(small_flash));
+    phase = 1;
+    return SLICE_JOB_MORE;
+  }
+
+  evict_cache();
+  record(BIG_COLD, time_call(big_flash));
+  record(BIG_WARM, time_call(big_flash));
+  record(BIG_IRAM, time_call(big_iram));
+  phase = 0;
+
+  if (++round < FLASH_BENCH_ROUNDS)
+    return SLICE_JOB_MORE;
+
+  report();
+  return SLICE_JOB_DONE;
+}
+
+// Start the benchmark (false if it's already running or the scheduler is full)
+bool ICACHE_FLASH_ATTR flash_bench_start(void) {
+  if (bench_job.queued)
+    return false;
+
+  round = 0;
+  phase = 0;
+  os_bzero(cycles_min, sizeof(cycles_min));
+  os_bzero(cycles_sum, sizeof(cycles_sum));
+  return slice_sched_submit(&bench_job, flash_bench_step, NULL, "flash bench", SLICE_PRIO_LOW);
+}
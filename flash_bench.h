@@ -0,0 +1,29 @@
+// Flash benchmark: how long does it take to call a function that lives in flash
+// (ICACHE_FLASH_ATTR)?
+//
+//   cold  the function isn't in the instruction cache, so the cache has to fetch
+//         it from the SPI flash first. This is what the flash mode and clock
+//         change.
+//   warm  called again right away, it's all in the cache and runs like IRAM.
+//
+// We time a tiny function and a big one (a few KB of code, lots of cache lines)
+// plus an IRAM copy of the big one to compare with. To get a cold call we first
+// read FLASH_BENCH_EVICT_BYTES of other flash through the cache, which pushes
+// everything else out of it.
+//
+// The firmware can only measure the mode it's running in (it reads that from its
+// own image header), so to compare modes build with FEATURE_FLASH_BENCH=1, run
+// "make images" and flash the variants one after the other.
+//
+// It runs as a slice_sched job, one round per call, and prints when done.
+
+#ifndef FLASH_BENCH_H
+#define FLASH_BENCH_H
+
+#include "c_types.h"
+
+#define FLASH_BENCH_EVICT_BYTES  (64 * 1024)   // twice the biggest cache
+
+bool flash_bench_start(void);
+
+#endif
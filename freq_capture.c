@@ -0,0 +1,278 @@
+// Frequency and pulse width capture ... see freq_capture.h.
+//
+// The interrupt does as little as possible: read CCOUNT, read the pin levels,
+// clear the interrupt and push one word per edge into the pin's ring. We keep
+// the pin level in bit 0 of the timestamp (costs us 12.5ns of resolution at
+// 80MHz, which we can't get anyway with interrupt latency in the way).
+//
+// A drain timer empties the rings every FREQ_CAPTURE_DRAIN_MS and does the math.
+// If a ring gets half full before that the interrupt asks for an early drain on
+// the urgent task priority (see tasks.h).
+// Two things limit the edge rate we can follow:
+//   - the interrupt itself. If the signal toggles twice before we read the level
+//     we see the same level twice in a row and count a missed edge.
+//   - the ring. If more than FREQ_CAPTURE_RING_SIZE edges arrive between two
+//     drains the interrupt has nowhere to put them and counts a dropped edge.
+// freq_capture_report prints both limits so you know how fast is too fast.
+
+#include "ets_sys.h"
+#include "osapi.h"
+#include "gpio.h"
+#include "os_type.h"
+#include "user_interface.h"
+#include "freq_capture.h"
+#include "user_config.h"
+#include "ccount.h"
+#include "typed_timer.h"
+#include "spsc_ring.h"
+#include "tasks.h"
+
+#define FREQ_CAPTURE_DRAIN_MS  10
+#define DRAIN_BATCH            16    // edges we take out of a ring at a time
+
+// One ring of edges per pin: the interrupt pushes, the drain timer pops.
+// (This also checks FREQ_CAPTURE_RING_SIZE is a power of two.)
+SPSC_RING_DECLARE(edge_ring, uint32, FREQ_CAPTURE_RING_SIZE)
+
+LOCAL const uint8 capture_pins[] = FREQ_CAPTURE_PINS;
+#define CHANNELS  (sizeof(capture_pins) / sizeof(capture_pins[0]))
+
+// Per pin state. The interrupt only pushes into the ring; the drain timer owns
+// everything else. Edges that didn't fit in the ring are its overflows.
+struct channel {
+  struct edge_ring ring;
+  uint32 missed;
+
+  // Edge tracking
+  bool have_last;
+  uint8 last_level;
+  bool have_rise;
+  uint32 last_rise;
+
+  // Accumulators for the current window
+  uint32 periods;
+  uint64 period_sum;
+  uint32 period_min;
+  uint32 period_max;
+  uint32 highs;
+  uint64 high_sum;
+  uint32 high_min;
+  uint32 high_max;
+
+  // Result of the last finished window
+  struct freq_capture_stats stats;
+};
+
+LOCAL struct channel channels[CHANNELS];
+LOCAL uint32 pin_mask;
+LOCAL uint32 isr_cycles_max;
+LOCAL os_timer_t drain_timer;
+LOCAL uint32 drains;
+LOCAL sint8 task_client = -1;
+
+// Map a GPIO number to its pin mux register and function
+LOCAL bool ICACHE_FLASH_ATTR select_gpio(uint8 pin) {
+  switch (pin) {
+    case 4:  PIN_FUNC_SELECT(PERIPHS_IO_MUX_GPIO4_U, FUNC_GPIO4); break;
+    case 5:  PIN_FUNC_SELECT(PERIPHS_IO_MUX_GPIO5_U, FUNC_GPIO5); break;
+    case 12: PIN_FUNC_SELECT(PERIPHS_IO_MUX_MTDI_U, FUNC_GPIO12); break;
+    case 13: PIN_FUNC_SELECT(PERIPHS_IO_MUX_MTCK_U, FUNC_GPIO13); break;
+    case 14: PIN_FUNC_SELECT(PERIPHS_IO_MUX_MTMS_U, FUNC_GPIO14); break;
+    default: return false;
+  }
+  return true;
+}
+
+// The edge interrupt. No ICACHE_FLASH_ATTR ... interrupt handlers live in IRAM.
+LOCAL void freq_capture_isr(void *arg) {
+  uint32 now = get_ccount();
+  uint32 status = GPIO_REG_READ(GPIO_STATUS_ADDRESS);
+  uint32 levels = GPIO_REG_READ(GPIO_IN_ADDRESS);
+  uint32 i;
+
+  GPIO_REG_WRITE(GPIO_STATUS_W1TC_ADDRESS, status);
+
+  for (i = 0; i < CHANNELS; i++) {
+    struct channel *ch = &channels[i];
+    uint32 bit = BIT(capture_pins[i]);
+
+    if (!(status & bit))
+      continue;
+
+    edge_ring_push(&ch->ring, (now & ~1) | ((levels & bit) ? 1 : 0));
+    if (edge_ring_count(&ch->ring) == FREQ_CAPTURE_RING_SIZE / 2 && task_client >= 0)
+      task_post(TASK_PRIO_URGENT, task_client, 0);
+  }
+
+  now = get_ccount() - now;
+  if (now > isr_cycles_max)
+    isr_cycles_max = now;
+}
+
+// Deal with one edge from the ring
+LOCAL void ICACHE_FLASH_ATTR process_edge(struct channel *ch, uint32 edge) {
+  uint8 level = edge & 1;
+  uint32 t = edge & ~1;
+  uint32 d;
+
+  // Same level twice means we missed (at least) two edges in between. The
+  // timing is garbage now, so start over from this edge.
+  if (ch->have_last && level == ch->last_level) {
+    ch->missed++;
+    ch->have_rise = false;
+  }
+  ch->have_last = true;
+  ch->last_level = level;
+
+  if (level) {
+    if (ch->have_rise) {
+      d = t - ch->last_rise;
+      ch->periods++;
+      ch->period_sum += d;
+      if (d < ch->period_min) ch->period_min = d;
+      if (d > ch->period_max) ch->period_max = d;
+    }
+    ch->have_rise = true;
+    ch->last_rise = t;
+  } else if (ch->have_rise) {
+    d = t - ch->last_rise;
+    ch->highs++;
+    ch->high_sum += d;
+    if (d < ch->high_min) ch->high_min = d;
+    if (d > ch->high_max) ch->high_max = d;
+  }
+}
+
+// Close the current window: turn the accumulators into stats and reset them
+LOCAL void ICACHE_FLASH_ATTR close_window(struct channel *ch) {
+  uint32 cpu_hz = system_get_cpu_freq() * 1000000;
+  struct freq_capture_stats *s = &ch->stats;
+
+  s->periods = ch->periods;
+  s->period_min = ch->periods ? ch->period_min : 0;
+  s->period_max = ch->period_max;
+  s->high_min = ch->highs ? ch->high_min : 0;
+  s->high_max = ch->high_max;
+  s->freq_mhz = ch->period_sum ? (uint32)((uint64)ch->periods * cpu_hz * 1000 / ch->period_sum) : 0;
+
+  // Duty from the average high time over the average period
+  if (ch->highs && ch->periods)
+    s->duty_permille = (uint32)((ch->high_sum * ch->periods * 1000) / (ch->period_sum * ch->highs));
+  else
+    s->duty_permille = (ch->last_level ? 1000 : 0);
+
+  s->dropped = ch->ring.overflows;
+  s->missed = ch->missed;
+
+  ch->periods = 0;
+  ch->period_sum = 0;
+  ch->period_min = 0xffffffff;
+  ch->period_max = 0;
+  ch->highs = 0;
+  ch->high_sum = 0;
+  ch->high_min = 0xffffffff;
+  ch->high_max = 0;
+}
+
+// Empty the rings
+LOCAL void ICACHE_FLASH_ATTR drain_rings(void) {
+  uint32 edges[DRAIN_BATCH];
+  uint32 i, j, n;
+
+  for (i = 0; i < CHANNELS; i++) {
+    struct channel *ch = &channels[i];
+
+    // Only what's there now ... edges that come in while we're at it can wait
+    // for the next drain
+    n = edge_ring_count(&ch->ring);
+    while (n > 0) {
+      uint32 got = edge_ring_pop_batch(&ch->ring, edges, n < DRAIN_BATCH ? n : DRAIN_BATCH);
+      for (j = 0; j < got; j++)
+        process_edge(ch, edges[j]);
+      n -= got;
+    }
+  }
+}
+
+// Early drain, the interrupt asked for it because a ring is filling up
+LOCAL void ICACHE_FLASH_ATTR drain_task(uint32 par) {
+  drain_rings();
+}
+
+// Drain timer ... empty the rings and every FREQ_CAPTURE_WINDOW_MS close the window
+LOCAL void ICACHE_FLASH_ATTR drain_timer_function(void *arg) {
+  uint32 i;
+
+  drain_rings();
+
+  drains++;
+  if (drains * FREQ_CAPTURE_DRAIN_MS < FREQ_CAPTURE_WINDOW_MS)
+    return;
+  drains = 0;
+
+  for (i = 0; i < CHANNELS; i++)
+    close_window(&channels[i]);
+  freq_capture_report();
+}
+
+void ICACHE_FLASH_ATTR freq_capture_init(void) {
+  uint32 i;
+
+  task_client = task_register(TASK_PRIO_URGENT, drain_task);
+
+  pin_mask = 0;
+  for (i = 0; i < CHANNELS; i++) {
+    if (!select_gpio(capture_pins[i])) {
+      os_printf("freq capture: GPIO%d can't be used\n", capture_pins[i]);
+      continue;
+    }
+    os_bzero(&channels[i], sizeof(channels[i]));
+    close_window(&channels[i]);
+    pin_mask |= BIT(capture_pins[i]);
+  }
+
+  ETS_GPIO_INTR_DISABLE();
+  ETS_GPIO_INTR_ATTACH(freq_capture_isr, NULL);
+
+  // Inputs, interrupt on both edges
+  gpio_output_set(0, 0, 0, pin_mask);
+  GPIO_REG_WRITE(GPIO_STATUS_W1TC_ADDRESS, pin_mask);
+  for (i = 0; i < CHANNELS; i++)
+    if (pin_mask & BIT(capture_pins[i]))
+      gpio_pin_intr_state_set(GPIO_ID_PIN(capture_pins[i]), GPIO_PIN_INTR_ANYEDGE);
+
+  ETS_GPIO_INTR_ENABLE();
+
+  os_timer_disarm(&drain_timer);
+  TYPED_TIMER_SETFN(&drain_timer, drain_timer_function, NULL);
+  os_timer_arm(&drain_timer, FREQ_CAPTURE_DRAIN_MS, 1);
+}
+
+// Copy out the stats of the last finished window for a channel (index into
+// FREQ_CAPTURE_PINS, not the GPIO number).
+bool ICACHE_FLASH_ATTR freq_capture_get(uint8 channel, struct freq_capture_stats *stats) {
+  if (channel >= CHANNELS || !(pin_mask & BIT(capture_pins[channel])))
+    return false;
+  os_memcpy(stats, &channels[channel].stats, sizeof(*stats));
+  return true;
+}
+
+// Print the stats plus the two edge rate limits (see the top of this file)
+void ICACHE_FLASH_ATTR freq_capture_report(void) {
+  uint32 mhz = system_get_cpu_freq();
+  uint32 i;
+
+  for (i = 0; i < CHANNELS; i++) {
+    struct freq_capture_stats *s = &channels[i].stats;
+    os_printf("GPIO%d: %u.%03u Hz, duty %u.%u%%, period %u-%u us, high %u-%u us, dropped %u, missed %u\n",
+              capture_pins[i], s->freq_mhz / 1000, s->freq_mhz % 1000,
+              s->duty_permille / 10, s->duty_permille % 10,
+              s->period_min / mhz, s->period_max / mhz, s->high_min / mhz, s->high_max / mhz,
+              s->dropped, s->missed);
+  }
+
+  if (isr_cycles_max != 0)
+    os_printf("freq capture: isr max %u cycles (%u edges/s), ring limit %u edges/s\n",
+              isr_cycles_max, mhz * 1000000 / isr_cycles_max,
+              FREQ_CAPTURE_RING_SIZE * 1000 / FREQ_CAPTURE_DRAIN_MS);
+}
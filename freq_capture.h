@@ -0,0 +1,30 @@
+// Frequency and pulse width capture on GPIO inputs. Every edge on a capture pin
+// raises a GPIO interrupt which stamps it with CCOUNT and drops it in a per pin
+// ring buffer. An os_timer empties the rings (in task context, not in the
+// interrupt) and works out frequency, duty cycle and pulse widths over a
+// FREQ_CAPTURE_WINDOW_MS window, printing them when each window closes.
+
+#ifndef FREQ_CAPTURE_H
+#define FREQ_CAPTURE_H
+
+#include "c_types.h"
+
+// Results for one pin over the last measurement window. Times are in CPU cycles
+// so divide by system_get_cpu_freq() to get microseconds.
+struct freq_capture_stats {
+  uint32 freq_mhz;        // frequency in milli-Hz (1000 = 1Hz)
+  uint32 duty_permille;   // high time / period, 0 - 1000
+  uint32 period_min;
+  uint32 period_max;
+  uint32 high_min;        // shortest high pulse
+  uint32 high_max;        // longest high pulse
+  uint32 periods;         // number of full periods seen in the window
+  uint32 dropped;         // edges lost because the ring was full (total)
+  uint32 missed;          // edges the interrupt was too slow to see (total)
+};
+
+void freq_capture_init(void);
+bool freq_capture_get(uint8 channel, struct freq_capture_stats *stats);
+void freq_capture_report(void);
+
+#endif
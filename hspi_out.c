@@ -0,0 +1,225 @@
+// HSPI output driver ... see hspi_out.h.
+//
+// Each row is kept in the exact form it goes out on the wire (for the MAX7219
+// that means register/data pairs for every chip) so starting a transaction is
+// just copying words into SPI_W0..W15 and setting the USR bit.
+
+#include "ets_sys.h"
+#include "osapi.h"
+#include "gpio.h"
+#include "user_interface.h"
+#include "spi_register.h"
+#include "hspi_out.h"
+#include "user_config.h"
+#include "ccount.h"
+
+#define HSPI  1
+
+#if HSPI_OUT_DEVICE == HSPI_OUT_MAX7219
+#define ROWS         8
+#define ROW_BYTES    (HSPI_OUT_CHAIN * 2)
+#else
+#define ROWS         1
+#define ROW_BYTES    HSPI_OUT_CHAIN
+#endif
+
+#define ROW_WORDS    ((ROW_BYTES + 3) / 4)
+
+#if ROW_BYTES > 64
+#error "A row has to fit in the 64 byte HSPI buffer ... shorten HSPI_OUT_CHAIN"
+#endif
+
+// MAX7219 registers we use
+#define MAX7219_DECODE_MODE   0x09
+#define MAX7219_INTENSITY     0x0a
+#define MAX7219_SCAN_LIMIT    0x0b
+#define MAX7219_SHUTDOWN      0x0c
+#define MAX7219_DISPLAY_TEST  0x0f
+
+// The frame, word aligned so we can copy it straight into the SPI registers
+LOCAL uint32 frame[ROWS][ROW_WORDS];
+LOCAL volatile uint32 dirty;      // one bit per row that still has to go out
+LOCAL volatile bool busy;
+
+// Throughput bookkeeping
+LOCAL uint32 frame_start;
+LOCAL uint32 frames;
+LOCAL uint32 rows_sent;
+LOCAL uint32 frame_cycles_last;
+LOCAL uint32 frame_cycles_max;
+LOCAL uint32 busy_ticks;          // ticks that found the previous frame still going
+
+// Copy one row into the HSPI buffer and start the transaction. IRAM ... it's
+// called from the interrupt.
+LOCAL void start_row(uint8 row) {
+  uint32 i;
+
+  for (i = 0; i < ROW_WORDS; i++)
+    WRITE_PERI_REG(SPI_W0(HSPI) + i * 4, frame[row][i]);
+  SET_PERI_REG_MASK(SPI_CMD(HSPI), SPI_USR);
+  rows_sent++;
+}
+
+// Start the lowest dirty row, or finish the frame if there isn't one
+LOCAL void next_row(void) {
+  uint32 d = dirty;
+  uint8 row;
+
+  if (d == 0) {
+    busy = false;
+    frame_cycles_last = get_ccount() - frame_start;
+    if (frame_cycles_last > frame_cycles_max)
+      frame_cycles_max = frame_cycles_last;
+    frames++;
+    return;
+  }
+
+  row = __builtin_ctz(d);
+  dirty = d & ~BIT(row);
+  start_row(row);
+}
+
+// The SPI interrupt is shared between the flash SPI and HSPI. Bit 7 of the DPORT
+// interrupt status tells us it's ours.
+LOCAL void hspi_out_isr(void *arg) {
+  if (!(READ_PERI_REG(0x3ff00020) & BIT7))
+    return;
+
+  CLEAR_PERI_REG_MASK(SPI_SLAVE(HSPI), SPI_TRANS_DONE);
+  next_row();
+}
+
+// Send a raw row right away and wait for it. Only used during init, before the
+// interrupt is switched on.
+LOCAL void ICACHE_FLASH_ATTR send_now(const uint32 *words) {
+  uint32 i;
+
+  for (i = 0; i < ROW_WORDS; i++)
+    WRITE_PERI_REG(SPI_W0(HSPI) + i * 4, words[i]);
+  SET_PERI_REG_MASK(SPI_CMD(HSPI), SPI_USR);
+  while (READ_PERI_REG(SPI_CMD(HSPI)) & SPI_USR)
+    ;
+  CLEAR_PERI_REG_MASK(SPI_SLAVE(HSPI), SPI_TRANS_DONE);
+}
+
+#if HSPI_OUT_DEVICE == HSPI_OUT_MAX7219
+// Write the same register/value to every chip in the chain
+LOCAL void ICACHE_FLASH_ATTR max7219_all(uint8 reg, uint8 value) {
+  uint32 words[ROW_WORDS];
+  uint8 *bytes = (uint8 *)words;
+  uint32 i;
+
+  for (i = 0; i < HSPI_OUT_CHAIN; i++) {
+    bytes[i * 2] = reg;
+    bytes[i * 2 + 1] = value;
+  }
+  send_now(words);
+}
+#endif
+
+void ICACHE_FLASH_ATTR hspi_out_init(void) {
+  // Pins over to HSPI, HSPI clock derived from 80MHz (not the system clock)
+  PIN_FUNC_SELECT(PERIPHS_IO_MUX_MTCK_U, 2);
+  PIN_FUNC_SELECT(PERIPHS_IO_MUX_MTMS_U, 2);
+  PIN_FUNC_SELECT(PERIPHS_IO_MUX_MTDO_U, 2);
+  CLEAR_PERI_REG_MASK(PERIPHS_IO_MUX, BIT9);
+
+  // Clock = 80MHz / HSPI_OUT_CLK_PREDIV / HSPI_OUT_CLK_CNT
+  WRITE_PERI_REG(SPI_CLOCK(HSPI),
+                 (((HSPI_OUT_CLK_PREDIV - 1) & SPI_CLKDIV_PRE) << SPI_CLKDIV_PRE_S) |
+                 (((HSPI_OUT_CLK_CNT - 1) & SPI_CLKCNT_N) << SPI_CLKCNT_N_S) |
+                 (((HSPI_OUT_CLK_CNT / 2 - 1) & SPI_CLKCNT_H) << SPI_CLKCNT_H_S) |
+                 (((HSPI_OUT_CLK_CNT - 1) & SPI_CLKCNT_L) << SPI_CLKCNT_L_S));
+
+  // Write only transactions: no command, address, dummy or read phase. MSB first,
+  // bytes go out in the order they are in memory. CS wraps the whole row.
+  WRITE_PERI_REG(SPI_USER(HSPI), SPI_USR_MOSI | SPI_CS_SETUP | SPI_CS_HOLD);
+  CLEAR_PERI_REG_MASK(SPI_CTRL(HSPI), SPI_WR_BIT_ORDER);
+  WRITE_PERI_REG(SPI_USER1(HSPI), ((ROW_BYTES * 8 - 1) & SPI_USR_MOSI_BITLEN) << SPI_USR_MOSI_BITLEN_S);
+
+  // Everything blank to start with
+  os_bzero(frame, sizeof(frame));
+#if HSPI_OUT_DEVICE == HSPI_OUT_MAX7219
+  max7219_all(MAX7219_DISPLAY_TEST, 0);
+  max7219_all(MAX7219_DECODE_MODE, 0);
+  max7219_all(MAX7219_SCAN_LIMIT, 7);
+  max7219_all(MAX7219_INTENSITY, HSPI_OUT_INTENSITY);
+  max7219_all(MAX7219_SHUTDOWN, 1);
+  {
+    uint32 r, i;
+    for (r = 0; r < ROWS; r++)
+      for (i = 0; i < HSPI_OUT_CHAIN; i++)
+        ((uint8 *)frame[r])[i * 2] = r + 1;
+  }
+#endif
+  dirty = BIT(ROWS) - 1;
+  busy = false;
+
+  // Transaction done interrupt on
+  SET_PERI_REG_MASK(SPI_SLAVE(HSPI), SPI_TRANS_DONE_EN);
+  ETS_SPI_INTR_ATTACH(hspi_out_isr, NULL);
+  ETS_SPI_INTR_ENABLE();
+}
+
+// Change one row. data is HSPI_OUT_CHAIN bytes. The row is only marked dirty
+// if something actually changed. Returns false for a bad row number.
+bool ICACHE_FLASH_ATTR hspi_out_set_row(uint8 row, const uint8 *data) {
+  uint8 *bytes;
+  bool changed = false;
+  uint32 i;
+
+  if (row >= ROWS)
+    return false;
+
+  bytes = (uint8 *)frame[row];
+  for (i = 0; i < HSPI_OUT_CHAIN; i++) {
+#if HSPI_OUT_DEVICE == HSPI_OUT_MAX7219
+    // The first chip in the chain gets the LAST pair we shift out
+    uint8 *b = &bytes[(HSPI_OUT_CHAIN - 1 - i) * 2 + 1];
+#else
+    uint8 *b = &bytes[i];
+#endif
+    if (*b != data[i]) {
+      *b = data[i];
+      changed = true;
+    }
+  }
+
+  // The interrupt might be clearing bits at the same time
+  if (changed) {
+    ETS_SPI_INTR_DISABLE();
+    dirty |= BIT(row);
+    ETS_SPI_INTR_ENABLE();
+  }
+  return true;
+}
+
+// Called from the LED tick: start sending the dirty rows (if there are any and
+// we aren't still busy with the last frame).
+void hspi_out_tick(void) {
+  if (busy) {
+    busy_ticks++;
+    return;
+  }
+  if (dirty == 0)
+    return;
+
+  ETS_SPI_INTR_DISABLE();
+  busy = true;
+  frame_start = get_ccount();
+  next_row();
+  ETS_SPI_INTR_ENABLE();
+}
+
+// Frames, rows and how long a frame takes on the wire (bytes per second is
+// worked out from the last frame).
+void ICACHE_FLASH_ATTR hspi_out_report(void) {
+  uint32 mhz = system_get_cpu_freq();
+
+  os_printf("hspi out: %u frames, %u rows, frame %u us (max %u us), %u busy ticks",
+            frames, rows_sent, frame_cycles_last / mhz, frame_cycles_max / mhz, busy_ticks);
+  if (frame_cycles_last != 0)
+    os_printf(", %u bytes/s",
+              (uint32)((uint64)rows_sent * ROW_BYTES * mhz * 1000000 / frames / frame_cycles_last));
+  os_printf("\n");
+}
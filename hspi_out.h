@@ -0,0 +1,32 @@
+// HSPI output driver for LED panels: a chain of 74HC595 shift registers or a
+// chain of MAX7219 8x8 matrix drivers.
+//
+// Wiring (these are fixed by the HSPI hardware):
+//   GPIO13 (MTCK) = data in of the first chip (DIN / SER)
+//   GPIO14 (MTMS) = clock (CLK / SRCLK)
+//   GPIO15 (MTDO) = chip select / latch (LOAD / RCLK)
+//
+// You describe what should be on the panel with hspi_out_set_row. Nothing goes
+// out until the next hspi_out_tick, and then only the rows that changed. Each row
+// is one SPI transaction that fits in the 64 byte HSPI buffer, and the
+// "transaction done" interrupt starts the next dirty row, so a whole frame goes
+// out without the CPU waiting on the SPI.
+//
+// For 74HC595 chains there is one row of HSPI_OUT_CHAIN bytes (the first byte
+// ends up in the LAST chip of the chain). For MAX7219 chains there are 8 rows
+// (digits) with one byte per chip.
+
+#ifndef HSPI_OUT_H
+#define HSPI_OUT_H
+
+#include "c_types.h"
+
+#define HSPI_OUT_74HC595  0
+#define HSPI_OUT_MAX7219  1
+
+void hspi_out_init(void);
+bool hspi_out_set_row(uint8 row, const uint8 *data);
+void hspi_out_tick(void);
+void hspi_out_report(void);
+
+#endif
@@ -0,0 +1,71 @@
+// Hardware timer (FRC1) wrapper ... see hw_timer.h.
+//
+// These bits come from the SDK's hw_timer.c example driver. They aren't in any
+// of the SDK headers so we define them here.
+
+#include "ets_sys.h"
+#include "osapi.h"
+#include "hw_timer.h"
+
+#define FRC1_ENABLE_TIMER  BIT7
+#define FRC1_AUTO_LOAD     BIT6
+#define FRC1_DIV_BY_1      0
+#define FRC1_EDGE_INT      0
+
+// Who owns the timer right now (NULL callback means nobody)
+LOCAL hw_timer_cb_t timer_cb = NULL;
+LOCAL void *timer_arg = NULL;
+
+// The actual interrupt handler. Clear the interrupt and hand over to the owner.
+// No ICACHE_FLASH_ATTR ... interrupt handlers must be in IRAM.
+LOCAL void hw_timer_isr(void *unused) {
+  RTC_CLR_REG_MASK(FRC1_INT_ADDRESS, FRC1_INT_CLR_MASK);
+  if (timer_cb != NULL)
+    timer_cb(timer_arg);
+}
+
+// Claim the timer. Returns false if somebody else already has it.
+bool ICACHE_FLASH_ATTR hw_timer_claim(hw_timer_cb_t cb, void *arg) {
+  if (timer_cb != NULL || cb == NULL)
+    return false;
+
+  timer_cb = cb;
+  timer_arg = arg;
+
+  ETS_FRC_TIMER1_INTR_ATTACH(hw_timer_isr, NULL);
+  TM1_EDGE_INT_ENABLE();
+  ETS_FRC1_INTR_ENABLE();
+  return true;
+}
+
+// Stop the timer and give it back
+void ICACHE_FLASH_ATTR hw_timer_release(void) {
+  hw_timer_stop();
+  ETS_FRC1_INTR_DISABLE();
+  TM1_EDGE_INT_DISABLE();
+  timer_cb = NULL;
+  timer_arg = NULL;
+}
+
+// Start the timer. ticks are 80MHz ticks (see HW_TIMER_TICKS_PER_US). If repeat
+// is true the hardware reloads itself, otherwise the owner has to call
+// hw_timer_reload from its callback to get another interrupt.
+void hw_timer_start(uint32 ticks, bool repeat) {
+  if (ticks < HW_TIMER_MIN_TICKS)
+    ticks = HW_TIMER_MIN_TICKS;
+  if (ticks > HW_TIMER_MAX_TICKS)
+    ticks = HW_TIMER_MAX_TICKS;
+
+  RTC_REG_WRITE(FRC1_CTRL_ADDRESS,
+                (repeat ? FRC1_AUTO_LOAD : 0) | FRC1_DIV_BY_1 | FRC1_ENABLE_TIMER | FRC1_EDGE_INT);
+  RTC_REG_WRITE(FRC1_LOAD_ADDRESS, ticks);
+}
+
+// Load a new count. Meant to be called from the owner's callback, so it's in IRAM too.
+void hw_timer_reload(uint32 ticks) {
+  RTC_REG_WRITE(FRC1_LOAD_ADDRESS, ticks);
+}
+
+void hw_timer_stop(void) {
+  RTC_REG_WRITE(FRC1_CTRL_ADDRESS, 0);
+}
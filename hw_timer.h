@@ -0,0 +1,35 @@
+// Hardware timer (FRC1) wrapper. The os_timer we use to blink the LED is a
+// software timer with millisecond resolution and plenty of jitter. When we need
+// microsecond timing (sampling, waveform generation) we have to use the FRC1
+// hardware timer and its interrupt instead.
+//
+// There is only ONE FRC1 on the SoC, so whoever wants it must claim it first
+// and release it when done. A claim fails if somebody else is using it.
+
+#ifndef HW_TIMER_H
+#define HW_TIMER_H
+
+#include "c_types.h"
+
+// FRC1 is clocked from the 80MHz APB clock (even when the CPU runs at 160MHz).
+// We run it undivided so one tick is 12.5ns.
+#define HW_TIMER_TICKS_PER_US   80
+
+// The FRC1 load register is only 23 bits wide.
+#define HW_TIMER_MAX_TICKS      0x7fffff
+
+// Don't ask for anything shorter than this ... the interrupt entry and exit alone
+// take a couple of microseconds worth of cycles.
+#define HW_TIMER_MIN_TICKS      (HW_TIMER_TICKS_PER_US * 2)
+
+// The callback runs in interrupt context! Keep it short, keep it in IRAM (no
+// ICACHE_FLASH_ATTR) and don't call anything that might touch flash.
+typedef void (*hw_timer_cb_t)(void *arg);
+
+bool hw_timer_claim(hw_timer_cb_t cb, void *arg);
+void hw_timer_release(void);
+void hw_timer_start(uint32 ticks, bool repeat);
+void hw_timer_reload(uint32 ticks);
+void hw_timer_stop(void);
+
+#endif
@@ -0,0 +1,70 @@
+// Firmware CRC ... see image_crc.h.
+//
+// The linker script (eagle.app.v6.ld) tells us where the irom0 code starts and
+// ends. Those are addresses in the flash cache window at 0x40200000, so take
+// that off to get the offset in flash for spi_flash_read.
+
+#include "ets_sys.h"
+#include "osapi.h"
+#include "spi_flash.h"
+#include "image_crc.h"
+#include "slice_sched.h"
+
+#define FLASH_CACHE_BASE  0x40200000
+
+extern char _irom0_text_start[];
+extern char _irom0_text_end[];
+
+// CRC32 (the zip one) four bits at a time ... 64 bytes of table instead of 1k
+LOCAL const uint32 crc_nibble[16] = {
+  0x00000000, 0x1db71064, 0x3b6e20c8, 0x26d930ac, 0x76dc4190, 0x6b6b51f4, 0x4db26158, 0x5005713c,
+  0xedb88320, 0xf00f9344, 0xd6d6a3e8, 0xcb61b38c, 0x9b64c2b0, 0x86d3d2d4, 0xa00ae278, 0xbdbdf21c
+};
+
+LOCAL struct slice_job crc_job;
+LOCAL uint32 crc_buffer[IMAGE_CRC_CHUNK / 4];
+LOCAL uint32 crc_offset;
+LOCAL uint32 crc_end;
+LOCAL uint32 crc;
+
+LOCAL uint8 ICACHE_FLASH_ATTR image_crc_step(void *arg) {
+  uint32 len = crc_end - crc_offset;
+  const uint8 *p = (const uint8 *)crc_buffer;
+  uint32 i;
+
+  if (len > IMAGE_CRC_CHUNK)
+    len = IMAGE_CRC_CHUNK;
+
+  // spi_flash_read wants a multiple of 4 bytes, the last bit of the image might not be
+  if (spi_flash_read(crc_offset, crc_buffer, (len + 3) & ~3) != SPI_FLASH_RESULT_OK) {
+    os_printf("image crc: flash read failed at 0x%05x\n", crc_offset);
+    return SLICE_JOB_DONE;
+  }
+
+  for (i = 0; i < len; i++) {
+    crc ^= p[i];
+    crc = (crc >> 4) ^ crc_nibble[crc & 0xf];
+    crc = (crc >> 4) ^ crc_nibble[crc & 0xf];
+  }
+
+  crc_offset += len;
+  if (crc_offset < crc_end)
+    return SLICE_JOB_MORE;
+
+  os_printf("image crc: 0x%08x over %u bytes at 0x%05x\n",
+            ~crc, crc_end - ((uint32)_irom0_text_start - FLASH_CACHE_BASE),
+            (uint32)_irom0_text_start - FLASH_CACHE_BASE);
+  return SLICE_JOB_DONE;
+}
+
+// Start working out the CRC. Returns false if it's already running (or the
+// scheduler is full).
+bool ICACHE_FLASH_ATTR image_crc_start(void) {
+  if (crc_job.queued)
+    return false;
+
+  crc_offset = (uint32)_irom0_text_start - FLASH_CACHE_BASE;
+  crc_end = (uint32)_irom0_text_end - FLASH_CACHE_BASE;
+  crc = 0xffffffff;
+  return slice_sched_submit(&crc_job, image_crc_step, NULL, "image crc", SLICE_PRIO_LOW);
+}
@@ -0,0 +1,15 @@
+// CRC32 of the firmware (the irom0 part, the one at 0x10000) read back from flash.
+// Reading and crunching half a megabyte takes way longer than a callback is
+// allowed to, so it runs as a slice_sched job, IMAGE_CRC_CHUNK bytes per call.
+// The result is printed when it's done.
+
+#ifndef IMAGE_CRC_H
+#define IMAGE_CRC_H
+
+#include "c_types.h"
+
+#define IMAGE_CRC_CHUNK   256   // bytes per call (multiple of 4)
+
+bool image_crc_start(void);
+
+#endif
@@ -0,0 +1,27 @@
+// Preencoded IR codes for ir_tx.c. Each code is a list of mark/space times in
+// microseconds, starting with a mark (carrier on). Encode them on your PC (or
+// copy them from a capture) and paste them in here ... the firmware doesn't know
+// or care about NEC, RC5 or any other protocol.
+//
+// Keep the arrays in RAM (no ICACHE_RODATA_ATTR) because the IR interrupt reads
+// them and 16 bit reads from flash crash the ESP8266.
+
+#ifndef IR_CODES_H
+#define IR_CODES_H
+
+#include "c_types.h"
+
+// NEC, address 0x00, command 0x45 (9ms leader, 4.5ms space, 32 bits, stop mark)
+LOCAL const uint16 ir_code_nec_00_45[] = {
+  9000, 4500, 562, 562, 562, 562, 562, 562,
+  562, 562, 562, 562, 562, 562, 562, 562,
+  562, 562, 562, 1687, 562, 1687, 562, 1687,
+  562, 1687, 562, 1687, 562, 1687, 562, 1687,
+  562, 1687, 562, 1687, 562, 562, 562, 1687,
+  562, 562, 562, 562, 562, 562, 562, 1687,
+  562, 562, 562, 562, 562, 1687, 562, 562,
+  562, 1687, 562, 1687, 562, 1687, 562, 562,
+  562, 1687, 562,
+};
+
+#endif
@@ -0,0 +1,213 @@
+// IR transmitter ... see ir_tx.h.
+//
+// During a mark the timer runs in auto reload mode at half the carrier period
+// and every interrupt toggles the pin. The toggle is done in software by the
+// interrupt, so every carrier edge comes out late by however long its interrupt
+// took to be serviced (a few hundred ns, more while the WiFi code has interrupts
+// off), and that differs from edge to edge. Auto reload doesn't remove that
+// jitter. What it does is raise the interrupts on a fixed schedule, so a late
+// edge doesn't push the ones after it back: each edge is off by its own latency
+// only, and the error doesn't build up over a mark. It does build up a little
+// from segment to segment, because every mark/space change restarts the timer
+// from inside a (late) interrupt. During a space we need no edges at all, so the
+// timer is loaded once with the whole space time.
+//
+// The last edge of a mark isn't toggled: the space starting in that same
+// interrupt pulls the pin low. Toggling it first would put a glitch on the pin
+// when a mark has an even number of edges.
+//
+// test/host/ir_tx_test.c runs this against a simulated FRC1 with random
+// interrupt latency and checks the edges against that schedule.
+//
+// The carrier frequency can only be a whole number of 12.5ns timer ticks. At 38kHz
+// that's 1053 ticks per half period, or 37986Hz ... about 0.04% low, which is far
+// inside what any IR receiver accepts. ir_tx_report prints the exact error.
+//
+// Timing is measured while we send:
+//   - edge jitter: the spread between the shortest and longest gap between two
+//     carrier edges, as seen by CCOUNT in the interrupt
+//   - segment error: the worst difference between the mark/space time we were
+//     asked for and the time we actually spent in it
+
+#include "ets_sys.h"
+#include "osapi.h"
+#include "gpio.h"
+#include "os_type.h"
+#include "user_interface.h"
+#include "ir_tx.h"
+#include "user_config.h"
+#include "hw_timer.h"
+#include "ccount.h"
+#include "typed_timer.h"
+
+#define HALF_PERIOD_TICKS  ((80000000 + IR_TX_CARRIER_HZ) / (2 * IR_TX_CARRIER_HZ))
+#define PIN_BIT            BIT(IR_TX_PIN)
+
+LOCAL struct {
+  const uint16 *code;
+  uint16 len;
+  uint16 idx;               // segment we are in (even = mark, odd = space)
+  uint32 toggles_left;      // half carrier periods (interrupts) left in this mark
+  volatile bool busy;
+
+  // Measurements (CPU cycles)
+  uint32 cycles_per_us;
+  uint32 last_edge;
+  uint32 edge_min;
+  uint32 edge_max;
+  uint32 segment_start;
+  uint32 segment_err_max;
+  uint32 sends;
+} ir;
+
+// Polls for the end of a send so we can give the hardware timer back (that
+// can't be done from the interrupt)
+LOCAL os_timer_t done_timer;
+
+// Start segment ir.idx (or finish if we are out of segments). IRAM ... called
+// from the interrupt.
+LOCAL void start_segment(void) {
+  uint32 now = get_ccount();
+  uint32 us;
+
+  // How far off was the segment we just finished?
+  if (ir.idx > 0) {
+    uint32 want = ir.code[ir.idx - 1] * ir.cycles_per_us;
+    uint32 got = now - ir.segment_start;
+    uint32 err = (got > want) ? got - want : want - got;
+    if (err > ir.segment_err_max)
+      ir.segment_err_max = err;
+  }
+  ir.segment_start = now;
+
+  if (ir.idx >= ir.len) {
+    hw_timer_stop();
+    GPIO_REG_WRITE(GPIO_OUT_W1TC_ADDRESS, PIN_BIT);
+    ir.busy = false;
+    return;
+  }
+
+  us = ir.code[ir.idx];
+  if ((ir.idx & 1) == 0) {
+    // Mark: carrier on for a whole number of half periods, rounded. An
+    // interrupt ends each one, all but the last toggle the pin.
+    ir.toggles_left = (us * 2 * (IR_TX_CARRIER_HZ / 100) + 5000) / 10000;
+    if (ir.toggles_left == 0)
+      ir.toggles_left = 1;
+    ir.last_edge = now;
+    GPIO_REG_WRITE(GPIO_OUT_W1TS_ADDRESS, PIN_BIT);
+    hw_timer_start(HALF_PERIOD_TICKS, true);
+  } else {
+    // Space: carrier off for the whole time
+    GPIO_REG_WRITE(GPIO_OUT_W1TC_ADDRESS, PIN_BIT);
+    hw_timer_start(us * HW_TIMER_TICKS_PER_US, false);
+  }
+}
+
+// Timer interrupt. No ICACHE_FLASH_ATTR, this has to be in IRAM.
+LOCAL void ir_tx_isr(void *arg) {
+  uint32 now;
+  uint32 gap;
+
+  if (ir.idx & 1) {
+    // End of a space
+    ir.idx++;
+    start_segment();
+    return;
+  }
+
+  // End of a mark
+  if (--ir.toggles_left == 0) {
+    ir.idx++;
+    start_segment();
+    return;
+  }
+
+  // Carrier edge
+  now = get_ccount();
+  if (GPIO_REG_READ(GPIO_OUT_ADDRESS) & PIN_BIT)
+    GPIO_REG_WRITE(GPIO_OUT_W1TC_ADDRESS, PIN_BIT);
+  else
+    GPIO_REG_WRITE(GPIO_OUT_W1TS_ADDRESS, PIN_BIT);
+
+  gap = now - ir.last_edge;
+  ir.last_edge = now;
+  if (gap < ir.edge_min)
+    ir.edge_min = gap;
+  if (gap > ir.edge_max)
+    ir.edge_max = gap;
+}
+
+LOCAL bool ICACHE_FLASH_ATTR select_gpio(uint8 pin) {
+  switch (pin) {
+    case 4:  PIN_FUNC_SELECT(PERIPHS_IO_MUX_GPIO4_U, FUNC_GPIO4); break;
+    case 5:  PIN_FUNC_SELECT(PERIPHS_IO_MUX_GPIO5_U, FUNC_GPIO5); break;
+    case 12: PIN_FUNC_SELECT(PERIPHS_IO_MUX_MTDI_U, FUNC_GPIO12); break;
+    case 13: PIN_FUNC_SELECT(PERIPHS_IO_MUX_MTCK_U, FUNC_GPIO13); break;
+    case 14: PIN_FUNC_SELECT(PERIPHS_IO_MUX_MTMS_U, FUNC_GPIO14); break;
+    default: return false;
+  }
+  return true;
+}
+
+void ICACHE_FLASH_ATTR ir_tx_init(void) {
+  if (!select_gpio(IR_TX_PIN)) {
+    os_printf("ir tx: GPIO%d can't be used\n", IR_TX_PIN);
+    return;
+  }
+  // Output, LED off
+  gpio_output_set(0, PIN_BIT, PIN_BIT, 0);
+  ir.busy = false;
+}
+
+LOCAL void ICACHE_FLASH_ATTR done_timer_function(void *arg) {
+  if (ir.busy)
+    return;
+  os_timer_disarm(&done_timer);
+  hw_timer_release();
+  ir_tx_report();
+}
+
+// Start sending a code. Returns false if we are still sending the last one or
+// the hardware timer is taken. code must stay valid until ir_tx_busy is false.
+bool ICACHE_FLASH_ATTR ir_tx_send(const uint16 *code, uint16 len) {
+  if (ir.busy || len == 0)
+    return false;
+
+  if (!hw_timer_claim(ir_tx_isr, NULL))
+    return false;
+
+  ir.code = code;
+  ir.len = len;
+  ir.idx = 0;
+  ir.cycles_per_us = system_get_cpu_freq();
+  ir.edge_min = 0xffffffff;
+  ir.edge_max = 0;
+  ir.segment_err_max = 0;
+  ir.busy = true;
+  ir.sends++;
+  start_segment();
+
+  os_timer_disarm(&done_timer);
+  TYPED_TIMER_SETFN(&done_timer, done_timer_function, NULL);
+  os_timer_arm(&done_timer, 10, 1);
+  return true;
+}
+
+bool ICACHE_FLASH_ATTR ir_tx_busy(void) {
+  return ir.busy;
+}
+
+// Carrier error and measured timing of the last send (in ns)
+void ICACHE_FLASH_ATTR ir_tx_report(void) {
+  uint32 actual = 80000000 / (2 * HALF_PERIOD_TICKS);
+  sint32 error_ppm = ((sint32)actual - IR_TX_CARRIER_HZ) * 1000000 / IR_TX_CARRIER_HZ;
+  uint32 mhz = system_get_cpu_freq();
+
+  os_printf("ir tx: carrier %u Hz (%d ppm), %u sends", actual, error_ppm, ir.sends);
+  if (ir.edge_max != 0)
+    os_printf(", edge gap %u-%u ns (jitter %u ns), worst segment error %u ns",
+              ir.edge_min * 1000 / mhz, ir.edge_max * 1000 / mhz,
+              (ir.edge_max - ir.edge_min) * 1000 / mhz, ir.segment_err_max * 1000 / mhz);
+  os_printf("\n");
+}
@@ -0,0 +1,19 @@
+// IR transmitter. Sends a preencoded list of mark/space times (see ir_codes.h)
+// on IR_TX_PIN with a IR_TX_CARRIER_HZ carrier during the marks. The carrier is
+// made by toggling the pin from the FRC1 hardware timer interrupt, so IR can't
+// be sent while something else (like the logic analyzer) has the timer.
+//
+// Drive the IR LED through a transistor ... a GPIO can't supply the 50-100mA an
+// IR LED wants.
+
+#ifndef IR_TX_H
+#define IR_TX_H
+
+#include "c_types.h"
+
+void ir_tx_init(void);
+bool ir_tx_send(const uint16 *code, uint16 len);
+bool ir_tx_busy(void);
+void ir_tx_report(void);
+
+#endif
@@ -0,0 +1,81 @@
+// LED blinker ... see led_blink.h.
+//
+// If a brightness function is given the LED's pin must already be attached to
+// the sigma-delta modulator (see sigma_delta.h). We still flip the output register
+// (it costs nothing) but it's the modulator target that turns the LED on and off.
+// There is only one modulator, so only one LED can be dimmed at a time.
+
+#include "ets_sys.h"
+#include "osapi.h"
+#include "gpio.h"
+#include "led_blink.h"
+#include "typed_timer.h"
+#include "sigma_delta.h"
+
+LOCAL struct led_blink pool[LED_BLINK_POOL_SIZE];
+
+// The one timer callback for every LED. No ICACHE_FLASH_ATTR, this runs a lot.
+// Don't forget the os_delay_us to allow the SoC time to do other functions!
+LOCAL void led_blink_step(struct led_blink *blink) {
+  if (blink->pattern[blink->phase]) {
+    gpio_output_set(blink->pin_mask, 0, blink->pin_mask, 0);
+    if (blink->brightness != NULL)
+      sigma_delta_set_target(blink->brightness());
+  } else {
+    gpio_output_set(0, blink->pin_mask, blink->pin_mask, 0);
+    if (blink->brightness != NULL)
+      sigma_delta_set_target(0);
+  }
+
+  if (++blink->phase >= blink->length)
+    blink->phase = 0;
+
+  os_delay_us(100);
+}
+
+// Grab a block from the pool and start blinking. Returns NULL if the pool is
+// empty or the pattern is.
+struct led_blink * ICACHE_FLASH_ATTR led_blink_start(uint32 pin_mask, const uint8 *pattern, uint8 length,
+                                                     uint32 step_ms, uint8 (*brightness)(void)) {
+  struct led_blink *blink = NULL;
+  uint32 i;
+
+  if (pattern == NULL || length == 0)
+    return NULL;
+
+  for (i = 0; i < LED_BLINK_POOL_SIZE; i++) {
+    if (!pool[i].in_use) {
+      blink = &pool[i];
+      break;
+    }
+  }
+  if (blink == NULL)
+    return NULL;
+
+  blink->in_use = true;
+  blink->pin_mask = pin_mask;
+  blink->pattern = pattern;
+  blink->length = length;
+  blink->phase = 0;
+  blink->brightness = brightness;
+
+  os_timer_disarm(&blink->timer);
+  TYPED_TIMER_SETFN(&blink->timer, led_blink_step, blink);
+  os_timer_arm(&blink->timer, step_ms, 1);
+
+  // Show the first step now instead of a whole step_ms from now
+  led_blink_step(blink);
+  return blink;
+}
+
+// Stop blinking, leave the LED off and give the block back to the pool
+void ICACHE_FLASH_ATTR led_blink_stop(struct led_blink *blink) {
+  if (blink == NULL || !blink->in_use)
+    return;
+
+  os_timer_disarm(&blink->timer);
+  gpio_output_set(0, blink->pin_mask, blink->pin_mask, 0);
+  if (blink->brightness != NULL)
+    sigma_delta_set_target(0);
+  blink->in_use = false;
+}
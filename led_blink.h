@@ -0,0 +1,32 @@
+// LED blinker. Each blinking LED gets a block from a small pool holding its own
+// os_timer and a context (which pins, which pattern, where in the pattern we
+// are), and ONE timer callback serves all of them. Before, every LED needed its
+// own timer, its own timer function and its own globals.
+//
+// A pattern is a list of steps, 1 = on and 0 = off, played in a loop with
+// step_ms per step. { 1, 0 } is a plain blink, { 1, 0, 1, 0, 0, 0 } a double
+// blink and so on.
+
+#ifndef LED_BLINK_H
+#define LED_BLINK_H
+
+#include "c_types.h"
+#include "os_type.h"
+
+#define LED_BLINK_POOL_SIZE  4
+
+struct led_blink {
+  os_timer_t timer;
+  uint32 pin_mask;            // GPIO bits this LED is on (can be more than one)
+  const uint8 *pattern;       // keep patterns in RAM, the timer reads them
+  uint8 length;
+  uint8 phase;                // next step to show
+  bool in_use;
+  uint8 (*brightness)(void);  // optional: dim via the sigma-delta modulator
+};
+
+struct led_blink *led_blink_start(uint32 pin_mask, const uint8 *pattern, uint8 length,
+                                  uint32 step_ms, uint8 (*brightness)(void));
+void led_blink_stop(struct led_blink *blink);
+
+#endif
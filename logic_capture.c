@@ -0,0 +1,290 @@
+// Logic analyzer capture mode ... see logic_capture.h for the stream format.
+//
+// How it works: the FRC1 hardware timer fires at the sample rate and its
+// interrupt reads the GPIO input register, picks out our channels and packs
+// them into the capture buffer. If a trigger is set we throw samples away until
+// the trigger channel shows the wanted edge. Once the buffer is full the
+// interrupt stops the timer and a (slow) os_timer takes over to stream the
+// buffer out in batches so we don't hog the WiFi.
+//
+// The interrupt also watches CCOUNT between samples. If two interrupts are further
+// apart than 1.5 sample periods we were late (WiFi interrupts have priority over us)
+// and we count the samples we lost in capture.dropped. The longest time spent inside
+// the interrupt is kept as well, which gives the upper bound of the sample rate.
+
+#include "ets_sys.h"
+#include "osapi.h"
+#include "gpio.h"
+#include "os_type.h"
+#include "user_interface.h"
+#include "espconn.h"
+#include "uart_register.h"
+#include "logic_capture.h"
+#include "user_config.h"
+#include "hw_timer.h"
+#include "ccount.h"
+#include "typed_timer.h"
+
+#if LOGIC_CAPTURE_CHANNELS != 1 && LOGIC_CAPTURE_CHANNELS != 2 && \
+    LOGIC_CAPTURE_CHANNELS != 4 && LOGIC_CAPTURE_CHANNELS != 8
+#error "LOGIC_CAPTURE_CHANNELS must be 1, 2, 4 or 8"
+#endif
+
+#define CHANNEL_MASK      ((1 << LOGIC_CAPTURE_CHANNELS) - 1)
+#define TRIGGER_MASK      (1 << LOGIC_CAPTURE_TRIGGER_CHANNEL)
+#define SAMPLE_COUNT      (LOGIC_CAPTURE_BUFFER_BYTES * 8 / LOGIC_CAPTURE_CHANNELS)
+#define HEADER_BYTES      22
+#define DATA_HEADER_BYTES 6
+#define STREAM_VERSION    1
+
+enum capture_state {
+  CAPTURE_IDLE,
+  CAPTURE_ARMED,      // waiting for the trigger edge
+  CAPTURE_RUNNING,    // filling the buffer
+  CAPTURE_DONE,       // buffer full, waiting for the stream timer to notice
+  CAPTURE_STREAMING   // sending the buffer out
+};
+
+// Everything the interrupt touches lives in here. state is volatile because
+// the interrupt and the stream timer both look at it.
+LOCAL struct {
+  volatile uint8 state;
+  uint8 trigger;
+  uint8 prev;           // previous sample (for the trigger)
+  uint8 acc;            // byte we are currently packing samples into
+  uint8 acc_bits;       // number of bits used in acc
+  uint32 pos;           // next free byte in the buffer
+  uint32 rate_hz;
+  uint32 period_cycles; // CPU cycles between two samples
+  uint32 last_ccount;   // CCOUNT at the previous interrupt
+  uint32 dropped;       // samples we lost because we were late
+  uint32 isr_cycles_max;
+} capture;
+
+LOCAL uint8 capture_buf[LOGIC_CAPTURE_BUFFER_BYTES];
+
+// Streaming state. We build one packet at a time in tx_buf and send it.
+LOCAL os_timer_t stream_timer;
+LOCAL uint8 tx_buf[DATA_HEADER_BYTES + LOGIC_CAPTURE_BATCH_BYTES];
+LOCAL uint16 tx_len;
+LOCAL uint16 tx_pos;
+LOCAL uint32 stream_pos;   // next byte of capture_buf to put into a packet
+LOCAL bool header_sent;
+
+#if LOGIC_CAPTURE_OUTPUT == LOGIC_CAPTURE_OUT_UDP
+LOCAL struct espconn udp_conn;
+LOCAL esp_udp udp_proto;
+#endif
+
+// The sampling interrupt. No ICACHE_FLASH_ATTR ... this has to be in IRAM and fast.
+LOCAL void logic_capture_isr(void *arg) {
+  uint32 now = get_ccount();
+  uint8 sample = (GPIO_REG_READ(GPIO_IN_ADDRESS) >> LOGIC_CAPTURE_FIRST_GPIO) & CHANNEL_MASK;
+  uint32 gap = now - capture.last_ccount;
+
+  // Were we late? Then we missed gap / period - 1 samples.
+  if (capture.last_ccount != 0 && gap > capture.period_cycles + (capture.period_cycles >> 1))
+    capture.dropped += gap / capture.period_cycles - 1;
+  capture.last_ccount = now;
+
+  if (capture.state == CAPTURE_ARMED) {
+    uint8 was = capture.prev & TRIGGER_MASK;
+    uint8 is = sample & TRIGGER_MASK;
+    capture.prev = sample;
+    if ((capture.trigger == LOGIC_CAPTURE_TRIGGER_RISING && !(!was && is)) ||
+        (capture.trigger == LOGIC_CAPTURE_TRIGGER_FALLING && !(was && !is)))
+      goto out;
+    capture.state = CAPTURE_RUNNING;
+  }
+
+  if (capture.state != CAPTURE_RUNNING)
+    goto out;
+
+  capture.acc |= sample << capture.acc_bits;
+  capture.acc_bits += LOGIC_CAPTURE_CHANNELS;
+  if (capture.acc_bits == 8) {
+    capture_buf[capture.pos++] = capture.acc;
+    capture.acc = 0;
+    capture.acc_bits = 0;
+    if (capture.pos == LOGIC_CAPTURE_BUFFER_BYTES) {
+      hw_timer_stop();
+      capture.state = CAPTURE_DONE;
+    }
+  }
+
+out:
+  gap = get_ccount() - now;
+  if (gap > capture.isr_cycles_max)
+    capture.isr_cycles_max = gap;
+}
+
+LOCAL void ICACHE_FLASH_ATTR put_u16(uint8 *p, uint16 v) {
+  p[0] = v & 0xff;
+  p[1] = v >> 8;
+}
+
+LOCAL void ICACHE_FLASH_ATTR put_u32(uint8 *p, uint32 v) {
+  put_u16(p, v & 0xffff);
+  put_u16(p + 2, v >> 16);
+}
+
+// Build the next packet (header first, then data batches) into tx_buf.
+// Returns false when there is nothing left to send.
+LOCAL bool ICACHE_FLASH_ATTR next_packet(void) {
+  uint32 len;
+
+  if (!header_sent) {
+    tx_buf[0] = 'L';
+    tx_buf[1] = 'A';
+    tx_buf[2] = STREAM_VERSION;
+    tx_buf[3] = LOGIC_CAPTURE_CHANNELS;
+    tx_buf[4] = LOGIC_CAPTURE_FIRST_GPIO;
+    tx_buf[5] = capture.trigger;
+    put_u32(tx_buf + 6, capture.rate_hz);
+    put_u32(tx_buf + 10, SAMPLE_COUNT);
+    put_u32(tx_buf + 14, capture.dropped);
+    put_u32(tx_buf + 18, capture.isr_cycles_max);
+    tx_len = HEADER_BYTES;
+    tx_pos = 0;
+    header_sent = true;
+    return true;
+  }
+
+  if (stream_pos >= LOGIC_CAPTURE_BUFFER_BYTES)
+    return false;
+
+  len = LOGIC_CAPTURE_BUFFER_BYTES - stream_pos;
+  if (len > LOGIC_CAPTURE_BATCH_BYTES)
+    len = LOGIC_CAPTURE_BATCH_BYTES;
+
+  tx_buf[0] = 'L';
+  tx_buf[1] = 'D';
+  put_u16(tx_buf + 2, stream_pos);
+  put_u16(tx_buf + 4, len);
+  os_memcpy(tx_buf + DATA_HEADER_BYTES, capture_buf + stream_pos, len);
+  tx_len = DATA_HEADER_BYTES + len;
+  tx_pos = 0;
+  stream_pos += len;
+  return true;
+}
+
+// Push out as much of the current packet as we can without blocking.
+// Returns true once the whole packet is gone.
+LOCAL bool ICACHE_FLASH_ATTR send_packet(void) {
+#if LOGIC_CAPTURE_OUTPUT == LOGIC_CAPTURE_OUT_UDP
+  // espconn_send copies the data, so if it's accepted we are done with tx_buf.
+  // If it isn't (out of buffers) we simply try again on the next tick.
+  if (espconn_send(&udp_conn, tx_buf, tx_len) != 0)
+    return false;
+  tx_pos = tx_len;
+#else
+  // The UART FIFO is 128 bytes deep. Fill whatever space is free and come back later.
+  uint32 used = (READ_PERI_REG(UART_STATUS(0)) >> UART_TXFIFO_CNT_S) & UART_TXFIFO_CNT;
+  while (used < 126 && tx_pos < tx_len) {
+    WRITE_PERI_REG(UART_FIFO(0), tx_buf[tx_pos++]);
+    used++;
+  }
+#endif
+  return tx_pos == tx_len;
+}
+
+// Stream timer ... runs every LOGIC_CAPTURE_BATCH_MS. Waits for the interrupt
+// to finish the capture, then sends one batch per run.
+LOCAL void ICACHE_FLASH_ATTR stream_timer_function(void *arg) {
+  if (capture.state == CAPTURE_DONE) {
+    hw_timer_release();
+    capture.state = CAPTURE_STREAMING;
+    header_sent = false;
+    stream_pos = 0;
+    tx_len = 0;
+    tx_pos = 0;
+    logic_capture_report();
+  }
+
+  if (capture.state != CAPTURE_STREAMING)
+    return;
+
+  if (tx_pos == tx_len && !next_packet()) {
+    // All sent ... back to idle
+    os_timer_disarm(&stream_timer);
+    capture.state = CAPTURE_IDLE;
+    return;
+  }
+
+  send_packet();
+}
+
+// One time setup of the output channel
+void ICACHE_FLASH_ATTR logic_capture_init(void) {
+#if LOGIC_CAPTURE_OUTPUT == LOGIC_CAPTURE_OUT_UDP
+  const uint8 remote_ip[4] = { LOGIC_CAPTURE_UDP_IP };
+
+  os_bzero(&udp_proto, sizeof(udp_proto));
+  os_memcpy(udp_proto.remote_ip, remote_ip, 4);
+  udp_proto.remote_port = LOGIC_CAPTURE_UDP_PORT;
+  udp_proto.local_port = espconn_port();
+  udp_conn.type = ESPCONN_UDP;
+  udp_conn.state = ESPCONN_NONE;
+  udp_conn.proto.udp = &udp_proto;
+  espconn_create(&udp_conn);
+#endif
+  capture.state = CAPTURE_IDLE;
+}
+
+// Start a capture. Returns false if a capture is already in progress, the rate
+// is out of range or somebody else owns the hardware timer.
+bool ICACHE_FLASH_ATTR logic_capture_start(uint32 sample_rate_hz, uint8 trigger) {
+  uint32 ticks;
+
+  if (capture.state != CAPTURE_IDLE || sample_rate_hz == 0)
+    return false;
+
+  ticks = HW_TIMER_TICKS_PER_US * 1000000 / sample_rate_hz;
+  if (ticks < HW_TIMER_MIN_TICKS || ticks > HW_TIMER_MAX_TICKS)
+    return false;
+
+  if (!hw_timer_claim(logic_capture_isr, NULL))
+    return false;
+
+  capture.trigger = trigger;
+  capture.prev = (GPIO_REG_READ(GPIO_IN_ADDRESS) >> LOGIC_CAPTURE_FIRST_GPIO) & CHANNEL_MASK;
+  capture.acc = 0;
+  capture.acc_bits = 0;
+  capture.pos = 0;
+  capture.rate_hz = sample_rate_hz;
+  capture.period_cycles = system_get_cpu_freq() * 1000000 / sample_rate_hz;
+  capture.last_ccount = 0;
+  capture.dropped = 0;
+  capture.isr_cycles_max = 0;
+  capture.state = (trigger == LOGIC_CAPTURE_TRIGGER_NONE) ? CAPTURE_RUNNING : CAPTURE_ARMED;
+
+  os_timer_disarm(&stream_timer);
+  TYPED_TIMER_SETFN(&stream_timer, stream_timer_function, NULL);
+  os_timer_arm(&stream_timer, LOGIC_CAPTURE_BATCH_MS, 1);
+
+  hw_timer_start(ticks, true);
+  return true;
+}
+
+// Throw away whatever we have and stop
+void ICACHE_FLASH_ATTR logic_capture_abort(void) {
+  os_timer_disarm(&stream_timer);
+  if (capture.state == CAPTURE_ARMED || capture.state == CAPTURE_RUNNING ||
+      capture.state == CAPTURE_DONE)
+    hw_timer_release();
+  capture.state = CAPTURE_IDLE;
+}
+
+// Print what we know about the last capture. The maximum sustainable rate is
+// worked out from the longest interrupt we have seen ... the real limit is a bit
+// lower because of the interrupt entry/exit and whatever WiFi is doing, which is
+// what the dropped counter tells you.
+void ICACHE_FLASH_ATTR logic_capture_report(void) {
+  uint32 cpu_hz = system_get_cpu_freq() * 1000000;
+
+  os_printf("logic capture: rate %u Hz, %u samples, %u dropped, isr max %u cycles",
+            capture.rate_hz, SAMPLE_COUNT, capture.dropped, capture.isr_cycles_max);
+  if (capture.isr_cycles_max != 0)
+    os_printf(", max rate %u Hz", cpu_hz / capture.isr_cycles_max);
+  os_printf("\n");
+}
@@ -0,0 +1,29 @@
+// Logic analyzer capture mode. Samples a group of GPIO inputs at a fixed rate
+// from the FRC1 hardware timer interrupt into a packed bit buffer in RAM, then
+// streams the buffer out over UDP or UART in batches once the buffer is full.
+//
+// Stream format (all multi byte fields little endian):
+//   header:  'L' 'A' version channels first_gpio trigger
+//            sample_rate(4) sample_count(4) dropped(4) isr_cycles_max(4)
+//   data:    'L' 'D' offset(2) length(2) followed by length bytes of samples
+// Samples are packed LSB first: with 2 channels there are 4 samples per byte,
+// the first sample in bits 0-1.
+
+#ifndef LOGIC_CAPTURE_H
+#define LOGIC_CAPTURE_H
+
+#include "c_types.h"
+
+#define LOGIC_CAPTURE_TRIGGER_NONE     0
+#define LOGIC_CAPTURE_TRIGGER_RISING   1
+#define LOGIC_CAPTURE_TRIGGER_FALLING  2
+
+#define LOGIC_CAPTURE_OUT_UDP   0
+#define LOGIC_CAPTURE_OUT_UART  1
+
+void logic_capture_init(void);
+bool logic_capture_start(uint32 sample_rate_hz, uint8 trigger);
+void logic_capture_abort(void);
+void logic_capture_report(void);
+
+#endif
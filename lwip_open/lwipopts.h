@@ -0,0 +1,82 @@
+// Our lwIP settings for "make LWIP=open" (see the Makefile). This goes in front of
+// the lwipopts.h of esp-open-lwip: we pull that one in first and then change what
+// we want different. Everything not in here stays the way esp-open-lwip has it.
+//
+// This firmware is a softAP with a handful of clients talking small UDP (DHCP,
+// captive DNS, the logic capture stream). TCP is only used to measure throughput,
+// so the TCP side gets cut down to what one connection needs.
+//
+// esp-open-lwip sets MEMP_MEM_MALLOC, which makes every memp pool a plain
+// mem_malloc from the heap: the MEMP_NUM_* and PBUF_POOL_SIZE values below would
+// then size nothing at all. We turn it off, so the pools are static arrays
+// (memp_memory in .bss) of exactly these sizes. They are reserved at boot instead
+// of taken from the heap when needed, they can't fail later because the heap is
+// fragmented, and "make lwip-footprint LWIP=open" shows them in the ram column.
+// mem_malloc (PBUF_RAM pbufs and the like) still comes from the heap
+// (MEM_LIBC_MALLOC).
+
+#ifndef LWIPOPTS_TUNED_H
+#define LWIPOPTS_TUNED_H
+
+#include_next "lwipopts.h"
+
+// Real pools, see above
+#undef MEMP_MEM_MALLOC
+#define MEMP_MEM_MALLOC           0
+
+// UDP, one pcb each with every feature on:
+//   lwIP's DNS client (dns_init takes one at boot)   1
+//   DHCP server                                      1
+//   captive DNS (FEATURE_CAPTIVE_DNS)                1
+//   logic capture stream, espconn                    1
+//   net bench sink (FEATURE_NET_BENCH)               1
+//   ctrl udp, raw lwIP (FEATURE_CTRL_UDP)            1
+//   ctrl udp, espconn (CTRL_UDP_ESPCONN_BENCH)       1
+// That's 7, plus one spare. udp_new returns NULL when the pool is out and each
+// of them then says so on the serial port, so add one here with every new user.
+#undef MEMP_NUM_UDP_PCB
+#define MEMP_NUM_UDP_PCB          8
+
+// PBUF_REF / PBUF_ROM headers (sending from our own buffers)
+#undef MEMP_NUM_PBUF
+#define MEMP_NUM_PBUF             8
+
+// Received frames come from the WiFi driver, not from the pool, so keep it small
+#undef PBUF_POOL_SIZE
+#define PBUF_POOL_SIZE            4
+
+// TCP: one connection at a time, one listener
+#undef MEMP_NUM_TCP_PCB
+#define MEMP_NUM_TCP_PCB          2
+#undef MEMP_NUM_TCP_PCB_LISTEN
+#define MEMP_NUM_TCP_PCB_LISTEN   1
+
+// A smaller window than the SDK's. Costs throughput on a single TCP stream, which
+// is the point of measuring it (net_bench.h). Bump it back up if that matters.
+#undef TCP_WND
+#define TCP_WND                   (2 * TCP_MSS)
+#undef TCP_SND_BUF
+#define TCP_SND_BUF               (2 * TCP_MSS)
+#undef TCP_SND_QUEUELEN
+#define TCP_SND_QUEUELEN          ((4 * (TCP_SND_BUF) + (TCP_MSS - 1)) / (TCP_MSS))
+#undef MEMP_NUM_TCP_SEG
+#define MEMP_NUM_TCP_SEG          TCP_SND_QUEUELEN
+
+// Checksums. The ESP8266 has no checksum offload, lwIP does them in software.
+// Algorithm 3 sums 32 bits at a time, the fastest one on the lx106.
+#undef LWIP_CHKSUM_ALGORITHM
+#define LWIP_CHKSUM_ALGORITHM     3
+
+// Checking received checksums can be turned off with -DLWIP_RX_CHECKSUMS=0 (the
+// WiFi frames have their own CRC). Sending them can't: the clients check.
+#ifndef LWIP_RX_CHECKSUMS
+#define LWIP_RX_CHECKSUMS         1
+#endif
+#undef CHECKSUM_CHECK_IP
+#define CHECKSUM_CHECK_IP         LWIP_RX_CHECKSUMS
+#undef CHECKSUM_CHECK_UDP
+#define CHECKSUM_CHECK_UDP        LWIP_RX_CHECKSUMS
+#undef CHECKSUM_CHECK_TCP
+#define CHECKSUM_CHECK_TCP        LWIP_RX_CHECKSUMS
+
+#endif
@@ -0,0 +1,255 @@
+// MAC filter ... see mac_filter.h.
+//
+// A MAC is kept as two words everywhere: hi is the first two bytes, lo the last
+// four. Comparing (hi, lo) is the same as comparing the MACs byte by byte, which
+// is what the list is sorted by.
+//
+// Cache entries use the top bits of hi (a MAC only needs the low 16) to say the
+// slot is in use and what the answer was.
+
+#include "ets_sys.h"
+#include "osapi.h"
+#include "user_interface.h"
+#include "user_config.h"
+#include "mac_filter.h"
+#include "mac_filter_list.h"
+#include "ccount.h"
+
+// A count of entries, as a uint32 like every other count we print
+#define LIST_ENTRIES(list)  ((uint32)(sizeof(list) / sizeof(list[0]) / 2))
+
+#define CACHE_USED     BIT31
+#define CACHE_ALLOWED  BIT30
+#define CACHE_HI_MASK  0xffff
+
+struct cache_entry {
+  uint32 hi;
+  uint32 lo;
+};
+
+LOCAL struct cache_entry cache[2][MAC_FILTER_CACHE_SLOTS];
+LOCAL bool list_ok;
+
+LOCAL struct {
+  uint32 lookups;
+  uint32 cache_hits;
+  uint32 refused;
+  uint32 cache_drops;     // inserts that ran out of kicks and pushed somebody out
+} filter_stats;
+
+// The two slots a MAC may be in (one per table)
+LOCAL uint32 ICACHE_FLASH_ATTR cache_slot(uint8 table, uint32 hi, uint32 lo) {
+  uint32 h = lo ^ (hi * 0x85ebca6b);
+
+  h *= table == 0 ? 0x9e3779b1 : 0xc2b2ae35;
+  return (h >> 16) & (MAC_FILTER_CACHE_SLOTS - 1);
+}
+
+// Look in both slots. Returns the cache entry or NULL.
+LOCAL struct cache_entry * ICACHE_FLASH_ATTR cache_find(uint32 hi, uint32 lo) {
+  struct cache_entry *e;
+  uint8 t;
+
+  for (t = 0; t < 2; t++) {
+    e = &cache[t][cache_slot(t, hi, lo)];
+    if ((e->hi & CACHE_USED) && (e->hi & CACHE_HI_MASK) == hi && e->lo == lo)
+      return e;
+  }
+  return NULL;
+}
+
+// Cuckoo insert: take our slot in table 0, whoever was there moves to their slot
+// in table 1, whoever was there moves back to table 0 ... until somebody lands in
+// an empty slot or we run out of kicks (then the last one is dropped, it's only a
+// cache).
+LOCAL void ICACHE_FLASH_ATTR cache_insert(uint32 hi, uint32 lo, bool allowed) {
+  struct cache_entry moving, *slot, swap;
+  uint8 table = 0;
+  uint8 kicks;
+
+  moving.hi = hi | CACHE_USED | (allowed ? CACHE_ALLOWED : 0);
+  moving.lo = lo;
+
+  for (kicks = 0; kicks < MAC_FILTER_MAX_KICKS; kicks++) {
+    slot = &cache[table][cache_slot(table, moving.hi & CACHE_HI_MASK, moving.lo)];
+    swap = *slot;
+    *slot = moving;
+    if (!(swap.hi & CACHE_USED))
+      return;
+    moving = swap;
+    table ^= 1;
+  }
+  filter_stats.cache_drops++;
+}
+
+// Binary search of a sorted list of (hi, lo) pairs in flash
+LOCAL bool ICACHE_FLASH_ATTR list_contains(const uint32 *list, uint32 entries, uint32 hi, uint32 lo) {
+  uint32 low = 0, high = entries;
+
+  while (low < high) {
+    uint32 mid = (low + high) / 2;
+    uint32 mid_hi = list[mid * 2];
+    uint32 mid_lo = list[mid * 2 + 1];
+
+    if (mid_hi == hi && mid_lo == lo)
+      return true;
+    if (mid_hi < hi || (mid_hi == hi && mid_lo < lo))
+      low = mid + 1;
+    else
+      high = mid;
+  }
+  return false;
+}
+
+// Check the list is sorted (and has no doubles). If it isn't, the binary search
+// can't be trusted, so the filter stays off.
+bool ICACHE_FLASH_ATTR mac_filter_init(void) {
+  uint32 entries = LIST_ENTRIES(mac_filter_list);
+  uint32 i;
+
+  os_bzero(cache, sizeof(cache));
+  list_ok = true;
+  for (i = 1; i < entries; i++) {
+    uint32 prev_hi = mac_filter_list[i * 2 - 2], prev_lo = mac_filter_list[i * 2 - 1];
+    uint32 hi = mac_filter_list[i * 2], lo = mac_filter_list[i * 2 + 1];
+
+    if (prev_hi > hi || (prev_hi == hi && prev_lo >= lo)) {
+      os_printf("mac filter: list isn't sorted at entry %u, the filter is OFF\n", i);
+      list_ok = false;
+      break;
+    }
+  }
+  return list_ok;
+}
+
+// What the list says about a MAC (with the deny list turned around)
+LOCAL bool ICACHE_FLASH_ATTR list_allows(uint32 hi, uint32 lo) {
+  bool listed = list_contains(mac_filter_list, LIST_ENTRIES(mac_filter_list), hi, lo);
+
+  return MAC_FILTER_MODE == MAC_FILTER_DENY ? !listed : listed;
+}
+
+// May this station be one of our clients?
+bool ICACHE_FLASH_ATTR mac_filter_allowed(const uint8 *mac) {
+  uint32 hi = ((uint32)mac[0] << 8) | mac[1];
+  uint32 lo = ((uint32)mac[2] << 24) | ((uint32)mac[3] << 16) | ((uint32)mac[4] << 8) | mac[5];
+  struct cache_entry *e;
+  bool allowed;
+
+  if (!list_ok)
+    return true;
+
+  filter_stats.lookups++;
+  e = cache_find(hi, lo);
+  if (e != NULL) {
+    filter_stats.cache_hits++;
+    allowed = (e->hi & CACHE_ALLOWED) != 0;
+  } else {
+    allowed = list_allows(hi, lo);
+    cache_insert(hi, lo, allowed);
+  }
+
+  if (!allowed)
+    filter_stats.refused++;
+  return allowed;
+}
+
+// The same answer for somebody who only wants to know (the ctrl udp "mac"
+// query): nothing is counted and nothing goes into the cache, so the stats and
+// the cache stay about the stations that really connected.
+bool ICACHE_FLASH_ATTR mac_filter_lookup(const uint8 *mac) {
+  uint32 hi = ((uint32)mac[0] << 8) | mac[1];
+  uint32 lo = ((uint32)mac[2] << 24) | ((uint32)mac[3] << 16) | ((uint32)mac[4] << 8) | mac[5];
+  struct cache_entry *e;
+
+  if (!list_ok)
+    return true;
+
+  e = cache_find(hi, lo);
+  if (e != NULL)
+    return (e->hi & CACHE_ALLOWED) != 0;
+  return list_allows(hi, lo);
+}
+
+void ICACHE_FLASH_ATTR mac_filter_report(void) {
+  os_printf("mac filter: %s, %u MACs, %u lookups, %u from the cache, %u refused, %u cache drops\n",
+            !list_ok ? "OFF" : MAC_FILTER_MODE == MAC_FILTER_DENY ? "deny list" : "allow list",
+            LIST_ENTRIES(mac_filter_list), filter_stats.lookups, filter_stats.cache_hits,
+            filter_stats.refused, filter_stats.cache_drops);
+}
+
+#if MAC_FILTER_BENCH_LOOKUPS > 0
+
+// A made up list of 10000 MACs for the benchmark (80KB of flash, only in the image
+// when the benchmark is on). Every MAC is 02:00 (locally administered) and then
+// i * 7919, so it's sorted and a MAC in between two entries is a miss.
+#define BENCH_STRIDE      7919
+#define BENCH_E(i)        0x0200, (uint32)(i) * BENCH_STRIDE,
+#define BENCH_10(i)       BENCH_E((i) * 10) BENCH_E((i) * 10 + 1) BENCH_E((i) * 10 + 2) BENCH_E((i) * 10 + 3) \
+                          BENCH_E((i) * 10 + 4) BENCH_E((i) * 10 + 5) BENCH_E((i) * 10 + 6) BENCH_E((i) * 10 + 7) \
+                          BENCH_E((i) * 10 + 8) BENCH_E((i) * 10 + 9)
+#define BENCH_100(i)      BENCH_10((i) * 10) BENCH_10((i) * 10 + 1) BENCH_10((i) * 10 + 2) BENCH_10((i) * 10 + 3) \
+                          BENCH_10((i) * 10 + 4) BENCH_10((i) * 10 + 5) BENCH_10((i) * 10 + 6) BENCH_10((i) * 10 + 7) \
+                          BENCH_10((i) * 10 + 8) BENCH_10((i) * 10 + 9)
+#define BENCH_1000(i)     BENCH_100((i) * 10) BENCH_100((i) * 10 + 1) BENCH_100((i) * 10 + 2) BENCH_100((i) * 10 + 3) \
+                          BENCH_100((i) * 10 + 4) BENCH_100((i) * 10 + 5) BENCH_100((i) * 10 + 6) BENCH_100((i) * 10 + 7) \
+                          BENCH_100((i) * 10 + 8) BENCH_100((i) * 10 + 9)
+
+LOCAL const uint32 bench_list[] ICACHE_RODATA_ATTR STORE_ATTR = {
+  BENCH_1000(0) BENCH_1000(1) BENCH_1000(2) BENCH_1000(3) BENCH_1000(4)
+  BENCH_1000(5) BENCH_1000(6) BENCH_1000(7) BENCH_1000(8) BENCH_1000(9)
+};
+
+#define BENCH_ENTRIES  LIST_ENTRIES(bench_list)
+
+// Time lookups against the 10000 MAC list: binary search hits and misses, and the
+// cache. Interrupts are off for each timed lookup so the WiFi stays out of the
+// numbers. Call it before any client shows up, it empties the cache afterwards.
+void ICACHE_FLASH_ATTR mac_filter_bench(uint32 lookups) {
+  uint32 cycles_hit = 0, cycles_miss = 0, cycles_cache = 0;
+  uint32 mhz = system_get_cpu_freq();
+  uint32 seed = 12345;
+  uint32 i, lo, start;
+
+  if (lookups == 0)
+    return;
+
+  for (i = 0; i < lookups; i++) {
+    seed = seed * 1103515245 + 12345;
+    lo = ((seed >> 8) % BENCH_ENTRIES) * BENCH_STRIDE;
+
+    ets_intr_lock();
+    start = get_ccount();
+    list_contains(bench_list, BENCH_ENTRIES, 0x0200, lo);
+    cycles_hit += get_ccount() - start;
+
+    start = get_ccount();
+    list_contains(bench_list, BENCH_ENTRIES, 0x0200, lo + 1);
+    cycles_miss += get_ccount() - start;
+    ets_intr_unlock();
+
+    // The cache: put it in, then time finding it again
+    cache_insert(0x0200, lo, true);
+    ets_intr_lock();
+    start = get_ccount();
+    cache_find(0x0200, lo);
+    cycles_cache += get_ccount() - start;
+    ets_intr_unlock();
+  }
+
+  os_bzero(cache, sizeof(cache));
+  cycles_hit /= lookups;
+  cycles_miss /= lookups;
+  cycles_cache /= lookups;
+  os_printf("mac filter bench: %u MACs, %u lookups: search hit %u cycles, miss %u cycles, "
+            "cache %u cycles (%u / %u / %u ns)\n", BENCH_ENTRIES, lookups,
+            cycles_hit, cycles_miss, cycles_cache,
+            cycles_hit * 1000 / mhz, cycles_miss * 1000 / mhz, cycles_cache * 1000 / mhz);
+}
+
+#else
+
+void ICACHE_FLASH_ATTR mac_filter_bench(uint32 lookups) {
+}
+
+#endif
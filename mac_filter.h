@@ -0,0 +1,42 @@
+// MAC filter for the softAP: which clients count as ours. The list lives in
+// mac_filter_list.h, sorted, in flash, so it can be as long as you like. With
+// MAC_FILTER_MODE set to MAC_FILTER_ALLOW only the MACs on the list get in; with
+// MAC_FILTER_DENY everybody except them does.
+//
+// Looking a MAC up in the list is a binary search (log2 of the list length reads
+// from flash). The answer then goes into a small cuckoo hash in RAM: two tables,
+// a MAC can only be in one of two slots, so the next time it's two compares no
+// matter how long the list is. Stations come back a lot (phones drop out and join
+// again) so most lookups end up there.
+//
+// wifi_event_handler_callback asks mac_filter_allowed for every station that
+// connects. One that isn't allowed gets kicked (MAC_FILTER_DEAUTH) or just
+// doesn't count as a client (MAC_FILTER_IGNORE). mac_filter_lookup gives the
+// same answer without counting it or caching it, for queries.
+
+#ifndef MAC_FILTER_H
+#define MAC_FILTER_H
+
+#include "c_types.h"
+
+#define MAC_FILTER_ALLOW    0
+#define MAC_FILTER_DENY     1
+
+#define MAC_FILTER_DEAUTH   0
+#define MAC_FILTER_IGNORE   1
+
+#define MAC_FILTER_CACHE_SLOTS  16    // per table, power of two
+#define MAC_FILTER_MAX_KICKS    8     // cuckoo moves before an insert gives up and overwrites
+
+// A list entry is two 32 bit words (flash can only be read 32 bits at a time):
+// the first two bytes of the MAC, then the last four.
+#define MAC_FILTER_ENTRY(a, b, c, d, e, f) \
+  (((uint32)(a) << 8) | (b)), (((uint32)(c) << 24) | ((uint32)(d) << 16) | ((uint32)(e) << 8) | (f))
+
+bool mac_filter_init(void);
+bool mac_filter_allowed(const uint8 *mac);
+bool mac_filter_lookup(const uint8 *mac);
+void mac_filter_report(void);
+void mac_filter_bench(uint32 lookups);
+
+#endif
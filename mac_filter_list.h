@@ -0,0 +1,20 @@
+// The MAC filter list (see mac_filter.h). Allowed or denied depends on
+// MAC_FILTER_MODE in user_config.h.
+//
+// Keep it SORTED, lowest MAC first: it's searched with a binary search.
+// mac_filter_init checks and turns the filter off (and says so) if it isn't.
+//
+// Only included by mac_filter.c.
+
+#ifndef MAC_FILTER_LIST_H
+#define MAC_FILTER_LIST_H
+
+#include "c_types.h"
+#include "mac_filter.h"
+
+LOCAL const uint32 mac_filter_list[] ICACHE_RODATA_ATTR STORE_ATTR = {
+  MAC_FILTER_ENTRY(0x3c, 0x28, 0x6d, 0x11, 0x22, 0x33),
+  MAC_FILTER_ENTRY(0xa4, 0x5e, 0x60, 0x44, 0x55, 0x66),
+};
+
+#endif
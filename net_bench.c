@@ -0,0 +1,110 @@
+// Network throughput benchmark ... see net_bench.h.
+//
+// Both sinks use the raw lwIP API, so what we measure is lwIP and the driver and
+// not espconn. The TCP one takes one connection at a time and acknowledges
+// everything right away (tcp_recved) so the window stays open.
+
+#include "ets_sys.h"
+#include "osapi.h"
+#include "user_interface.h"
+#include "lwip/pbuf.h"
+#include "lwip/udp.h"
+#include "lwip/tcp.h"
+#include "net_bench.h"
+#include "typed_timer.h"
+
+LOCAL struct udp_pcb *udp_sink;
+LOCAL struct tcp_pcb *tcp_listener;
+LOCAL os_timer_t rate_timer;
+
+LOCAL struct {
+  uint32 udp_bytes;       // this second
+  uint32 tcp_bytes;
+  uint32 udp_peak;        // best second so far, bytes
+  uint32 tcp_peak;
+  uint32 udp_total;
+  uint32 tcp_total;
+  uint32 connections;
+} bench;
+
+LOCAL void ICACHE_FLASH_ATTR udp_sink_recv(void *arg, struct udp_pcb *pcb, struct pbuf *p,
+                                           ip_addr_t *addr, u16_t port) {
+  bench.udp_bytes += p->tot_len;
+  pbuf_free(p);
+}
+
+LOCAL err_t ICACHE_FLASH_ATTR tcp_sink_recv(void *arg, struct tcp_pcb *pcb, struct pbuf *p, err_t err) {
+  // NULL means the other side closed
+  if (p == NULL) {
+    tcp_close(pcb);
+    return ERR_OK;
+  }
+  bench.tcp_bytes += p->tot_len;
+  tcp_recved(pcb, p->tot_len);
+  pbuf_free(p);
+  return ERR_OK;
+}
+
+LOCAL err_t ICACHE_FLASH_ATTR tcp_sink_accept(void *arg, struct tcp_pcb *pcb, err_t err) {
+  tcp_accepted(tcp_listener);
+  tcp_recv(pcb, tcp_sink_recv);
+  bench.connections++;
+  return ERR_OK;
+}
+
+// Once a second: the rate of the second that just ended (only if there was some)
+LOCAL void ICACHE_FLASH_ATTR rate_timer_function(void *arg) {
+  if (bench.udp_bytes == 0 && bench.tcp_bytes == 0)
+    return;
+
+  os_printf("net bench: udp %u KB/s, tcp %u KB/s, heap %u\n", bench.udp_bytes / 1024,
+            bench.tcp_bytes / 1024, system_get_free_heap_size());
+  if (bench.udp_bytes > bench.udp_peak)
+    bench.udp_peak = bench.udp_bytes;
+  if (bench.tcp_bytes > bench.tcp_peak)
+    bench.tcp_peak = bench.tcp_bytes;
+  bench.udp_total += bench.udp_bytes;
+  bench.tcp_total += bench.tcp_bytes;
+  bench.udp_bytes = 0;
+  bench.tcp_bytes = 0;
+}
+
+// Open both sinks (false if lwIP is out of pcbs or the port is taken)
+bool ICACHE_FLASH_ATTR net_bench_start(void) {
+  struct tcp_pcb *pcb;
+
+  if (udp_sink != NULL)
+    return true;
+
+  udp_sink = udp_new();
+  if (udp_sink == NULL || udp_bind(udp_sink, IP_ADDR_ANY, NET_BENCH_PORT) != ERR_OK) {
+    os_printf("net bench: can't open the UDP sink\n");
+    if (udp_sink != NULL)
+      udp_remove(udp_sink);
+    udp_sink = NULL;
+    return false;
+  }
+  udp_recv(udp_sink, udp_sink_recv, NULL);
+
+  // tcp_listen frees pcb and hands back a smaller listening one
+  pcb = tcp_new();
+  if (pcb == NULL || tcp_bind(pcb, IP_ADDR_ANY, NET_BENCH_PORT) != ERR_OK ||
+      (tcp_listener = tcp_listen(pcb)) == NULL) {
+    os_printf("net bench: can't open the TCP sink\n");
+    if (pcb != NULL)
+      tcp_close(pcb);
+  } else {
+    tcp_accept(tcp_listener, tcp_sink_accept);
+  }
+
+  TYPED_TIMER_SETFN(&rate_timer, rate_timer_function, NULL);
+  os_timer_arm(&rate_timer, 1000, 1);
+  os_printf("net bench: listening on port %u\n", NET_BENCH_PORT);
+  return true;
+}
+
+void ICACHE_FLASH_ATTR net_bench_report(void) {
+  os_printf("net bench: udp %u KB (best %u KB/s), tcp %u KB in %u connections (best %u KB/s)\n",
+            bench.udp_total / 1024, bench.udp_peak / 1024, bench.tcp_total / 1024,
+            bench.connections, bench.tcp_peak / 1024);
+}
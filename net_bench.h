@@ -0,0 +1,19 @@
+// Network throughput benchmark: a UDP and a TCP sink on NET_BENCH_PORT that count
+// what arrives. Point iperf (version 2) at the softAP from a laptop:
+//   iperf -c 192.168.4.1 -p 5001 -t 10               TCP
+//   iperf -u -c 192.168.4.1 -p 5001 -b 10M -t 10     UDP
+// and every second with traffic it prints how many KB/s came in. Build once with
+// the SDK lwIP and once with "make LWIP=open" to compare the two (see the
+// Makefile).
+
+#ifndef NET_BENCH_H
+#define NET_BENCH_H
+
+#include "c_types.h"
+
+#define NET_BENCH_PORT  5001
+
+bool net_bench_start(void);
+void net_bench_report(void);
+
+#endif
@@ -0,0 +1,139 @@
+// Power-on self test ... see post.h.
+
+#include "ets_sys.h"
+#include "osapi.h"
+#include "gpio.h"
+#include "spi_flash.h"
+#include "user_interface.h"
+#include "post.h"
+#include "typed_timer.h"
+#include "ccount.h"
+
+#define SECTOR_SIZE    4096
+#define CCOUNT_SLACK   1        // MHz the cycle counter may be off by
+
+// In user_main.c (the SDK calls it, so does the POST)
+uint32 user_rf_cal_sector_set(void);
+
+LOCAL os_timer_t post_timer;
+LOCAL struct post_result result;
+LOCAL uint32 start_us;
+LOCAL uint32 timer_start_us;
+LOCAL uint32 timer_start_ccount;
+
+// Drive GPIO2 to level and see if the pad follows
+LOCAL bool ICACHE_FLASH_ATTR gpio2_reads_back(uint8 level) {
+  if (level)
+    gpio_output_set(BIT2, 0, BIT2, 0);
+  else
+    gpio_output_set(0, BIT2, BIT2, 0);
+  os_delay_us(10);
+  return ((GPIO_REG_READ(GPIO_IN_ADDRESS) & BIT2) != 0) == (level != 0);
+}
+
+LOCAL bool ICACHE_FLASH_ATTR check_gpio2(void) {
+  bool ok = gpio2_reads_back(1) && gpio2_reads_back(0);
+
+  // Leave it LOW like user_init does, whatever happened
+  gpio_output_set(0, BIT2, BIT2, 0);
+  return ok;
+}
+
+// The chip size comes from the JEDEC id (the third byte is log2 of the size in
+// bytes), not from the image header, so a header that lies gets caught too.
+LOCAL bool ICACHE_FLASH_ATTR check_rf_cal(void) {
+  uint32 id = spi_flash_get_id();
+  uint8 size_log2 = (id >> 16) & 0xff;
+  uint32 sectors;
+  uint32 data[4];
+
+  result.rf_cal_sector = user_rf_cal_sector_set();
+  if (size_log2 < 19 || size_log2 > 24) {
+    os_printf("post: flash id 0x%06x makes no sense\n", id);
+    return false;
+  }
+  sectors = (1 << size_log2) / SECTOR_SIZE;
+
+  if (result.rf_cal_sector == 0 || result.rf_cal_sector >= sectors) {
+    os_printf("post: RF cal sector %u is outside the %u sectors of the flash\n",
+              result.rf_cal_sector, sectors);
+    return false;
+  }
+  if (spi_flash_read(result.rf_cal_sector * SECTOR_SIZE, data, sizeof(data)) != SPI_FLASH_RESULT_OK) {
+    os_printf("post: can't read RF cal sector %u\n", result.rf_cal_sector);
+    return false;
+  }
+  return true;
+}
+
+// Write the result to RTC memory and print it
+LOCAL void ICACHE_FLASH_ATTR post_done(void) {
+  struct post_result last;
+
+  result.total_us = system_get_time() - start_us;
+  if (result.total_us > POST_BUDGET_MS * 1000)
+    result.failures |= POST_FAIL_BUDGET;
+
+  // Keep counting from what the last POST left (if it was one of ours)
+  result.runs = 1;
+  result.failed_runs = 0;
+  if (post_last_result(&last)) {
+    result.runs = last.runs + 1;
+    result.failed_runs = last.failed_runs;
+  }
+  if (result.failures)
+    result.failed_runs++;
+  result.magic = POST_RTC_MAGIC;
+  system_rtc_mem_write(POST_RTC_BLOCK, &result, sizeof(result));
+
+  os_printf("post: %s (0x%02x): gpio2 %s, rf cal sector %u %s, ccount %uMHz %s, "
+            "%ums timer took %uus %s, %uus total\n",
+            result.failures ? "FAILED" : "passed", result.failures,
+            (result.failures & POST_FAIL_GPIO2) ? "bad" : "ok",
+            result.rf_cal_sector, (result.failures & POST_FAIL_RF_CAL) ? "bad" : "ok",
+            result.ccount_mhz, (result.failures & POST_FAIL_CCOUNT) ? "bad" : "ok",
+            POST_TIMER_MS, result.timer_us, (result.failures & POST_FAIL_TIMER) ? "bad" : "ok",
+            result.total_us);
+  os_printf("post: %u runs since power up, %u failed\n", result.runs, result.failed_runs);
+}
+
+// The timer went off: how long did it really take, by both clocks?
+LOCAL void ICACHE_FLASH_ATTR post_timer_function(void *arg) {
+  uint32 cycles = get_ccount() - timer_start_ccount;
+  uint32 cpu_mhz = system_get_cpu_freq();
+
+  result.timer_us = system_get_time() - timer_start_us;
+  result.ccount_mhz = (cycles + result.timer_us / 2) / result.timer_us;
+
+  if (result.ccount_mhz + CCOUNT_SLACK < cpu_mhz || result.ccount_mhz > cpu_mhz + CCOUNT_SLACK)
+    result.failures |= POST_FAIL_CCOUNT;
+  if (result.timer_us + POST_TIMER_SLACK_MS * 1000 < POST_TIMER_MS * 1000 ||
+      result.timer_us > (POST_TIMER_MS + POST_TIMER_SLACK_MS) * 1000)
+    result.failures |= POST_FAIL_TIMER;
+
+  post_done();
+}
+
+// Run the quick checks now and start the timer one (call from user_init)
+void ICACHE_FLASH_ATTR post_start(void) {
+  start_us = system_get_time();
+  os_bzero(&result, sizeof(result));
+
+  if (!check_gpio2())
+    result.failures |= POST_FAIL_GPIO2;
+  if (!check_rf_cal())
+    result.failures |= POST_FAIL_RF_CAL;
+
+  TYPED_TIMER_SETFN(&post_timer, post_timer_function, NULL);
+  timer_start_us = system_get_time();
+  timer_start_ccount = get_ccount();
+  os_timer_arm(&post_timer, POST_TIMER_MS, 0);
+}
+
+// What the last POST wrote to RTC memory (false if there's nothing there, like
+// after a power cycle)
+bool ICACHE_FLASH_ATTR post_last_result(struct post_result *last) {
+  if (!system_rtc_mem_read(POST_RTC_BLOCK, last, sizeof(*last)))
+    return false;
+  return last->magic == POST_RTC_MAGIC;
+}
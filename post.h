@@ -0,0 +1,53 @@
+// Power-on self test, so a freshly assembled board can tell us the LED and the
+// timing work without somebody watching it blink. post_start runs from user_init
+// and checks:
+//   GPIO2    drive it high and low and read the pad back (GPIO_IN) each time
+//   RF cal   the sector user_rf_cal_sector_set hands the SDK is inside the flash
+//            chip (going by its JEDEC id) and can be read
+//   CCOUNT   the cycle counter runs at system_get_cpu_freq compared to
+//            system_get_time
+//   timer    an os_timer of POST_TIMER_MS fires after POST_TIMER_MS, give or take
+//            POST_TIMER_SLACK_MS
+// The timer check needs the SDK to be running timers, so it finishes in that
+// timer's callback a little later. The whole thing has to be done in
+// POST_BUDGET_MS or that's a failure too.
+//
+// The result is printed and written to RTC memory at POST_RTC_BLOCK, which
+// survives a reset (not a power cycle), so a board that keeps resetting can still
+// tell us what the last POST said.
+
+#ifndef POST_H
+#define POST_H
+
+#include "c_types.h"
+
+#define POST_TIMER_MS        20
+#define POST_TIMER_SLACK_MS  5
+#define POST_BUDGET_MS       50
+#define POST_RTC_BLOCK       64     // first block of the user part of RTC memory
+
+// Failure bits
+#define POST_FAIL_GPIO2      BIT0
+#define POST_FAIL_RF_CAL     BIT1
+#define POST_FAIL_CCOUNT     BIT2
+#define POST_FAIL_TIMER      BIT3
+#define POST_FAIL_BUDGET     BIT4
+
+// What goes into RTC memory (whole 4 byte blocks)
+struct post_result {
+  uint32 magic;          // POST_RTC_MAGIC once a result has been written
+  uint32 runs;           // POSTs since the last power cycle
+  uint32 failed_runs;    // ... and how many of them failed
+  uint32 failures;       // POST_FAIL_ bits of the last one
+  uint32 rf_cal_sector;
+  uint32 ccount_mhz;     // measured
+  uint32 timer_us;       // how long the POST_TIMER_MS timer really took
+  uint32 total_us;       // the whole POST
+};
+
+#define POST_RTC_MAGIC       0x504f5354   // "POST"
+
+void post_start(void);
+bool post_last_result(struct post_result *result);
+
+#endif
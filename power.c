@@ -0,0 +1,80 @@
+// Power saving ... see power.h.
+
+#include "ets_sys.h"
+#include "osapi.h"
+#include "user_interface.h"
+#include "user_config.h"
+#include "power.h"
+#include "app_fsm.h"
+#include "typed_timer.h"
+
+LOCAL os_timer_t idle_timer;
+LOCAL bool asleep;
+
+LOCAL struct {
+  uint32 sleeps;
+  uint32 probe_wakes;       // woken by a probe request (a client joining isn't counted here)
+  uint32 slept_since_us;    // system_get_time() when we last went to sleep
+  uint32 slept_ms;          // all the sleeps before the current one
+} power_stats;
+
+LOCAL void ICACHE_FLASH_ATTR set_full_power(void) {
+  if (!asleep)
+    return;
+  asleep = false;
+  power_stats.slept_ms += (system_get_time() - power_stats.slept_since_us) / 1000;
+  system_phy_set_max_tpw(POWER_FULL_TPW);
+}
+
+// Nobody came for POWER_IDLE_SLEEP_S. The state machine decides (it stays put
+// unless it's idle).
+LOCAL void ICACHE_FLASH_ATTR idle_timer_function(void *arg) {
+  app_fsm_dispatch(APP_EV_SLEEP);
+}
+
+void ICACHE_FLASH_ATTR power_init(void) {
+  os_timer_disarm(&idle_timer);
+  TYPED_TIMER_SETFN(&idle_timer, idle_timer_function, NULL);
+  asleep = false;
+  os_bzero(&power_stats, sizeof(power_stats));
+}
+
+void ICACHE_FLASH_ATTR power_idle(void) {
+  set_full_power();
+  os_timer_disarm(&idle_timer);
+  if (POWER_IDLE_SLEEP_S > 0)
+    os_timer_arm(&idle_timer, POWER_IDLE_SLEEP_S * 1000, 0);
+}
+
+void ICACHE_FLASH_ATTR power_awake(void) {
+  set_full_power();
+  os_timer_disarm(&idle_timer);
+}
+
+void ICACHE_FLASH_ATTR power_sleep(void) {
+  os_timer_disarm(&idle_timer);
+  if (asleep)
+    return;
+  asleep = true;
+  power_stats.sleeps++;
+  power_stats.slept_since_us = system_get_time();
+  system_phy_set_max_tpw(POWER_SLEEP_TPW);
+}
+
+// Event bus subscriber (probe requests only). Cheap when we're awake, there can
+// be a lot of these.
+void ICACHE_FLASH_ATTR power_on_event(System_Event_t *event) {
+  if (event->event != EVENT_SOFTAPMODE_PROBEREQRECVED || app_fsm_state() != APP_SLEEPING)
+    return;
+  power_stats.probe_wakes++;
+  app_fsm_dispatch(APP_EV_WAKE);
+}
+
+void ICACHE_FLASH_ATTR power_report(void) {
+  uint32 slept_ms = power_stats.slept_ms;
+
+  if (asleep)
+    slept_ms += (system_get_time() - power_stats.slept_since_us) / 1000;
+  os_printf("power: %s, %u sleeps, %u woken by probe requests, %u s asleep\n",
+            asleep ? "asleep" : "awake", power_stats.sleeps, power_stats.probe_wakes, slept_ms / 1000);
+}
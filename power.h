@@ -0,0 +1,30 @@
+// Power saving while nobody is around. With no client for POWER_IDLE_SLEEP_S
+// seconds the state machine gets APP_EV_SLEEP: the status LED goes off and the
+// TX power goes down to POWER_SLEEP_TPW. A softAP has to keep sending beacons,
+// so the radio can't sleep, but it doesn't need full power to be found by a
+// phone in the same room.
+//
+// A probe request (somebody looking for networks) gets APP_EV_WAKE: full power
+// again before it tries to join, and the idle count starts over. A client that
+// joins while we sleep wakes us up too (app_action_client_joined).
+//
+// The state machine actions (user_main.c) say when:
+//   power_idle   nobody connected: full power, sleep in POWER_IDLE_SLEEP_S
+//   power_awake  a client is here (or something's wrong): full power, no sleep
+//   power_sleep  APP_EV_SLEEP went through: low power
+// and power_on_event, a static event bus subscriber, sees the probe requests.
+
+#ifndef POWER_H
+#define POWER_H
+
+#include "c_types.h"
+#include "user_interface.h"
+
+void power_init(void);
+void power_idle(void);
+void power_awake(void);
+void power_sleep(void);
+void power_on_event(System_Event_t *event);
+void power_report(void);
+
+#endif
@@ -0,0 +1,133 @@
+// Multi-rate executive ... see rate_exec.h.
+//
+// To add a periodic task: declare it in rate_exec.h and put it in schedule[]
+// with its rate group, keeping the table sorted by group.
+
+#include "ets_sys.h"
+#include "osapi.h"
+#include "os_type.h"
+#include "user_interface.h"
+#include "user_config.h"
+#include "rate_exec.h"
+#include "typed_timer.h"
+#include "ccount.h"
+#include "tasks.h"
+
+// The groups must be harmonic, otherwise "everything up to group N" isn't true
+_Static_assert(RATE_DIV_1HZ % RATE_DIV_50HZ == 0, "1Hz group must be a multiple of the 50Hz group");
+_Static_assert(RATE_DIV_0_1HZ % RATE_DIV_1HZ == 0, "0.1Hz group must be a multiple of the 1Hz group");
+_Static_assert(RATE_DIV_0_03HZ % RATE_DIV_0_1HZ == 0, "0.03Hz group must be a multiple of the 0.1Hz group");
+
+typedef void (*rate_task_fn_t)(void);
+
+// All 32 bit fields, so it's safe to leave in flash
+struct rate_task {
+  rate_task_fn_t fn;
+  uint32 group;
+  uint32 deferred;      // 1: posted to the background task instead of run in the tick
+};
+
+LOCAL const uint32 group_div[RATE_GROUP_COUNT] ICACHE_RODATA_ATTR STORE_ATTR = {
+  RATE_DIV_50HZ, RATE_DIV_1HZ, RATE_DIV_0_1HZ, RATE_DIV_0_03HZ
+};
+
+// The static schedule, fastest group first. The telemetry is deferred: printing
+// the reports takes far longer than RATE_EXEC_BUDGET_US, so it runs from the
+// background task and isn't counted against the tick.
+LOCAL const struct rate_task schedule[] ICACHE_RODATA_ATTR STORE_ATTR = {
+  { rate_task_panel,     RATE_50HZ,   0 },
+  { rate_task_stats,     RATE_1HZ,    0 },
+  { rate_task_stations,  RATE_0_1HZ,  0 },
+  { rate_task_telemetry, RATE_0_03HZ, 1 },
+};
+
+#define SCHEDULE_LENGTH  (sizeof(schedule) / sizeof(schedule[0]))
+
+// A bit per schedule entry in the background task's par
+_Static_assert(SCHEDULE_LENGTH <= 32, "too many periodic tasks");
+
+LOCAL os_timer_t tick_timer;
+LOCAL uint32 tick;                // 0 .. RATE_DIV_0_03HZ - 1
+LOCAL uint32 budget_cycles;
+LOCAL uint32 last_tick_us;
+LOCAL sint8 task_client = -1;
+
+// Statistics
+LOCAL uint32 ticks;
+LOCAL uint32 overruns;
+LOCAL uint32 late_ticks;          // the timer fired more than a whole tick late
+LOCAL uint32 deferred_runs;
+LOCAL uint32 group_cycles_max[RATE_GROUP_COUNT];   // longest tick with this as the slowest group due
+
+// The tick. No ICACHE_FLASH_ATTR, this runs 50 times a second.
+LOCAL void rate_exec_tick(void *arg) {
+  uint32 now = system_get_time();
+  uint32 start = get_ccount();
+  uint32 top = 0;
+  uint32 cycles;
+  uint32 i;
+
+  if (ticks > 0 && now - last_tick_us > 2 * RATE_EXEC_TICK_MS * 1000)
+    late_ticks++;
+  last_tick_us = now;
+  ticks++;
+
+  // Slowest group due this tick
+  while (top + 1 < RATE_GROUP_COUNT && tick % group_div[top + 1] == 0)
+    top++;
+
+  // A deferred task runs in the tick after all if we have no background task
+  for (i = 0; i < SCHEDULE_LENGTH && schedule[i].group <= top; i++) {
+    if (schedule[i].deferred && task_client >= 0)
+      task_post(TASK_PRIO_BACKGROUND, task_client, BIT(i));
+    else
+      schedule[i].fn();
+  }
+
+  cycles = get_ccount() - start;
+  if (cycles > group_cycles_max[top])
+    group_cycles_max[top] = cycles;
+  if (cycles > budget_cycles) {
+    overruns++;
+    os_printf("rate: overrun on tick %u, %u us (budget %u us), groups 0 - %u\n",
+              tick, cycles / system_get_cpu_freq(), RATE_EXEC_BUDGET_US, top);
+  }
+
+  if (++tick >= RATE_DIV_0_03HZ)
+    tick = 0;
+}
+
+// The background task: every bit in par is a deferred schedule entry that's due
+LOCAL void ICACHE_FLASH_ATTR deferred_task(uint32 par) {
+  uint32 i;
+
+  for (i = 0; i < SCHEDULE_LENGTH; i++) {
+    if (par & BIT(i)) {
+      deferred_runs++;
+      schedule[i].fn();
+    }
+  }
+}
+
+// Call after task_init
+void ICACHE_FLASH_ATTR rate_exec_init(void) {
+  tick = 0;
+  ticks = 0;
+  deferred_runs = 0;
+  task_client = task_register(TASK_PRIO_BACKGROUND, deferred_task);
+  budget_cycles = RATE_EXEC_BUDGET_US * system_get_cpu_freq();
+
+  os_timer_disarm(&tick_timer);
+  TYPED_TIMER_SETFN(&tick_timer, rate_exec_tick, NULL);
+  os_timer_arm(&tick_timer, RATE_EXEC_TICK_MS, 1);
+}
+
+void ICACHE_FLASH_ATTR rate_exec_report(void) {
+  uint32 mhz = system_get_cpu_freq();
+  uint32 i;
+
+  os_printf("rate: %u ticks, %u overruns, %u late, %u deferred runs (not in the tick times)\n",
+            ticks, overruns, late_ticks, deferred_runs);
+  for (i = 0; i < RATE_GROUP_COUNT; i++)
+    os_printf("  ticks up to group %u: max %u us\n", i, group_cycles_max[i] / mhz);
+}
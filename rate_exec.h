@@ -0,0 +1,52 @@
+// Multi-rate periodic executive. ONE os_timer ticks at 50Hz and everything that
+// has to happen periodically hangs off it in a rate group, instead of every
+// periodic thing getting an os_timer (and a timer function and a setfn/arm) of
+// its own.
+//
+// The groups are harmonic: each one's period is a whole number of the previous
+// one's (checked at compile time), so on any tick the groups that are due are
+// always "group 0 up to some group N". The schedule (which task is in which group)
+// is a const table in rate_exec.c, sorted fastest first, so a tick just runs the
+// table from the top until it hits a group that isn't due. Faster groups first is
+// rate monotonic order: the 50Hz stuff is never stuck behind the slow stuff.
+//
+// Every tick is timed with CCOUNT. If the work in one tick takes more than
+// RATE_EXEC_BUDGET_US that's an overrun and it gets reported.
+//
+// A task marked deferred in the schedule doesn't run in the tick at all: the
+// tick posts it to TASK_PRIO_BACKGROUND (tasks.h) and it runs from there, once
+// everything more urgent is done. That's for the telemetry, which prints for
+// milliseconds and would otherwise blow the budget of every tick it's due on.
+// Deferred tasks are NOT in the tick timing or the overrun count.
+
+#ifndef RATE_EXEC_H
+#define RATE_EXEC_H
+
+#include "c_types.h"
+
+#define RATE_EXEC_TICK_MS   20      // the base tick: 50Hz
+
+// Periods of the rate groups in base ticks
+#define RATE_DIV_50HZ       1       // 20ms
+#define RATE_DIV_1HZ        50      // 1s
+#define RATE_DIV_0_1HZ      500     // 10s
+#define RATE_DIV_0_03HZ     1500    // 30s (also the hyperperiod, the tick count wraps here)
+
+enum rate_group {
+  RATE_50HZ,
+  RATE_1HZ,
+  RATE_0_1HZ,
+  RATE_0_03HZ,
+  RATE_GROUP_COUNT
+};
+
+void rate_exec_init(void);
+void rate_exec_report(void);
+
+// Tasks (see user_main.c, the schedule is in rate_exec.c)
+void rate_task_panel(void);       // 50Hz: push changed rows out to the LED panel
+void rate_task_stats(void);       // 1Hz: sample the statistics
+void rate_task_stations(void);    // 0.1Hz: poll the softAP station list
+void rate_task_telemetry(void);   // every 30s: print the reports
+
+#endif
@@ -0,0 +1,42 @@
+// Sigma-delta modulator helpers. The ESP8266 has one sigma-delta modulator that
+// can drive any GPIO instead of the normal output register. Its average output
+// is target / 256 of the supply, so with a reasonably high clock it makes a very
+// cheap "PWM" for dimming an LED ... no timer and no interrupts needed.
+//
+// While a pin is attached to the modulator, gpio_output_set no longer changes
+// what's on the pin (the output register is still there, it just isn't used).
+
+#ifndef SIGMA_DELTA_H
+#define SIGMA_DELTA_H
+
+#include "c_types.h"
+#include "gpio.h"
+
+// Turn the modulator on. The modulator clock is 80MHz / (prescale + 1).
+static inline void sigma_delta_enable(uint8 prescale) {
+  GPIO_REG_WRITE(GPIO_SIGMA_DELTA,
+                 (SIGMA_DELTA_ENABLE << SIGMA_DELTA_ENABLE_S) |
+                 (prescale << SIGMA_DELTA_SETTING_PRESCALE_S));
+}
+
+// Set the duty (0 = off, 255 = almost always on)
+static inline void sigma_delta_set_target(uint8 target) {
+  uint32 reg = GPIO_REG_READ(GPIO_SIGMA_DELTA);
+
+  reg &= ~(SIGMA_DELTA_TARGET << SIGMA_DELTA_TARGET_S);
+  GPIO_REG_WRITE(GPIO_SIGMA_DELTA, reg | (target << SIGMA_DELTA_TARGET_S));
+}
+
+// Hand a pin over to the modulator ...
+static inline void sigma_delta_attach(uint8 pin) {
+  GPIO_REG_WRITE(GPIO_PIN_ADDR(GPIO_ID_PIN(pin)),
+                 GPIO_REG_READ(GPIO_PIN_ADDR(GPIO_ID_PIN(pin))) | GPIO_PIN_SOURCE_SET(SIGMA_AS_PIN_SOURCE));
+}
+
+// ... and give it back to the normal output register
+static inline void sigma_delta_detach(uint8 pin) {
+  GPIO_REG_WRITE(GPIO_PIN_ADDR(GPIO_ID_PIN(pin)),
+                 GPIO_REG_READ(GPIO_PIN_ADDR(GPIO_ID_PIN(pin))) & ~GPIO_PIN_SOURCE_MASK);
+}
+
+#endif
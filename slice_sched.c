@@ -0,0 +1,174 @@
+// Cooperative job scheduler ... see slice_sched.h.
+//
+// Jobs sit in jobs[] (NULL = free slot). One post in the queue is all we ever
+// need: we post once when there's work and the task re-posts itself at the end
+// of every slice as long as there are jobs left. We're a client on
+// TASK_PRIO_BACKGROUND (see tasks.h) and the coroutines are on TASK_PRIO_NORMAL,
+// so they always get in between two of our slices.
+
+#include "ets_sys.h"
+#include "osapi.h"
+#include "os_type.h"
+#include "user_interface.h"
+#include "user_config.h"
+#include "slice_sched.h"
+#include "ccount.h"
+#include "tasks.h"
+
+LOCAL struct slice_job *jobs[SLICE_JOBS_MAX];
+LOCAL uint8 next_turn[SLICE_PRIO_COUNT];   // round robin position for each priority
+LOCAL bool posted;
+LOCAL sint8 task_client = -1;
+LOCAL uint32 slice_cycles;                 // SLICE_SCHED_SLICE_US in CPU cycles
+
+// Totals for slice_sched_report
+LOCAL uint32 slices_total;
+LOCAL uint32 slice_cycles_max;
+
+// Post the task unless it's already on its way or there's nothing to do
+LOCAL void ICACHE_FLASH_ATTR post(void) {
+  uint32 i;
+
+  if (posted || task_client < 0)
+    return;
+  for (i = 0; i < SLICE_JOBS_MAX; i++) {
+    if (jobs[i] != NULL) {
+      posted = true;
+      task_post(TASK_PRIO_BACKGROUND, task_client, 0);
+      return;
+    }
+  }
+}
+
+// Whose turn is it? The highest priority with a job waiting, and within that
+// priority the next job after the one that ran last.
+LOCAL sint8 ICACHE_FLASH_ATTR pick(void) {
+  sint8 prio;
+  uint32 k;
+
+  for (prio = SLICE_PRIO_COUNT - 1; prio >= 0; prio--) {
+    for (k = 0; k < SLICE_JOBS_MAX; k++) {
+      uint32 i = (next_turn[prio] + k) % SLICE_JOBS_MAX;
+      if (jobs[i] != NULL && jobs[i]->prio == prio) {
+        next_turn[prio] = (i + 1) % SLICE_JOBS_MAX;
+        return i;
+      }
+    }
+  }
+  return -1;
+}
+
+LOCAL void ICACHE_FLASH_ATTR finish(uint8 idx) {
+  struct slice_job *job = jobs[idx];
+  uint32 mhz = system_get_cpu_freq();
+
+  jobs[idx] = NULL;
+  job->queued = false;
+  job->latency_us = system_get_time() - job->start_us;
+  if (job->latency_us == 0)
+    job->latency_us = 1;
+
+  os_printf("slice: %s done in %u us, %u slices, %u calls, longest call %u us\n",
+            job->name, job->latency_us, job->slices, job->calls, job->call_cycles_max / mhz);
+}
+
+// The task: one slice of one job, then back to the SDK
+LOCAL void ICACHE_FLASH_ATTR slice_task(uint32 par) {
+  struct slice_job *job;
+  uint32 start, t;
+  sint8 idx;
+  uint8 result;
+
+  posted = false;
+  idx = pick();
+  if (idx < 0)
+    return;
+
+  job = jobs[idx];
+  job->slices++;
+  slices_total++;
+
+  // Keep calling the job until the slice is used up. We can't stop a call half
+  // way, so a job whose calls are too big will overrun (see call_cycles_max).
+  start = get_ccount();
+  do {
+    t = get_ccount();
+    result = job->fn(job->arg);
+    t = get_ccount() - t;
+
+    job->calls++;
+    if (t > job->call_cycles_max)
+      job->call_cycles_max = t;
+
+    if (result == SLICE_JOB_DONE) {
+      finish(idx);
+      break;
+    }
+  } while (get_ccount() - start < slice_cycles);
+
+  t = get_ccount() - start;
+  if (t > slice_cycles_max)
+    slice_cycles_max = t;
+
+  post();
+}
+
+void ICACHE_FLASH_ATTR slice_sched_init(void) {
+  os_bzero(jobs, sizeof(jobs));
+  os_bzero(next_turn, sizeof(next_turn));
+  posted = false;
+  slice_cycles = SLICE_SCHED_SLICE_US * system_get_cpu_freq();
+  task_client = task_register(TASK_PRIO_BACKGROUND, slice_task);
+}
+
+// Queue a job. Returns false if the job is already queued, the priority is no
+// good or all SLICE_JOBS_MAX slots are taken.
+bool ICACHE_FLASH_ATTR slice_sched_submit(struct slice_job *job, slice_job_fn_t fn, void *arg,
+                                          const char *name, uint8 prio) {
+  uint32 i;
+
+  if (job->queued || prio >= SLICE_PRIO_COUNT)
+    return false;
+
+  for (i = 0; i < SLICE_JOBS_MAX; i++) {
+    if (jobs[i] == NULL) {
+      os_bzero(job, sizeof(*job));
+      job->fn = fn;
+      job->arg = arg;
+      job->name = name;
+      job->prio = prio;
+      job->queued = true;
+      job->start_us = system_get_time();
+      jobs[i] = job;
+      post();
+      return true;
+    }
+  }
+  return false;
+}
+
+// Drop a job that hasn't finished (its fn won't be called again)
+void ICACHE_FLASH_ATTR slice_sched_cancel(struct slice_job *job) {
+  uint32 i;
+
+  for (i = 0; i < SLICE_JOBS_MAX; i++) {
+    if (jobs[i] == job) {
+      jobs[i] = NULL;
+      job->queued = false;
+    }
+  }
+}
+
+void ICACHE_FLASH_ATTR slice_sched_report(void) {
+  uint32 mhz = system_get_cpu_freq();
+  uint32 i;
+
+  os_printf("slice: %u slices so far, longest %u us (budget %u us)\n",
+            slices_total, slice_cycles_max / mhz, SLICE_SCHED_SLICE_US);
+  for (i = 0; i < SLICE_JOBS_MAX; i++) {
+    struct slice_job *job = jobs[i];
+    if (job != NULL)
+      os_printf("  %s: prio %d, %u slices, %u calls, running for %u us\n",
+                job->name, job->prio, job->slices, job->calls, system_get_time() - job->start_us);
+  }
+}
@@ -0,0 +1,60 @@
+// Cooperative job scheduler for work that takes too long for one callback.
+//
+// The SDK wants every callback back within a few milliseconds or the WiFi
+// starves (and after a while the watchdog bites). Things like a CRC over the
+// whole firmware image take much longer than that. So a job does its work a
+// little bit per call and returns SLICE_JOB_MORE until it's finished:
+//
+//   LOCAL uint8 ICACHE_FLASH_ATTR my_job(void *arg) {
+//     do_the_next_little_bit();
+//     return all_done ? SLICE_JOB_DONE : SLICE_JOB_MORE;
+//   }
+//
+// The scheduler keeps calling the job until its slice (SLICE_SCHED_SLICE_US,
+// measured with CCOUNT) is used up, then re-posts itself (on TASK_PRIO_BACKGROUND,
+// see tasks.h) so the SDK gets to run in between. The highest priority level
+// with jobs waiting always goes first and jobs of the same priority take turns
+// (round robin), one slice each.
+//
+// A struct slice_job belongs to whoever submits it and must stay around (static)
+// until the job is done.
+
+#ifndef SLICE_SCHED_H
+#define SLICE_SCHED_H
+
+#include "c_types.h"
+
+#define SLICE_JOBS_MAX    8
+
+// What a job function returns
+#define SLICE_JOB_MORE    0
+#define SLICE_JOB_DONE    1
+
+// Priorities (higher runs first)
+#define SLICE_PRIO_LOW    0
+#define SLICE_PRIO_NORMAL 1
+#define SLICE_PRIO_HIGH   2
+#define SLICE_PRIO_COUNT  3
+
+typedef uint8 (*slice_job_fn_t)(void *arg);
+
+struct slice_job {
+  slice_job_fn_t fn;
+  void *arg;
+  const char *name;
+  uint8 prio;
+  bool queued;
+  uint16 pad;
+  uint32 slices;          // slices the job got
+  uint32 calls;           // calls to fn
+  uint32 start_us;        // when it was submitted
+  uint32 latency_us;      // submit to done (0 while still running)
+  uint32 call_cycles_max; // longest single call to fn, should be well under a slice
+};
+
+void slice_sched_init(void);
+bool slice_sched_submit(struct slice_job *job, slice_job_fn_t fn, void *arg, const char *name, uint8 prio);
+void slice_sched_cancel(struct slice_job *job);
+void slice_sched_report(void);
+
+#endif
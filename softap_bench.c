@@ -0,0 +1,183 @@
+// softAP settings benchmark ... see softap_bench.h.
+//
+// Current estimate: the radio listens (RX_MA) all the time and transmits (TX_MA)
+// for BEACON_AIRTIME_US every beacon. A beacon goes out at 1Mbps and is around a
+// hundred bytes plus the preamble, so about a millisecond.
+
+#include "ets_sys.h"
+#include "osapi.h"
+#include "user_interface.h"
+#include "ping.h"
+#include "softap_bench.h"
+#include "softap_tune.h"
+#include "event_bus.h"
+#include "typed_timer.h"
+
+#define RX_MA              56
+#define TX_MA              170
+#define BEACON_AIRTIME_US  1000
+
+// What gets tried. No hidden SSID in here by default: the clients we count on
+// to join again wouldn't find us.
+LOCAL const struct softap_params settings[] = {
+  { 4, 0, 1, 100 },
+  { 4, 0, 1, 300 },
+  { 4, 0, 1, 1000 },
+  { 1, 0, 1, 100 },
+  { 4, 0, 6, 100 },
+  { 4, 0, 11, 100 },
+};
+
+#define SETTING_COUNT  (sizeof(settings) / sizeof(settings[0]))
+
+enum {
+  BENCH_IDLE,
+  BENCH_WAIT_JOIN,
+  BENCH_WAIT_IP,
+  BENCH_PINGING,
+  BENCH_SETTLE
+};
+
+struct bench_result {
+  uint32 join_ms;        // settings applied -> first client joined
+  uint32 ip_ms;          // ... -> it got its IP
+  uint32 rtt_sum_ms;
+  uint32 rtt_max_ms;
+  uint8 replies;
+  uint8 lost;
+  bool timed_out;
+};
+
+LOCAL struct bench_result results[SETTING_COUNT];
+LOCAL uint8 current;
+LOCAL uint8 phase = BENCH_IDLE;
+LOCAL uint32 applied_us;
+LOCAL sint8 bus_slot = -1;
+LOCAL os_timer_t step_timer;
+LOCAL struct ping_option ping_opt;
+
+LOCAL void next_setting(void);
+
+// Tenths of a mA for a beacon interval
+LOCAL uint32 ICACHE_FLASH_ATTR estimate_ma_x10(uint16 beacon_ms) {
+  return RX_MA * 10 + (TX_MA - RX_MA) * 10 * BEACON_AIRTIME_US / 1000 / beacon_ms;
+}
+
+LOCAL void ICACHE_FLASH_ATTR report(void) {
+  uint8 i;
+
+  os_printf("softap bench: clients beacon channel | join ms  ip ms | rtt avg max lost | est mA\n");
+  for (i = 0; i < SETTING_COUNT; i++) {
+    const struct softap_params *s = &settings[i];
+    const struct bench_result *r = &results[i];
+    uint32 ma = estimate_ma_x10(s->beacon_interval);
+
+    if (r->timed_out) {
+      os_printf("  %u %5u %2u | nobody joined | %u.%u\n", s->max_connection,
+                s->beacon_interval, s->channel, ma / 10, ma % 10);
+      continue;
+    }
+    os_printf("  %u %5u %2u | %5u %5u | %3u %3u %u/%u | %u.%u\n", s->max_connection,
+              s->beacon_interval, s->channel, r->join_ms, r->ip_ms,
+              r->replies ? r->rtt_sum_ms / r->replies : 0, r->rtt_max_ms,
+              r->lost, SOFTAP_BENCH_PINGS, ma / 10, ma % 10);
+  }
+}
+
+// One ping answered (or not)
+LOCAL void ICACHE_FLASH_ATTR ping_recv(void *arg, void *data) {
+  struct ping_resp *resp = data;
+  struct bench_result *r = &results[current];
+
+  if (resp->ping_err == -1) {
+    r->lost++;
+    return;
+  }
+  r->replies++;
+  r->rtt_sum_ms += resp->resp_time;
+  if (resp->resp_time > r->rtt_max_ms)
+    r->rtt_max_ms = resp->resp_time;
+}
+
+// All pings done, on to the next setting after a breather
+LOCAL void ICACHE_FLASH_ATTR ping_done(void *arg, void *data) {
+  if (phase != BENCH_PINGING)
+    return;
+  phase = BENCH_SETTLE;
+  os_timer_disarm(&step_timer);
+  os_timer_arm(&step_timer, SOFTAP_BENCH_SETTLE_MS, 0);
+}
+
+// Dynamic event bus subscriber: the first client after the settings changed
+LOCAL void ICACHE_FLASH_ATTR bench_event(System_Event_t *event) {
+  uint32 elapsed_ms = (system_get_time() - applied_us) / 1000;
+
+  if (event->event == EVENT_SOFTAPMODE_STACONNECTED && phase == BENCH_WAIT_JOIN) {
+    results[current].join_ms = elapsed_ms;
+    phase = BENCH_WAIT_IP;
+  } else if (event->event == EVENT_SOFTAPMODE_DISTRIBUTE_STA_IP && phase == BENCH_WAIT_IP) {
+    results[current].ip_ms = elapsed_ms;
+    phase = BENCH_PINGING;
+
+    os_bzero(&ping_opt, sizeof(ping_opt));
+    ping_opt.count = SOFTAP_BENCH_PINGS;
+    ping_opt.ip = event->event_info.distribute_sta_ip.ip.addr;
+    ping_opt.coarse_time = 1;     // seconds between pings
+    ping_regist_recv(&ping_opt, ping_recv);
+    ping_regist_sent(&ping_opt, ping_done);
+    if (!ping_start(&ping_opt))
+      ping_done(NULL, NULL);
+  }
+}
+
+// The step timer: either the breather after a setting is over or nobody joined
+// in time
+LOCAL void ICACHE_FLASH_ATTR step_timer_function(void *arg) {
+  if (phase == BENCH_WAIT_JOIN || phase == BENCH_WAIT_IP)
+    results[current].timed_out = true;
+  else if (phase == BENCH_PINGING)
+    return;     // a late ping, ping_done moves us on
+
+  current++;
+  next_setting();
+}
+
+LOCAL void ICACHE_FLASH_ATTR next_setting(void) {
+  struct softap_params defaults;
+
+  if (current >= SETTING_COUNT) {
+    report();
+    event_bus_unsubscribe(bus_slot);
+    bus_slot = -1;
+    phase = BENCH_IDLE;
+    softap_tune_defaults(&defaults);
+    softap_tune_apply(&defaults);
+    return;
+  }
+
+  phase = BENCH_WAIT_JOIN;
+  applied_us = system_get_time();
+  if (!softap_tune_apply(&settings[current]))
+    results[current].timed_out = true;
+  os_timer_arm(&step_timer, SOFTAP_BENCH_TIMEOUT_MS, 0);
+}
+
+// Go through the settings table (false if it's already running or the event bus
+// has no room for us)
+bool ICACHE_FLASH_ATTR softap_bench_start(void) {
+  if (phase != BENCH_IDLE)
+    return false;
+
+  bus_slot = event_bus_subscribe(bench_event,
+                                 EVENT_BUS_MASK(EVENT_SOFTAPMODE_STACONNECTED) |
+                                 EVENT_BUS_MASK(EVENT_SOFTAPMODE_DISTRIBUTE_STA_IP));
+  if (bus_slot < 0)
+    return false;
+
+  os_bzero(results, sizeof(results));
+  current = 0;
+  TYPED_TIMER_SETFN(&step_timer, step_timer_function, NULL);
+  os_printf("softap bench: %u settings, %u pings each\n", SETTING_COUNT, SOFTAP_BENCH_PINGS);
+  next_setting();
+  return true;
+}
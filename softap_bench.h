@@ -0,0 +1,25 @@
+// softAP settings benchmark. Goes through a list of settings (the table in
+// softap_bench.c) and for each one:
+//   - applies it with softap_tune_apply, which drops every client
+//   - waits for the first client to join again and get its IP (a phone or a
+//     laptop that knows the network, it stands in for the host)
+//   - pings that client SOFTAP_BENCH_PINGS times
+//   - estimates what the beacons cost in current
+// and when it has been through all of them prints a table and goes back to the
+// user_config.h settings.
+//
+// The current is an estimate from the datasheet numbers, we have no way to
+// measure it. Put a meter in the supply if you want the real thing.
+
+#ifndef SOFTAP_BENCH_H
+#define SOFTAP_BENCH_H
+
+#include "c_types.h"
+
+#define SOFTAP_BENCH_PINGS       10
+#define SOFTAP_BENCH_TIMEOUT_MS  30000   // give up on a setting if nobody joins by then
+#define SOFTAP_BENCH_SETTLE_MS   2000    // between settings
+
+bool softap_bench_start(void);
+
+#endif
@@ -0,0 +1,55 @@
+// Run time softAP settings ... see softap_tune.h.
+
+#include "ets_sys.h"
+#include "osapi.h"
+#include "user_interface.h"
+#include "user_config.h"
+#include "softap_tune.h"
+
+// The settings from user_config.h (what init_done_callback uses)
+void ICACHE_FLASH_ATTR softap_tune_defaults(struct softap_params *params) {
+  params->max_connection = SOFTAP_MAX_CONNECTION;
+  params->hidden = SOFTAP_HIDDEN;
+  params->channel = SOFTAP_CHANNEL;
+  params->beacon_interval = SOFTAP_BEACON_INTERVAL;
+}
+
+// The settings the softAP is running with right now
+void ICACHE_FLASH_ATTR softap_tune_get(struct softap_params *params) {
+  struct softap_config config;
+
+  wifi_softap_get_config(&config);
+  params->max_connection = config.max_connection;
+  params->hidden = config.ssid_hidden;
+  params->channel = config.channel;
+  params->beacon_interval = config.beacon_interval;
+}
+
+// Change the settings without a reboot (false if the SDK won't take them). The
+// SSID, password and auth mode stay what they are.
+bool ICACHE_FLASH_ATTR softap_tune_apply(const struct softap_params *params) {
+  struct softap_config config;
+
+  if (params->max_connection < 1 || params->max_connection > SOFTAP_MAX_CONNECTION_LIMIT ||
+      params->beacon_interval < SOFTAP_BEACON_MIN || params->beacon_interval > SOFTAP_BEACON_MAX ||
+      params->channel < 1 || params->channel > SOFTAP_CHANNEL_MAX || params->hidden > 1) {
+    os_printf("softap: bad settings (%u clients, %ums beacon, channel %u, hidden %u)\n",
+              params->max_connection, params->beacon_interval, params->channel, params->hidden);
+    return false;
+  }
+
+  wifi_softap_get_config(&config);
+  config.max_connection = params->max_connection;
+  config.ssid_hidden = params->hidden;
+  config.channel = params->channel;
+  config.beacon_interval = params->beacon_interval;
+
+  if (!wifi_softap_set_config_current(&config)) {
+    os_printf("softap: the SDK didn't take the new settings\n");
+    return false;
+  }
+
+  os_printf("softap: %u clients, %ums beacon, channel %u%s\n", params->max_connection,
+            params->beacon_interval, params->channel, params->hidden ? ", hidden" : "");
+  return true;
+}
@@ -0,0 +1,32 @@
+// Change the softAP settings while we're running: how many clients, how often
+// we send a beacon, hidden SSID or not, and the channel. init_done_callback sets
+// them from user_config.h at boot; softap_tune_apply changes them afterwards.
+//
+// It uses wifi_softap_set_config_current, so nothing goes to flash and the next
+// boot starts with the user_config.h settings again. The SDK restarts the softAP
+// to apply new settings, so connected clients get dropped and have to join again
+// (with a hidden SSID only the ones that know it will).
+
+#ifndef SOFTAP_TUNE_H
+#define SOFTAP_TUNE_H
+
+#include "c_types.h"
+
+// What the SDK takes
+#define SOFTAP_MAX_CONNECTION_LIMIT  8
+#define SOFTAP_BEACON_MIN            100      // ms
+#define SOFTAP_BEACON_MAX            60000
+#define SOFTAP_CHANNEL_MAX           13
+
+struct softap_params {
+  uint8 max_connection;
+  uint8 hidden;
+  uint8 channel;
+  uint16 beacon_interval;    // ms
+};
+
+void softap_tune_defaults(struct softap_params *params);
+void softap_tune_get(struct softap_params *params);
+bool softap_tune_apply(const struct softap_params *params);
+
+#endif
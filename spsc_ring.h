@@ -0,0 +1,89 @@
+// Single producer / single consumer ring buffer, for handing data from an
+// interrupt to task context (or from one task to another).
+//
+//   SPSC_RING_DECLARE(edge_ring, uint32, 64)
+//
+// gives you struct edge_ring and the functions edge_ring_push, edge_ring_pop,
+// edge_ring_pop_batch, edge_ring_count and edge_ring_reset.
+//
+// Why no ETS_INTR_LOCK? The lx106 has one core, and each side only ever writes
+// its own index: the producer (the interrupt) writes head, the consumer writes
+// tail. head and tail are free running 32 bit counters, so head - tail is the
+// fill level even after they wrap, and the capacity has to be a power of two
+// so "& (size - 1)" finds the slot. The only thing to get right is the order:
+// the producer must store the item BEFORE it moves head, and the consumer must
+// read the items BEFORE it moves tail. The memw barrier makes sure the compiler
+// (and the memory system) don't swap those around.
+//
+// Rules: exactly one producer and one consumer per ring. If two interrupts can
+// push into the same ring they are two producers ... give each its own ring.
+//
+// A push into a full ring drops the item and counts it in overflows.
+
+#ifndef SPSC_RING_H
+#define SPSC_RING_H
+
+#include "c_types.h"
+
+#ifdef __XTENSA__
+#define SPSC_BARRIER()  __asm__ __volatile__("memw" : : : "memory")
+#else
+// Host builds (test/host/spsc_test.c runs the two sides on two threads)
+#define SPSC_BARRIER()  __atomic_thread_fence(__ATOMIC_SEQ_CST)
+#endif
+
+#define SPSC_RING_DECLARE(name, type, size)                                         \
+  _Static_assert((size) > 0 && ((size) & ((size) - 1)) == 0,                        \
+                 #name " size must be a power of two");                             \
+                                                                                    \
+  struct name {                                                                     \
+    type items[size];                                                               \
+    volatile uint32 head;       /* written by the producer only */                  \
+    volatile uint32 tail;       /* written by the consumer only */                  \
+    volatile uint32 overflows;  /* written by the producer only */                  \
+  };                                                                                \
+                                                                                    \
+  static inline void name##_reset(struct name *r) {                                 \
+    r->head = 0;                                                                    \
+    r->tail = 0;                                                                    \
+    r->overflows = 0;                                                               \
+  }                                                                                 \
+                                                                                    \
+  /* Items waiting (safe from either side) */                                       \
+  static inline uint32 name##_count(const struct name *r) {                         \
+    return r->head - r->tail;                                                       \
+  }                                                                                 \
+                                                                                    \
+  /* Producer side. Returns false (and counts an overflow) if the ring is full. */  \
+  static inline bool name##_push(struct name *r, type item) {                       \
+    uint32 head = r->head;                                                          \
+    if (head - r->tail >= (size)) {                                                 \
+      r->overflows++;                                                               \
+      return false;                                                                 \
+    }                                                                               \
+    r->items[head & ((size) - 1)] = item;                                           \
+    SPSC_BARRIER();                                                                 \
+    r->head = head + 1;                                                             \
+    return true;                                                                    \
+  }                                                                                 \
+                                                                                    \
+  /* Consumer side: take up to max items out in one go. Returns how many. */        \
+  static inline uint32 name##_pop_batch(struct name *r, type *out, uint32 max) {    \
+    uint32 tail = r->tail;                                                          \
+    uint32 n = r->head - tail;                                                      \
+    uint32 i;                                                                       \
+    SPSC_BARRIER();                                                                 \
+    if (n > max)                                                                    \
+      n = max;                                                                      \
+    for (i = 0; i < n; i++)                                                         \
+      out[i] = r->items[(tail + i) & ((size) - 1)];                                 \
+    SPSC_BARRIER();                                                                 \
+    r->tail = tail + n;                                                             \
+    return n;                                                                       \
+  }                                                                                 \
+                                                                                    \
+  static inline bool name##_pop(struct name *r, type *out) {                        \
+    return name##_pop_batch(r, out, 1) == 1;                                        \
+  }
+
+#endif
@@ -0,0 +1,179 @@
+// Task layer ... see tasks.h.
+//
+// What goes in the SDK's os_event_t:
+//   sig  bits 0-7   client id
+//        bits 8-31  system_get_time() when it was posted (low 24 bits, good for
+//                   16 seconds, which is plenty for a latency)
+//   par  the client's par
+//
+// The pending bits are written by task_post (maybe from an interrupt) and taken
+// by the task, so both sides touch them with interrupts off. Not with
+// ETS_INTR_LOCK/UNLOCK though: the unlock turns interrupts back on, and that's
+// the last thing we want when task_post is called from an interrupt handler.
+// irq_save/irq_restore put back whatever level we had. The posts and full
+// counters are bumped the same way: a task posting can be interrupted halfway
+// through its ++ by an interrupt that posts too, and one of the two would be lost.
+
+#include "ets_sys.h"
+#include "osapi.h"
+#include "os_type.h"
+#include "user_interface.h"
+#include "user_config.h"
+#include "tasks.h"
+
+#define TIME_BITS   24
+#define TIME_MASK   ((1 << TIME_BITS) - 1)
+
+#ifdef __XTENSA__
+
+static inline uint32 irq_save(void) {
+  uint32 ps;
+  __asm__ __volatile__("rsil %0, 15" : "=a"(ps) : : "memory");
+  return ps;
+}
+
+static inline void irq_restore(uint32 ps) {
+  __asm__ __volatile__("wsr %0, ps; rsync" : : "a"(ps) : "memory");
+}
+
+#else
+
+// Host builds (test/host): no interrupts to hold off
+static inline uint32 irq_save(void) {
+  return 0;
+}
+
+static inline void irq_restore(uint32 ps) {
+}
+
+#endif
+
+struct prio {
+  task_handler_t handlers[TASK_CLIENTS_MAX];
+  uint32 pending[TASK_CLIENTS_MAX];     // coalesced pars waiting for the next run
+  volatile uint32 pending_clients;      // bit per client with a coalesced post
+  uint8 clients;
+  uint8 depth;
+  uint16 pad;
+
+  // Statistics
+  uint32 posts;
+  uint32 runs;
+  uint32 full;                          // posts that found the queue full (coalesced)
+  uint32 latency_us_max;
+};
+
+LOCAL struct prio prios[TASK_PRIO_COUNT];
+
+LOCAL os_event_t queue_background[TASK_QUEUE_BACKGROUND];
+LOCAL os_event_t queue_normal[TASK_QUEUE_NORMAL];
+LOCAL os_event_t queue_urgent[TASK_QUEUE_URGENT];
+
+// Run one event: first whatever got coalesced on this priority, then the event
+LOCAL void ICACHE_FLASH_ATTR task_run(uint8 prio, os_event_t *e) {
+  struct prio *p = &prios[prio];
+  uint8 client = e->sig & 0xff;
+  uint32 latency = ((system_get_time() & TIME_MASK) - (e->sig >> 8)) & TIME_MASK;
+  uint32 pending[TASK_CLIENTS_MAX];
+  uint32 pending_clients;
+  uint32 ps;
+  uint32 i;
+
+  p->runs++;
+  if (latency > p->latency_us_max)
+    p->latency_us_max = latency;
+
+  pending_clients = p->pending_clients;
+  if (pending_clients != 0) {
+    ps = irq_save();
+    pending_clients = p->pending_clients;
+    os_memcpy(pending, p->pending, sizeof(pending));
+    os_bzero(p->pending, sizeof(p->pending));
+    p->pending_clients = 0;
+    irq_restore(ps);
+
+    for (i = 0; i < p->clients; i++)
+      if (pending_clients & BIT(i))
+        p->handlers[i](pending[i]);
+  }
+
+  if (client < p->clients)
+    p->handlers[client](e->par);
+}
+
+// One function per priority, the SDK doesn't tell the task which priority it is
+LOCAL void ICACHE_FLASH_ATTR task_background(os_event_t *e) {
+  task_run(TASK_PRIO_BACKGROUND, e);
+}
+
+LOCAL void ICACHE_FLASH_ATTR task_normal(os_event_t *e) {
+  task_run(TASK_PRIO_NORMAL, e);
+}
+
+LOCAL void ICACHE_FLASH_ATTR task_urgent(os_event_t *e) {
+  task_run(TASK_PRIO_URGENT, e);
+}
+
+void ICACHE_FLASH_ATTR task_init(void) {
+  os_bzero(prios, sizeof(prios));
+  prios[TASK_PRIO_BACKGROUND].depth = TASK_QUEUE_BACKGROUND;
+  prios[TASK_PRIO_NORMAL].depth = TASK_QUEUE_NORMAL;
+  prios[TASK_PRIO_URGENT].depth = TASK_QUEUE_URGENT;
+
+  system_os_task(task_background, USER_TASK_PRIO_0, queue_background, TASK_QUEUE_BACKGROUND);
+  system_os_task(task_normal, USER_TASK_PRIO_1, queue_normal, TASK_QUEUE_NORMAL);
+  system_os_task(task_urgent, USER_TASK_PRIO_2, queue_urgent, TASK_QUEUE_URGENT);
+}
+
+// Get a client id on a priority (-1 if the priority is full or no good)
+sint8 ICACHE_FLASH_ATTR task_register(uint8 prio, task_handler_t handler) {
+  struct prio *p;
+
+  if (prio >= TASK_PRIO_COUNT || handler == NULL)
+    return -1;
+  p = &prios[prio];
+  if (p->clients >= TASK_CLIENTS_MAX)
+    return -1;
+
+  p->handlers[p->clients] = handler;
+  return p->clients++;
+}
+
+// Post to a client. Returns true if it went in the queue, false if the queue was
+// full and it got coalesced (the handler still gets it) or if there's no such
+// client (nobody gets it, and nothing is written). No ICACHE_FLASH_ATTR,
+// interrupts call this.
+bool task_post(uint8 prio, uint8 client, uint32 par) {
+  struct prio *p;
+  uint32 sig;
+  uint32 ps;
+
+  if (prio >= TASK_PRIO_COUNT || client >= prios[prio].clients)
+    return false;
+  p = &prios[prio];
+  sig = client | ((system_get_time() & TIME_MASK) << 8);
+
+  ps = irq_save();
+  p->posts++;
+  irq_restore(ps);
+  if (system_os_post(USER_TASK_PRIO_0 + prio, sig, par))
+    return true;
+
+  ps = irq_save();
+  p->full++;
+  p->pending[client] |= par;
+  p->pending_clients |= BIT(client);
+  irq_restore(ps);
+  return false;
+}
+
+void ICACHE_FLASH_ATTR task_report(void) {
+  static const char *names[TASK_PRIO_COUNT] = { "background", "normal", "urgent" };
+  uint32 i;
+
+  for (i = 0; i < TASK_PRIO_COUNT; i++) {
+    struct prio *p = &prios[i];
+    os_printf("task %s: %d clients, queue %d, %u posts, %u runs, %u full, max latency %u us\n",
+              names[i], p->clients, p->depth, p->posts, p->runs, p->full, p->latency_us_max);
+  }
+}
@@ -0,0 +1,41 @@
+// Task layer on top of system_os_task. The SDK gives us three user task
+// priorities, each with its own queue. This file owns all three and hands them
+// out to whoever needs one:
+//
+//   TASK_PRIO_URGENT      things that can't wait (the freq capture rings filling up)
+//   TASK_PRIO_NORMAL      everyday work (the coroutines in coro.c)
+//   TASK_PRIO_BACKGROUND  maintenance that can take its time (slice_sched.c jobs, the
+//                         deferred rate_exec.c tasks)
+//
+// A module calls task_register once to get a client id on a priority and then
+// task_post(prio, id, par) whenever it wants its handler called with par.
+// task_post is safe to call from an interrupt. If task_register failed (-1) don't
+// post at all; task_post ignores ids it never handed out, but only as a safety net.
+//
+// If a queue is full the post isn't lost. It is OR-ed into the client's pending
+// bits and the handler gets them on the next run at that priority. So par should
+// be a set of bits (or not matter at all) ... two posts can arrive as one.
+//
+// Every priority counts posts, runs, full queues and the worst post to run
+// latency (see task_report).
+
+#ifndef TASKS_H
+#define TASKS_H
+
+#include "c_types.h"
+
+#define TASK_PRIO_BACKGROUND  0     // USER_TASK_PRIO_0
+#define TASK_PRIO_NORMAL      1     // USER_TASK_PRIO_1
+#define TASK_PRIO_URGENT      2     // USER_TASK_PRIO_2
+#define TASK_PRIO_COUNT       3
+
+#define TASK_CLIENTS_MAX      4     // handlers per priority
+
+typedef void (*task_handler_t)(uint32 par);
+
+void task_init(void);
+sint8 task_register(uint8 prio, task_handler_t handler);
+bool task_post(uint8 prio, uint8 client, uint32 par);
+void task_report(void);
+
+#endif
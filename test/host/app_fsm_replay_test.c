@@ -0,0 +1,313 @@
+// The softAP state machine with the real actions, fed from the real sources.
+//
+// app_fsm_test.c checks the table with stub actions. Here user_main.c (its
+// actions and WiFi event handler), app_fsm.c and power.c are #included, so the
+// test sees the handler's counts, the transition table, the log and the power
+// saving stats, and the events come from where they come from on a unit: WiFi
+// events through the event bus, the power saving timer and probe requests
+// (power.c), and the softAP config retry (rate_task_stations).
+//
+// Checks:
+//   - trace_two_clients (event_traces.h) through the bus goes through the
+//     states it should, event by event
+//   - every input of the fuzz corpus (corpus/wifi_event): every transition the
+//     log recorded is the one in the table, one after the other, and we're
+//     SERVING exactly when there are clients
+//   - nobody around for POWER_IDLE_SLEEP_S: SLEEPING, LED off, TX power down;
+//     a probe request wakes it up (full power, and it goes to sleep again
+//     later), and so does a client joining
+//   - the softAP config failing at boot: DEGRADED and blinking, until a retry
+//     works and it's AP_IDLE with everything started, once
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dirent.h>
+#include "user_main.c"
+#include "app_fsm.c"
+#include "power.c"
+#include "event_trace.c"
+#include "sdk_stubs.h"
+
+#define CORPUS_DIR    "test/host/corpus/wifi_event"
+#define STEP_BYTES    (1 + sizeof(System_Event_t))
+#define STEP_MS       10
+#define RETRY_MS      10000     // rate_task_stations
+
+LOCAL uint32 checked_log;       // log_next up to where the log has been checked
+
+// Power on: user_init, then the SDK's init done callback (like the fuzz target)
+LOCAL void boot(void) {
+  stop_blinking();
+  coro_stop(&connect_coro);
+
+  host_reset();
+  client_aids = 0;
+  clients = 0;
+  refused_aids = 0;
+  os_bzero(&handler_stats, sizeof(handler_stats));
+  heap_min = 0;
+  softap_failed = false;
+  ap_started = false;
+
+  user_init();
+  host_run_tasks();
+  host_init_done_cb();
+  host_run_tasks();
+  checked_log = 0;
+}
+
+LOCAL void event(System_Event_t *e) {
+  host_event_cb(e);
+  host_run_tasks();
+}
+
+LOCAL void station(uint32 id, uint8 aid) {
+  System_Event_t e;
+
+  os_bzero(&e, sizeof(e));
+  e.event = id;
+  e.event_info.sta_connected.aid = aid;
+  e.event_info.sta_connected.mac[0] = 0x3c;
+  e.event_info.sta_connected.mac[5] = aid;
+  event(&e);
+}
+
+LOCAL void probe(void) {
+  System_Event_t e;
+
+  os_bzero(&e, sizeof(e));
+  e.event = EVENT_SOFTAPMODE_PROBEREQRECVED;
+  e.event_info.ap_probereqrecved.rssi = -60;
+  event(&e);
+}
+
+// The log entries since the last call: each one is what the table says for its
+// state and event, and starts where the one before ended. Returns false (after
+// saying why) if not.
+LOCAL bool log_follows_table(const char *name, uint32 step) {
+  uint32 first = checked_log;
+  uint8 at;
+  uint32 i;
+
+  // Only the last APP_FSM_LOG_SIZE are still there
+  if (log_next - first > APP_FSM_LOG_SIZE)
+    first = log_next - APP_FSM_LOG_SIZE;
+  at = first > 0 ? fsm_log[(first - 1) & (APP_FSM_LOG_SIZE - 1)].to : APP_BOOTING;
+  checked_log = log_next;
+
+  for (i = first; i < log_next; i++) {
+    const struct app_fsm_log_entry *e = &fsm_log[i & (APP_FSM_LOG_SIZE - 1)];
+
+    if (e->from != at || e->event >= APP_EVENT_COUNT || transitions[e->from][e->event].next != e->to) {
+      fprintf(stderr, "%s: step %u: log entry %u: %u --%u--> %u, we were in %u\n", name, step, i,
+              e->from, e->event, e->to, at);
+      return false;
+    }
+    at = e->to;
+  }
+  if (at != app_fsm_state()) {
+    fprintf(stderr, "%s: step %u: the log ends in %u, the state is %u\n", name, step, at, app_fsm_state());
+    return false;
+  }
+  return true;
+}
+
+LOCAL void test_trace(void) {
+  static const uint8 expected[] = {
+    APP_AP_IDLE, APP_AP_IDLE, APP_SERVING, APP_SERVING, APP_SERVING,
+    APP_SERVING, APP_SERVING, APP_SERVING, APP_AP_IDLE, APP_AP_IDLE,
+  };
+  uint32 count = sizeof(trace_two_clients) / sizeof(trace_two_clients[0]);
+  uint32 i;
+
+  _Static_assert(sizeof(expected) == sizeof(trace_two_clients) / sizeof(trace_two_clients[0]),
+                 "one expected state per record");
+  boot();
+  HOST_CHECK(app_fsm_state() == APP_AP_IDLE);
+  for (i = 0; i < count; i++) {
+    System_Event_t e;
+
+    if (i > 0)
+      host_advance_ms(trace_two_clients[i].time_ms - trace_two_clients[i - 1].time_ms);
+    record_to_event(&trace_two_clients[i], &e);
+    event(&e);
+    if (app_fsm_state() != expected[i]) {
+      fprintf(stderr, "trace_two_clients: record %u: state %u, expected %u\n", i, app_fsm_state(), expected[i]);
+      host_failures++;
+    }
+    if (!log_follows_table("trace_two_clients", i))
+      host_failures++;
+  }
+  HOST_CHECK(handler_stats.invariant_failures == 0);
+}
+
+// One corpus input, the way the fuzz target plays it
+LOCAL void replay_input(const char *name, const uint8 *data, uint32 size) {
+  uint32 step;
+
+  boot();
+  for (step = 0; (step + 1) * STEP_BYTES <= size; step++) {
+    const uint8 *p = data + step * STEP_BYTES;
+    System_Event_t e;
+
+    host_advance_ms(p[0] * STEP_MS);
+    os_memcpy(&e, p + 1, sizeof(e));
+    event(&e);
+    if (!log_follows_table(name, step))
+      host_failures++;
+    if ((app_fsm_state() == APP_SERVING) != (clients > 0)) {
+      fprintf(stderr, "%s: step %u: state %u with %u clients\n", name, step, app_fsm_state(), clients);
+      host_failures++;
+    }
+  }
+  HOST_CHECK(handler_stats.invariant_failures == 0);
+}
+
+// Returns how many inputs there were
+LOCAL uint32 test_corpus(void) {
+  static uint8 data[1 << 16];
+  char path[512];
+  struct dirent *d;
+  uint32 inputs = 0;
+  DIR *dir = opendir(CORPUS_DIR);
+
+  if (dir == NULL) {
+    perror(CORPUS_DIR);
+    host_failures++;
+    return 0;
+  }
+  while ((d = readdir(dir)) != NULL) {
+    FILE *f;
+    size_t size;
+
+    if (d->d_name[0] == '.')
+      continue;
+    snprintf(path, sizeof(path), "%s/%s", CORPUS_DIR, d->d_name);
+    f = fopen(path, "rb");
+    if (f == NULL) {
+      perror(path);
+      host_failures++;
+      continue;
+    }
+    size = fread(data, 1, sizeof(data), f);
+    fclose(f);
+    replay_input(d->d_name, data, size);
+    inputs++;
+  }
+  closedir(dir);
+  HOST_CHECK(inputs > 0);
+  return inputs;
+}
+
+LOCAL void test_sleep(void) {
+  boot();
+  HOST_CHECK(app_fsm_state() == APP_AP_IDLE);
+
+  // Not quite yet
+  host_advance_ms(POWER_IDLE_SLEEP_S * 1000 - 100);
+  HOST_CHECK(app_fsm_state() == APP_AP_IDLE);
+  host_advance_ms(200);
+  HOST_CHECK(app_fsm_state() == APP_SLEEPING);
+  HOST_CHECK(host_max_tpw == POWER_SLEEP_TPW);
+  HOST_CHECK(!status_led_busy());
+  HOST_CHECK((host_gpio_out() & BIT2) == 0);
+
+  // Somebody looking for networks
+  probe();
+  HOST_CHECK(app_fsm_state() == APP_AP_IDLE);
+  HOST_CHECK(host_max_tpw == POWER_FULL_TPW);
+  probe();
+  HOST_CHECK(app_fsm_state() == APP_AP_IDLE);
+
+  // ... and didn't join: back to sleep
+  host_advance_ms(POWER_IDLE_SLEEP_S * 1000 + 100);
+  HOST_CHECK(app_fsm_state() == APP_SLEEPING);
+  HOST_CHECK(host_max_tpw == POWER_SLEEP_TPW);
+
+  // A client that knew we were here
+  station(EVENT_SOFTAPMODE_STACONNECTED, 1);
+  HOST_CHECK(app_fsm_state() == APP_SERVING);
+  HOST_CHECK(host_max_tpw == POWER_FULL_TPW);
+  HOST_CHECK(status_led_busy());
+
+  // Never while it's here
+  host_advance_ms(2 * POWER_IDLE_SLEEP_S * 1000);
+  HOST_CHECK(app_fsm_state() == APP_SERVING);
+
+  station(EVENT_SOFTAPMODE_STADISCONNECTED, 1);
+  HOST_CHECK(app_fsm_state() == APP_AP_IDLE);
+  host_advance_ms(POWER_IDLE_SLEEP_S * 1000 + 100);
+  HOST_CHECK(app_fsm_state() == APP_SLEEPING);
+
+  HOST_CHECK(power_stats.sleeps == 3 && power_stats.probe_wakes == 1);
+  HOST_CHECK(handler_stats.invariant_failures == 0);
+  HOST_CHECK(log_follows_table("sleep", 0));
+}
+
+LOCAL void test_recovery(void) {
+  uint32 waited = 0;
+  uint32 timers;
+
+  // The first three tries fail
+  host_reset();
+  host_softap_config_fails = 3;
+  stop_blinking();
+  coro_stop(&connect_coro);
+  softap_failed = false;
+  ap_started = false;
+  user_init();
+  host_run_tasks();
+  host_init_done_cb();
+  host_run_tasks();
+  checked_log = 0;
+
+  HOST_CHECK(app_fsm_state() == APP_DEGRADED);
+  HOST_CHECK(status_led_busy());
+  HOST_CHECK(!ap_started);
+
+  // Not sleeping while it's broken
+  while (app_fsm_state() == APP_DEGRADED && waited < 10 * RETRY_MS) {
+    host_advance_ms(1000);
+    waited += 1000;
+  }
+  HOST_CHECK(app_fsm_state() == APP_AP_IDLE);
+  HOST_CHECK(waited > 2 * RETRY_MS && waited <= 4 * RETRY_MS);
+  HOST_CHECK(host_softap_config.channel == SOFTAP_CHANNEL);
+  HOST_CHECK(!status_led_busy());
+  HOST_CHECK(ap_started);
+  HOST_CHECK(!softap_failed);
+  HOST_CHECK(log_follows_table("recovery", 0));
+
+  // The recovery started what the boot didn't, a second one starts nothing new
+  // (no more timers than before)
+  timers = host_timers_armed();
+  app_fsm_dispatch(APP_EV_FAULT);
+  HOST_CHECK(app_fsm_state() == APP_DEGRADED);
+  app_fsm_dispatch(APP_EV_RECOVERED);
+  HOST_CHECK(app_fsm_state() == APP_AP_IDLE);
+  HOST_CHECK(!status_led_busy());
+  HOST_CHECK(host_timers_armed() == timers);
+
+  // And it's back to counting down to sleep
+  host_advance_ms(POWER_IDLE_SLEEP_S * 1000 + 100);
+  HOST_CHECK(app_fsm_state() == APP_SLEEPING);
+}
+
+int main(void) {
+  uint32 inputs;
+
+  host_verbose = getenv("HOST_VERBOSE") != NULL;
+
+  test_trace();
+  inputs = test_corpus();
+  test_sleep();
+  test_recovery();
+
+  if (host_failures != 0) {
+    printf("app fsm replay test: %d checks failed\n", host_failures);
+    return 1;
+  }
+  printf("app fsm replay test: trace_two_clients and %u corpus inputs, all checks held\n", inputs);
+  return 0;
+}
@@ -0,0 +1,207 @@
+// The softAP lifecycle state machine (app_fsm.c) on the host.
+//
+// app_fsm.c is #included so the test sees the transition table and the log.
+// The actions are stubs that only note they ran (and burn a known number of
+// "cycles" on the fake CCOUNT), so a test can say exactly which action a
+// transition ran, and what the log should have recorded.
+//
+// Checks:
+//   - every table entry has an action and a next state that exists, and
+//     nothing goes back to BOOTING
+//   - the lifecycle: boot, clients coming and going, sleep and wake, a fault
+//     and the recovery, with the action each step should run
+//   - events that don't mean anything in a state change nothing, and events
+//     past APP_EVENT_COUNT are dropped without a log entry
+//   - the log: timestamps, from / event / to, the dispatch cost, and the ring
+//     wrapping after APP_FSM_LOG_SIZE entries
+// The table with the real actions and the events from the real sources (WiFi
+// traces, the power saving, the softAP retry) is app_fsm_replay_test.c.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "app_fsm.c"
+#include "sdk_stubs.h"
+
+#define ACTION_CYCLES   1000
+
+enum {
+  DID_NOTHING,
+  DID_AP_UP,
+  DID_CLIENT_JOINED,
+  DID_ALL_LEFT,
+  DID_DEGRADED,
+  DID_RECOVERED,
+  DID_SLEEP,
+  DID_WAKE
+};
+
+LOCAL uint32 action_calls;
+LOCAL uint8 last_action;
+
+LOCAL void ran(uint8 action) {
+  action_calls++;
+  last_action = action;
+  host_ccount += ACTION_CYCLES;
+}
+
+void app_action_ap_up(void) {
+  ran(DID_AP_UP);
+}
+
+void app_action_client_joined(void) {
+  ran(DID_CLIENT_JOINED);
+}
+
+void app_action_all_left(void) {
+  ran(DID_ALL_LEFT);
+}
+
+void app_action_degraded(void) {
+  ran(DID_DEGRADED);
+}
+
+void app_action_recovered(void) {
+  ran(DID_RECOVERED);
+}
+
+void app_action_sleep(void) {
+  ran(DID_SLEEP);
+}
+
+void app_action_wake(void) {
+  ran(DID_WAKE);
+}
+
+LOCAL void fresh(void) {
+  host_reset();
+  host_ccount_manual = true;
+  app_fsm_init();
+  action_calls = 0;
+  last_action = DID_NOTHING;
+}
+
+// Dispatch one event and check where it went and which action it ran
+// (DID_NOTHING for app_action_none)
+LOCAL void step(uint8 event, uint8 to, uint8 action) {
+  uint32 calls = action_calls;
+
+  last_action = DID_NOTHING;
+  app_fsm_dispatch(event);
+  if (app_fsm_state() != to || last_action != action) {
+    fprintf(stderr, "event %d: state %d action %d, expected state %d action %d\n",
+            event, app_fsm_state(), last_action, to, action);
+    host_failures++;
+  }
+  HOST_CHECK(action_calls - calls == (action == DID_NOTHING ? 0 : 1));
+}
+
+LOCAL void test_table(void) {
+  uint32 s, e;
+
+  for (s = 0; s < APP_STATE_COUNT; s++) {
+    for (e = 0; e < APP_EVENT_COUNT; e++) {
+      const struct transition *t = &transitions[s][e];
+
+      HOST_CHECK(t->action != NULL);
+      HOST_CHECK(t->next < APP_STATE_COUNT);
+      HOST_CHECK(t->next != APP_BOOTING || s == APP_BOOTING);
+    }
+  }
+  // A fault means DEGRADED from anywhere
+  for (s = 0; s < APP_STATE_COUNT; s++)
+    HOST_CHECK(transitions[s][APP_EV_FAULT].next == APP_DEGRADED);
+}
+
+LOCAL void test_lifecycle(void) {
+  fresh();
+  HOST_CHECK(app_fsm_state() == APP_BOOTING);
+
+  // Nothing happens before the SDK is done
+  step(APP_EV_STA_CONNECTED, APP_BOOTING, DID_NOTHING);
+  step(APP_EV_INIT_DONE, APP_AP_IDLE, DID_AP_UP);
+  step(APP_EV_INIT_DONE, APP_AP_IDLE, DID_NOTHING);
+
+  // Two clients, one leaves, then the other
+  step(APP_EV_STA_CONNECTED, APP_SERVING, DID_CLIENT_JOINED);
+  step(APP_EV_STA_CONNECTED, APP_SERVING, DID_CLIENT_JOINED);
+  step(APP_EV_STA_LEFT, APP_SERVING, DID_NOTHING);
+  step(APP_EV_SLEEP, APP_SERVING, DID_NOTHING);
+  step(APP_EV_NO_CLIENTS, APP_AP_IDLE, DID_ALL_LEFT);
+  step(APP_EV_NO_CLIENTS, APP_AP_IDLE, DID_NOTHING);
+
+  // Sleep, wake up on our own, sleep again and get woken by a client
+  step(APP_EV_SLEEP, APP_SLEEPING, DID_SLEEP);
+  step(APP_EV_SLEEP, APP_SLEEPING, DID_NOTHING);
+  step(APP_EV_WAKE, APP_AP_IDLE, DID_WAKE);
+  step(APP_EV_SLEEP, APP_SLEEPING, DID_SLEEP);
+  step(APP_EV_STA_CONNECTED, APP_SERVING, DID_CLIENT_JOINED);
+
+  // A fault, everything is ignored until the recovery
+  step(APP_EV_FAULT, APP_DEGRADED, DID_DEGRADED);
+  step(APP_EV_FAULT, APP_DEGRADED, DID_NOTHING);
+  step(APP_EV_STA_CONNECTED, APP_DEGRADED, DID_NOTHING);
+  step(APP_EV_WAKE, APP_DEGRADED, DID_NOTHING);
+  step(APP_EV_RECOVERED, APP_AP_IDLE, DID_RECOVERED);
+  step(APP_EV_RECOVERED, APP_AP_IDLE, DID_NOTHING);
+}
+
+LOCAL void test_unknown_events(void) {
+  uint32 logged;
+
+  fresh();
+  step(APP_EV_INIT_DONE, APP_AP_IDLE, DID_AP_UP);
+  logged = log_next;
+  step(APP_EVENT_COUNT, APP_AP_IDLE, DID_NOTHING);
+  step(0xff, APP_AP_IDLE, DID_NOTHING);
+  HOST_CHECK(log_next == logged);
+  HOST_CHECK(dispatches == 1);
+}
+
+LOCAL void test_log(void) {
+  uint32 i;
+
+  fresh();
+  host_time_us = 5000;
+  step(APP_EV_INIT_DONE, APP_AP_IDLE, DID_AP_UP);
+  host_time_us = 7000;
+  step(APP_EV_STA_LEFT, APP_AP_IDLE, DID_NOTHING);
+
+  HOST_CHECK(log_next == 2);
+  HOST_CHECK(fsm_log[0].time_us == 5000);
+  HOST_CHECK(fsm_log[0].from == APP_BOOTING);
+  HOST_CHECK(fsm_log[0].event == APP_EV_INIT_DONE);
+  HOST_CHECK(fsm_log[0].to == APP_AP_IDLE);
+  HOST_CHECK(fsm_log[0].cycles == ACTION_CYCLES);
+  HOST_CHECK(fsm_log[1].time_us == 7000);
+  HOST_CHECK(fsm_log[1].from == APP_AP_IDLE);
+  HOST_CHECK(fsm_log[1].to == APP_AP_IDLE);
+  HOST_CHECK(fsm_log[1].cycles == 0);
+  HOST_CHECK(dispatch_cycles_max == ACTION_CYCLES);
+
+  // Wrap the ring: the newest entry overwrites the oldest
+  for (i = 0; i < APP_FSM_LOG_SIZE; i++) {
+    host_time_us = 10000 + i;
+    app_fsm_dispatch(i % 2 == 0 ? APP_EV_STA_CONNECTED : APP_EV_NO_CLIENTS);
+  }
+  HOST_CHECK(dispatches == 2 + APP_FSM_LOG_SIZE);
+  HOST_CHECK(fsm_log[0].time_us == 10000 + APP_FSM_LOG_SIZE - 2);
+  HOST_CHECK(fsm_log[1].time_us == 10000 + APP_FSM_LOG_SIZE - 1);
+  HOST_CHECK(fsm_log[1].to == APP_AP_IDLE);
+
+  // The report walks the wrapped log (ASan is watching)
+  app_fsm_report();
+}
+
+int main(void) {
+  host_verbose = getenv("HOST_VERBOSE") != NULL;
+  test_table();
+  test_lifecycle();
+  test_unknown_events();
+  test_log();
+  if (host_failures != 0) {
+    printf("app fsm test: %d checks failed\n", host_failures);
+    return 1;
+  }
+  printf("app fsm test: all checks held\n");
+  return 0;
+}
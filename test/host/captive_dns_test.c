@@ -0,0 +1,305 @@
+// The captive portal DNS responder (captive_dns.c) on the host, against the
+// fake lwIP in lwip_stubs.c.
+//
+// captive_dns.c is #included for its stats. Every query is delivered in a pbuf
+// of exactly its size, so a parser that reads a byte too far trips ASan.
+//
+// Good queries:
+//   - an A query gets the question back with QR/AA, RD as asked, one answer
+//     pointing at the name (c0 0c) with our address and the TTL
+//   - an EDNS query has its OPT record left off the answer
+//   - AAAA gets no answer records
+//   - the biggest name that still fits CAPTIVE_DNS_MAX_LEN is answered
+// Bad ones, counted in bad and never answered:
+//   - a header cut short (every length below 12)
+//   - a question cut short (every length between the header and the end)
+//   - a compression pointer in the question
+//   - QDCOUNT 0, 2 and 256
+//   - an answer (QR set) and a non standard opcode
+//   - a label that runs past the end, and a name too long for our answer
+// And then:
+//   - with the driver holding every tx pbuf a query is dropped as busy, and
+//     answered again once they're let go (from the payload we allocated, not
+//     where udp_sendto left it)
+//   - a pile of random datagrams: nothing leaks, nothing reads out of bounds
+// And how many queries a second it answers: a burst of A queries through the
+// fake lwIP, timed with the PC's clock (the SDK time stands still here, so
+// peak_qps can't tell). Only good for comparing changes on the same PC, with
+// the sanitizers on (see the Makefile).
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "captive_dns.c"
+#include "sdk_stubs.h"
+#include "lwip_stubs.h"
+
+#define TYPE_AAAA       28
+#define TYPE_OPT        41
+#define QUERY_MAX       512
+#define RANDOM_QUERIES  20000
+#define BURST_QUERIES   200000
+
+LOCAL uint8 query[QUERY_MAX];
+
+// A query for name (dotted) of the given type, with an EDNS OPT record after
+// the question if edns. Returns its length.
+LOCAL uint16 make_query(const char *name, uint16 type, bool edns) {
+  uint16 pos = HEADER_LEN;
+  const char *label = name;
+
+  os_bzero(query, sizeof(query));
+  query[0] = 0x12;                  // id
+  query[1] = 0x34;
+  query[2] = 0x01;                  // RD
+  query[5] = 1;                     // one question
+  query[11] = edns ? 1 : 0;         // additional
+
+  while (*label != 0) {
+    const char *dot = strchr(label, '.');
+    uint16 n = dot != NULL ? dot - label : strlen(label);
+
+    query[pos++] = n;
+    os_memcpy(&query[pos], label, n);
+    pos += n;
+    label += n + (dot != NULL ? 1 : 0);
+  }
+  query[pos++] = 0;
+  query[pos++] = type >> 8;
+  query[pos++] = type & 0xff;
+  query[pos++] = 0;
+  query[pos++] = CLASS_IN;
+
+  if (edns) {
+    query[pos++] = 0;               // root name
+    query[pos++] = 0;
+    query[pos++] = TYPE_OPT;
+    query[pos++] = 0x10;            // 4096 byte UDP payload
+    query[pos++] = 0;
+    pos += 4;                       // extended rcode, version, flags
+    pos += 2;                       // no options
+  }
+  return pos;
+}
+
+LOCAL void deliver(uint16 len) {
+  HOST_CHECK(host_udp_deliver(CAPTIVE_DNS_PORT, query, len));
+  HOST_CHECK(host_pbufs == CAPTIVE_DNS_TX_PBUFS);
+}
+
+// Deliver and check it's answered with the question (qlen bytes of it) and, if
+// a, the A record
+LOCAL void expect_answer(uint16 len, uint16 qlen, bool a, const char *what) {
+  uint32 sends = host_udp_sends;
+  static const uint8 rr[ANSWER_LEN] = { 0xc0, 0x0c, 0, TYPE_A, 0, CLASS_IN, 0, 0, 0, CAPTIVE_DNS_TTL,
+                                        0, 4, 192, 168, 4, 1 };
+
+  deliver(len);
+  if (host_udp_sends != sends + 1) {
+    fprintf(stderr, "%s: not answered\n", what);
+    host_failures++;
+    return;
+  }
+  HOST_CHECK(host_udp_sent_len == qlen + (a ? ANSWER_LEN : 0));
+  HOST_CHECK(host_udp_sent[0] == query[0] && host_udp_sent[1] == query[1]);
+  HOST_CHECK(host_udp_sent[2] == (0x84 | (query[2] & 0x01)));
+  HOST_CHECK(host_udp_sent[3] == 0);
+  HOST_CHECK(host_udp_sent[4] == 0 && host_udp_sent[5] == 1);
+  HOST_CHECK(host_udp_sent[6] == 0 && host_udp_sent[7] == (a ? 1 : 0));
+  HOST_CHECK(memcmp(&host_udp_sent[8], "\0\0\0\0", 4) == 0);
+  HOST_CHECK(memcmp(&host_udp_sent[HEADER_LEN], &query[HEADER_LEN], qlen - HEADER_LEN) == 0);
+  if (a)
+    HOST_CHECK(memcmp(&host_udp_sent[qlen], rr, ANSWER_LEN) == 0);
+}
+
+LOCAL void expect_bad(uint16 len, const char *what) {
+  uint32 sends = host_udp_sends;
+  uint32 bad = dns_stats.bad;
+
+  deliver(len);
+  if (host_udp_sends != sends || dns_stats.bad != bad + 1) {
+    fprintf(stderr, "%s: not refused\n", what);
+    host_failures++;
+  }
+}
+
+// A name of exactly n bytes on the wire (labels of up to 63, and the 0)
+LOCAL const char *name_of_length(uint16 n) {
+  static char name[300];
+  uint16 left = n - 1, pos = 0;
+
+  while (left > 0) {
+    uint16 label = left - 1 > 63 ? 63 : left - 1;
+
+    if (left - (label + 1) == 1)    // don't leave a single byte, it can't be a label
+      label--;
+    os_memset(&name[pos], 'a', label);
+    pos += label;
+    left -= label + 1;
+    name[pos++] = left > 0 ? '.' : 0;
+  }
+  name[pos] = 0;
+  return name;
+}
+
+LOCAL void test_good(void) {
+  uint16 len, qlen;
+
+  len = make_query("connectivitycheck.gstatic.com", TYPE_A, false);
+  expect_answer(len, len, true, "A query");
+
+  query[2] = 0;                     // no RD, none in the answer
+  expect_answer(len, len, true, "A query without RD");
+
+  len = make_query("captive.apple.com", TYPE_ANY, false);
+  expect_answer(len, len, true, "ANY query");
+
+  len = make_query("captive.apple.com", TYPE_A, true);
+  qlen = len - 11;
+  expect_answer(len, qlen, true, "EDNS query");
+
+  len = make_query("connectivitycheck.gstatic.com", TYPE_AAAA, false);
+  expect_answer(len, len, false, "AAAA query");
+
+  len = make_query("", TYPE_A, false);
+  expect_answer(len, len, true, "root");
+
+  // The answer is exactly CAPTIVE_DNS_MAX_LEN
+  len = make_query(name_of_length(CAPTIVE_DNS_MAX_LEN - ANSWER_LEN - HEADER_LEN - 4), TYPE_A, false);
+  HOST_CHECK(len + ANSWER_LEN == CAPTIVE_DNS_MAX_LEN);
+  expect_answer(len, len, true, "longest name");
+}
+
+LOCAL void test_bad(void) {
+  uint16 len, i;
+
+  len = make_query("connectivitycheck.gstatic.com", TYPE_A, false);
+  for (i = 0; i < len; i++)
+    expect_bad(i, i < HEADER_LEN ? "short header" : "short question");
+
+  // A pointer instead of the second label
+  make_query("www.example.com", TYPE_A, false);
+  query[HEADER_LEN + 4] = 0xc0;
+  query[HEADER_LEN + 5] = 0x0c;
+  expect_bad(len, "compression pointer");
+  query[HEADER_LEN] = 0xc0;
+  query[HEADER_LEN + 1] = 0x0c;
+  expect_bad(len, "compression pointer first");
+
+  len = make_query("www.example.com", TYPE_A, false);
+  query[5] = 0;
+  expect_bad(len, "QDCOUNT 0");
+  query[5] = 2;
+  expect_bad(len, "QDCOUNT 2");
+  query[4] = 1;
+  query[5] = 0;
+  expect_bad(len, "QDCOUNT 256");
+
+  len = make_query("www.example.com", TYPE_A, false);
+  query[2] |= 0x80;
+  expect_bad(len, "an answer");
+  query[2] = 0x10;                  // opcode 2 (status)
+  expect_bad(len, "opcode 2");
+
+  // The first label says 63 bytes, the datagram ends long before
+  len = make_query("www.example.com", TYPE_A, false);
+  query[HEADER_LEN] = 63;
+  expect_bad(len, "label past the end");
+
+  // One byte more than fits
+  len = make_query(name_of_length(CAPTIVE_DNS_MAX_LEN - ANSWER_LEN - HEADER_LEN - 4 + 1), TYPE_A, false);
+  expect_bad(len, "name too long");
+  len = make_query(name_of_length(255), TYPE_A, false);
+  expect_bad(len, "255 byte name");
+}
+
+LOCAL void test_busy(void) {
+  uint16 len = make_query("example.com", TYPE_A, false);
+  uint32 i, busy = dns_stats.busy;
+
+  host_udp_hold = true;
+  for (i = 0; i < CAPTIVE_DNS_TX_PBUFS; i++)
+    expect_answer(len, len, true, "while the driver holds pbufs");
+  host_udp_hold = false;
+
+  HOST_CHECK(host_udp_deliver(CAPTIVE_DNS_PORT, query, len));
+  HOST_CHECK(dns_stats.busy == busy + 1);
+
+  host_udp_release_held();
+  HOST_CHECK(host_pbufs == CAPTIVE_DNS_TX_PBUFS);
+  for (i = 0; i < 2 * CAPTIVE_DNS_TX_PBUFS; i++)
+    expect_answer(len, len, true, "after the driver let go");
+}
+
+LOCAL void test_random(void) {
+  uint32 state = 0x6b8b4567;
+  uint32 i, j;
+
+  for (i = 0; i < RANDOM_QUERIES; i++) {
+    uint16 len;
+
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    len = state % 300;
+    // Half of them start out as a real query, so they get past the header checks
+    if (i & 1)
+      make_query("a.bb.ccc", TYPE_A, false);
+    for (j = (i & 1) ? HEADER_LEN : 0; j < len; j++) {
+      state ^= state << 13;
+      state ^= state >> 17;
+      state ^= state << 5;
+      query[j] = (state & 7) == 0 ? 0 : state >> 8;
+    }
+    deliver(len);
+  }
+}
+
+LOCAL double now_s(void) {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Answered queries per second
+LOCAL double test_burst(void) {
+  uint16 len = make_query("connectivitycheck.gstatic.com", TYPE_A, false);
+  uint32 i, answers = dns_stats.answers;
+  double start, seconds;
+
+  start = now_s();
+  for (i = 0; i < BURST_QUERIES; i++)
+    host_udp_deliver(CAPTIVE_DNS_PORT, query, len);
+  seconds = now_s() - start;
+
+  HOST_CHECK(dns_stats.answers == answers + BURST_QUERIES);
+  HOST_CHECK(host_pbufs == CAPTIVE_DNS_TX_PBUFS);
+  return BURST_QUERIES / seconds;
+}
+
+int main(void) {
+  double qps;
+
+  host_verbose = getenv("HOST_VERBOSE") != NULL;
+  host_reset();
+  host_lwip_reset();
+  HOST_CHECK(captive_dns_start());
+  HOST_CHECK(host_pbufs == CAPTIVE_DNS_TX_PBUFS);
+
+  test_good();
+  test_bad();
+  test_busy();
+  test_random();
+  qps = test_burst();
+  captive_dns_report();
+
+  if (host_failures != 0) {
+    printf("captive dns test: %d checks failed\n", host_failures);
+    return 1;
+  }
+  printf("captive dns test: %u queries, %u answered, %u bad, %.0f queries/s, all checks held\n",
+         dns_stats.queries, dns_stats.answers, dns_stats.bad, qps);
+  return 0;
+}
@@ -0,0 +1,182 @@
+// Coroutine events (coro.c) on the host, with the real task layer under them.
+//
+// The one that matters is the race in the connect sequence (user_main.c): the
+// coroutine plays the hello pattern with CORO_AWAIT_TIMER(600) and only then
+// waits for the DHCP event. A client that asks for its address during the
+// pattern used to have its signal dropped, and the LED waited the whole 5
+// seconds for nothing. Now the signal is latched in pending and the wait
+// returns straight away.
+//
+// Also: the plain wake up and timeout, a signal before the coroutine even ran,
+// a pending event is taken once only, other events don't wake a wait but stay
+// pending, and coro_start forgets what was pending.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "ets_sys.h"
+#include "osapi.h"
+#include "coro.h"
+#include "tasks.h"
+#include "sdk_stubs.h"
+
+#define EV_DHCP     BIT0
+#define EV_OTHER    BIT1
+
+LOCAL struct coro test_coro;
+LOCAL uint32 done_ms;         // when the wait came back (0 = not yet)
+LOCAL uint8 woken_by;         // and with what
+LOCAL uint32 second_ms;       // same for the second wait (sequence_twice)
+LOCAL uint8 second_woken_by;
+
+LOCAL uint32 now_ms(void) {
+  return host_time_us / 1000;
+}
+
+// The connect sequence: hello pattern, then the DHCP event or 5 seconds
+LOCAL uint8 sequence(struct coro *c) {
+  CORO_BEGIN(c);
+  CORO_AWAIT_TIMER(c, 600);
+  CORO_WAIT(c, EV_DHCP, 5000);
+  done_ms = now_ms();
+  woken_by = c->events;
+  CORO_END(c);
+}
+
+// The same, then a second wait for the same event
+LOCAL uint8 sequence_twice(struct coro *c) {
+  CORO_BEGIN(c);
+  CORO_AWAIT_TIMER(c, 600);
+  CORO_WAIT(c, EV_DHCP, 5000);
+  done_ms = now_ms();
+  woken_by = c->events;
+  CORO_WAIT(c, EV_DHCP, 1000);
+  second_ms = now_ms();
+  second_woken_by = c->events;
+  CORO_END(c);
+}
+
+// Straight to the wait
+LOCAL uint8 wait_only(struct coro *c) {
+  CORO_BEGIN(c);
+  CORO_WAIT(c, EV_DHCP, 5000);
+  done_ms = now_ms();
+  woken_by = c->events;
+  CORO_END(c);
+}
+
+LOCAL void fresh(void) {
+  coro_stop(&test_coro);
+  host_reset();
+  task_init();
+  coro_init();
+  done_ms = 0;
+  woken_by = 0xff;
+  second_ms = 0;
+  second_woken_by = 0xff;
+  host_time_us = 1000000;
+}
+
+LOCAL void start(coro_fn_t fn) {
+  HOST_CHECK(coro_start(&test_coro, fn));
+  host_run_tasks();
+}
+
+// Check the wait came back at at_ms (from the start) with events
+LOCAL void expect(const char *what, uint32 at_ms, uint8 events) {
+  if (done_ms != 1000 + at_ms || woken_by != events) {
+    fprintf(stderr, "%s: woken at %d ms by 0x%02x, expected %u ms by 0x%02x\n",
+            what, done_ms != 0 ? (int)done_ms - 1000 : -1, woken_by, at_ms, events);
+    host_failures++;
+  }
+}
+
+LOCAL void test_signal_during_timer(void) {
+  fresh();
+  start(sequence);
+  host_advance_ms(300);
+  coro_signal(EV_DHCP);
+  host_advance_ms(400);
+  expect("signal during the timer", 600, EV_DHCP);
+  HOST_CHECK(!coro_running(&test_coro));
+  HOST_CHECK(test_coro.pending == 0);
+  HOST_CHECK(host_timers_armed() == 0);
+}
+
+LOCAL void test_signal_while_waiting(void) {
+  fresh();
+  start(sequence);
+  host_advance_ms(1000);
+  coro_signal(EV_DHCP);
+  host_run_tasks();
+  expect("signal during the wait", 1000, EV_DHCP);
+  HOST_CHECK(test_coro.pending == 0);
+}
+
+LOCAL void test_timeout(void) {
+  fresh();
+  start(sequence);
+  host_advance_ms(10000);
+  expect("no signal", 5600, 0);
+}
+
+// Posted, not run yet
+LOCAL void test_signal_before_running(void) {
+  fresh();
+  HOST_CHECK(coro_start(&test_coro, wait_only));
+  coro_signal(EV_DHCP);
+  host_run_tasks();
+  expect("signal before the first run", 0, EV_DHCP);
+}
+
+// One signal, one wait: the second wait has to time out
+LOCAL void test_taken_once(void) {
+  fresh();
+  start(sequence_twice);
+  host_advance_ms(300);
+  coro_signal(EV_DHCP);
+  host_advance_ms(2000);
+  expect("first wait", 600, EV_DHCP);
+  HOST_CHECK(second_ms == 1000 + 1600 && second_woken_by == 0);
+}
+
+LOCAL void test_other_events(void) {
+  fresh();
+  start(sequence);
+  host_advance_ms(700);
+  coro_signal(EV_OTHER);
+  host_run_tasks();
+  HOST_CHECK(done_ms == 0);
+  HOST_CHECK(test_coro.pending == EV_OTHER);
+  coro_signal(EV_DHCP | EV_OTHER);
+  host_run_tasks();
+  expect("two events at once", 700, EV_DHCP);
+  HOST_CHECK(test_coro.pending == EV_OTHER);
+}
+
+LOCAL void test_restart_forgets(void) {
+  fresh();
+  start(sequence);
+  host_advance_ms(300);
+  coro_signal(EV_DHCP);
+  start(sequence);                 // starting over: that signal was for the old run
+  HOST_CHECK(test_coro.pending == 0);
+  host_advance_ms(10000);
+  expect("restarted", 300 + 5600, 0);
+}
+
+int main(void) {
+  host_verbose = getenv("HOST_VERBOSE") != NULL;
+  test_signal_during_timer();
+  test_signal_while_waiting();
+  test_timeout();
+  test_signal_before_running();
+  test_taken_once();
+  test_other_events();
+  test_restart_forgets();
+  if (host_failures != 0) {
+    printf("coro test: %d checks failed\n", host_failures);
+    return 1;
+  }
+  printf("coro test: all checks held\n");
+  return 0;
+}
@@ -0,0 +1,171 @@
+// The UDP control service (ctrl_udp.c) on the host, against the fake lwIP in
+// lwip_stubs.c and the real softap_tune.c.
+//
+// ctrl_udp.c is #included for its stats and path_report, and mac_filter.c (built
+// in here) for its stats. Requests are delivered in a pbuf of exactly their
+// size, so the parser reading a byte too far trips ASan.
+//
+// Checks:
+//   - ping and an unknown command get their answer
+//   - ap with good numbers changes the softAP, and with numbers too big for 32
+//     bits it's the usage message and the softAP stays as it was (those used to
+//     wrap around to something small enough to pass)
+//   - path_report never writes past the size it's given, not even with every
+//     counter at its maximum, and returns what it wrote
+//   - bench with every counter at its maximum still fits one reply
+//   - mac gives the filter's answer (from the list and from the cache) without
+//     counting a lookup or filling the cache
+//   - with the driver holding both tx slots a request is dropped, and answered
+//     again once they're let go
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define FEATURE_MAC_FILTER 1
+
+#include "ctrl_udp.c"
+#include "mac_filter.c"
+#include "sdk_stubs.h"
+#include "lwip_stubs.h"
+
+// Send one request, return the reply (0 terminated) or NULL if there wasn't one
+LOCAL const char *request(const char *req) {
+  static char reply[HOST_UDP_SENT_MAX + 1];
+  uint32 sends = host_udp_sends;
+
+  HOST_CHECK(host_udp_deliver(CTRL_UDP_PORT, (const uint8 *)req, strlen(req)));
+  if (host_udp_sends == sends)
+    return NULL;
+  HOST_CHECK(host_udp_sent_len < CTRL_UDP_MAX_REPLY);
+  os_memcpy(reply, host_udp_sent, host_udp_sent_len);
+  reply[host_udp_sent_len] = 0;
+  return reply;
+}
+
+LOCAL void expect(const char *req, const char *answer) {
+  const char *reply = request(req);
+
+  if (reply == NULL || strcmp(reply, answer) != 0) {
+    fprintf(stderr, "\"%s\": got \"%s\", expected \"%s\"\n", req, reply != NULL ? reply : "(nothing)", answer);
+    host_failures++;
+  }
+}
+
+LOCAL void test_commands(void) {
+  expect("ping", "pong\n");
+  expect("ping\n", "pong\n");
+  expect("pingpong", "commands: ping stats ap mac bench\n");
+  expect("", "commands: ping stats ap mac bench\n");
+}
+
+LOCAL void test_ap(void) {
+  static const char usage[] = "usage: ap <clients> <beacon ms> <channel> <hidden>\n";
+
+  expect("ap 4 200 6 0", "ok\n");
+  HOST_CHECK(host_softap_config.max_connection == 4);
+  HOST_CHECK(host_softap_config.beacon_interval == 200);
+  HOST_CHECK(host_softap_config.channel == 6);
+
+  // 2^32 + 1 and 2^32 + 100 would wrap around to 1 and 100
+  expect("ap 4294967297 100 1 0", usage);
+  expect("ap 2 4294967396 1 0", usage);
+  expect("ap 99999999999 100 1 0", usage);
+  expect("ap 2 100 1 42949672960", usage);
+  HOST_CHECK(host_softap_config.max_connection == 4);
+  HOST_CHECK(host_softap_config.beacon_interval == 200);
+  HOST_CHECK(host_softap_config.channel == 6);
+
+  // The largest that fits is a number, just not one we take
+  expect("ap 4294967295 100 1 0", "rejected\n");
+  expect("ap 256 100 1 0", "rejected\n");
+  expect("ap 2 100", usage);
+}
+
+LOCAL void test_path_report(void) {
+  static const uint16 sizes[] = { 1, 2, 16, 40, 100, CTRL_UDP_MAX_REPLY };
+  struct path_stats s;
+  char buffer[CTRL_UDP_MAX_REPLY + 16];
+  uint32 i;
+
+  os_memset(&s, 0xff, sizeof(s));
+  for (i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+    uint16 n;
+
+    os_memset(buffer, 'x', sizeof(buffer));
+    n = path_report(buffer, sizes[i], "espconn", &s);
+    HOST_CHECK(n < sizes[i]);
+    HOST_CHECK(buffer[n] == 0 && strlen(buffer) == n);
+    HOST_CHECK(buffer[sizes[i]] == 'x');
+  }
+}
+
+LOCAL void test_bench(void) {
+  const char *reply;
+
+  os_memset(&raw_stats, 0xff, sizeof(raw_stats));
+  reply = request("bench");
+  HOST_CHECK(reply != NULL && strncmp(reply, "raw: 4294967295 requests", 24) == 0);
+  os_bzero(&raw_stats, sizeof(raw_stats));
+}
+
+LOCAL void test_mac(void) {
+  static const uint8 listed[6] = { 0x3c, 0x28, 0x6d, 0x11, 0x22, 0x33 };
+  static const uint8 unlisted[6] = { 0x02, 0x00, 0x00, 0x00, 0x00, 0x01 };
+  struct cache_entry empty[2][MAC_FILTER_CACHE_SLOTS];
+
+  HOST_CHECK(mac_filter_init());
+  os_bzero(empty, sizeof(empty));
+
+  expect("mac 3c:28:6d:11:22:33", "allowed\n");
+  expect("mac 02:00:00:00:00:01", "refused\n");
+  expect("mac 3c:28:6d:11:22", "usage: mac aa:bb:cc:dd:ee:ff\n");
+  HOST_CHECK(filter_stats.lookups == 0 && filter_stats.refused == 0);
+  HOST_CHECK(memcmp(cache, empty, sizeof(cache)) == 0);
+
+  // Once the stations really came by, the answer comes from the cache
+  HOST_CHECK(mac_filter_allowed(listed));
+  HOST_CHECK(!mac_filter_allowed(unlisted));
+  expect("mac 3c:28:6d:11:22:33", "allowed\n");
+  expect("mac 02:00:00:00:00:01", "refused\n");
+  HOST_CHECK(filter_stats.lookups == 2 && filter_stats.cache_hits == 0 && filter_stats.refused == 1);
+}
+
+LOCAL void test_busy(void) {
+  uint32 i, dropped = raw_stats.dropped;
+
+  host_udp_hold = true;
+  for (i = 0; i < CTRL_UDP_TX_SLOTS; i++)
+    expect("ping", "pong\n");
+  host_udp_hold = false;
+
+  HOST_CHECK(request("ping") == NULL);
+  HOST_CHECK(raw_stats.dropped == dropped + 1);
+
+  host_udp_release_held();
+  for (i = 0; i < 2 * CTRL_UDP_TX_SLOTS; i++)
+    expect("ping", "pong\n");
+}
+
+int main(void) {
+  host_verbose = getenv("HOST_VERBOSE") != NULL;
+  host_reset();
+  host_lwip_reset();
+  HOST_CHECK(ctrl_udp_start());
+  HOST_CHECK(host_pbufs == CTRL_UDP_TX_SLOTS);
+
+  test_commands();
+  test_ap();
+  test_path_report();
+  test_bench();
+  test_mac();
+  test_busy();
+  ctrl_udp_report();
+
+  if (host_failures != 0) {
+    printf("ctrl udp test: %d checks failed\n", host_failures);
+    return 1;
+  }
+  printf("ctrl udp test: %u requests, all checks held\n", raw_stats.requests);
+  return 0;
+}
@@ -0,0 +1,242 @@
+// Host replayer for WiFi event traces (make replay, and make host-test).
+//
+// The firmware is user_main.c and the core modules with the default features of
+// user_config.h, the same build as the fuzz target, booted fresh for every
+// trace. The records of a trace are turned back into SDK events by the
+// firmware's own record_to_event (event_trace.c) and handed to the callback the
+// firmware registered with wifi_set_event_handler_cb, the gaps between them run
+// on the fake clock (timers and tasks fire in between like on a unit), as
+// recorded or -s times faster.
+//
+// A trace is either one of event_traces.h (no files on the command line) or the
+// "trace:" lines of a UART log (any file on the command line, everything else
+// in it is skipped). That's what a unit prints with EVENT_TRACE_RECORD: one
+// line per event, the 16 bytes of the record in hex (see event_trace.h), not a
+// binary format.
+//
+// For every event it prints the time, the event, the state machine state after
+// it and how long the handler took (real time on the PC in ns, a PC is a lot
+// faster than the lx106, through the event bus so every subscriber), and in
+// between every change of the status LED on GPIO2. Two firmware versions
+// replaying the same trace can be compared line by line (the handler times will
+// differ from run to run, the rest shouldn't).
+// At the end of a trace, after SETTLE_MS more: the handler average and worst
+// case, the per subscriber numbers of the event bus and a summary line.
+//
+//   -s n  replay n times faster than recorded (1 = as recorded)
+//   -q    summary lines only
+//
+// It fails (exit 1) if the handler's own checks failed, or if the status LED is
+// busy without clients (or idle with them) when the trace is over.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "user_main.c"
+#include "event_trace.c"
+#include "sdk_stubs.h"
+
+#define SETTLE_MS       10000
+#define TRACE_MAX       4096
+#define LINE_MAX        256
+
+LOCAL struct event_trace_record trace[TRACE_MAX];
+LOCAL bool quiet;
+LOCAL uint32 trace_start_us;
+LOCAL uint32 led_changes;
+LOCAL bool led_on;
+
+// The clock since the trace started, in ms
+LOCAL uint32 replay_ms(void) {
+  return (host_time_us - trace_start_us) / 1000;
+}
+
+LOCAL void led_changed(uint32 out) {
+  bool on = (out & BIT2) != 0;
+
+  if (on == led_on)
+    return;
+  led_on = on;
+  led_changes++;
+  if (!quiet)
+    printf("%7u ms  led %s\n", replay_ms(), on ? "on" : "off");
+}
+
+// Power on: user_init, then the SDK's init done callback (like the fuzz target)
+LOCAL void boot(void) {
+  stop_blinking();
+  coro_stop(&connect_coro);
+
+  host_reset();
+  client_aids = 0;
+  clients = 0;
+  refused_aids = 0;
+  os_bzero(&handler_stats, sizeof(handler_stats));
+  heap_min = 0;
+  softap_failed = false;
+  ap_started = false;
+
+  user_init();
+  host_run_tasks();
+  host_init_done_cb();
+  host_run_tasks();
+}
+
+// Play one trace, returns false if a check failed
+LOCAL bool replay(const char *name, const struct event_trace_record *records, uint32 count, uint32 speed) {
+  uint32 mhz, cycles, cycles_sum = 0, cycles_max = 0;
+  uint32 i;
+  bool ok = true;
+
+  boot();
+  mhz = system_get_cpu_freq();
+  if (host_event_cb == NULL) {
+    fprintf(stderr, "replay %s: the firmware didn't register an event handler\n", name);
+    return false;
+  }
+
+  led_on = (host_gpio_out() & BIT2) != 0;
+  led_changes = 0;
+  host_gpio_changed = led_changed;
+  trace_start_us = host_time_us;
+  if (!quiet)
+    printf("replay %s: %u events at %ux\n", name, count, speed);
+
+  for (i = 0; i < count; i++) {
+    const struct event_trace_record *r = &records[i];
+    System_Event_t event;
+    uint32 start;
+
+    if (i > 0)
+      host_advance_ms((r->time_ms - records[i - 1].time_ms) / speed);
+    record_to_event(r, &event);
+
+    start = get_ccount();
+    host_event_cb(&event);
+    cycles = get_ccount() - start;
+    host_run_tasks();
+
+    cycles_sum += cycles;
+    if (cycles > cycles_max)
+      cycles_max = cycles;
+    if (!quiet)
+      printf("%7u ms  event %u aid %u (record %u at %u ms) -> state %u, %u clients, %u ns\n",
+             replay_ms(), r->event, r->aid, r->seq, r->time_ms, app_fsm_state(), clients,
+             (uint32)((uint64)cycles * 1000 / mhz));
+  }
+  host_advance_ms(SETTLE_MS);
+
+  if (handler_stats.invariant_failures != 0) {
+    fprintf(stderr, "replay %s: the handler's invariant check failed %u times\n", name,
+            handler_stats.invariant_failures);
+    ok = false;
+  }
+  if ((clients > 0) != status_led_busy()) {
+    fprintf(stderr, "replay %s: %u clients but the status LED is %s\n", name, clients,
+            status_led_busy() ? "busy" : "idle");
+    ok = false;
+  }
+
+  if (!quiet) {
+    host_verbose = true;
+    event_bus_report();
+    host_verbose = getenv("HOST_VERBOSE") != NULL;
+  }
+  printf("replay %s: %u events at %ux, handler avg %u ns, max %u ns, %u led changes, state %u, %u clients%s\n",
+         name, count, speed, count ? (uint32)((uint64)cycles_sum / count * 1000 / mhz) : 0,
+         (uint32)((uint64)cycles_max * 1000 / mhz), led_changes, app_fsm_state(), clients, ok ? "" : ", FAILED");
+  host_gpio_changed = NULL;
+  return ok;
+}
+
+// The record back from the bytes of a "trace:" line (the reverse of
+// record_to_bytes)
+LOCAL void record_from_bytes(const uint8 *b, struct event_trace_record *r) {
+  r->time_ms = b[0] | (b[1] << 8) | (b[2] << 16) | ((uint32)b[3] << 24);
+  r->event = b[4];
+  r->aid = b[5];
+  r->rssi = (sint8)b[6];
+  r->ip = b[7];
+  os_memcpy(r->mac, &b[8], 6);
+  r->seq = b[14] | (b[15] << 8);
+}
+
+// The "trace:" lines of a UART log into trace[], returns how many (-1 if the file
+// can't be read). A line that's cut short or garbled is skipped and said so, the
+// seq numbers show what's missing.
+LOCAL sint32 read_log(const char *path) {
+  char line[LINE_MAX];
+  uint32 count = 0, number = 0;
+  FILE *f = fopen(path, "r");
+
+  if (f == NULL) {
+    perror(path);
+    return -1;
+  }
+  while (fgets(line, sizeof(line), f) != NULL) {
+    const char *hex = strstr(line, "trace: ");
+    uint8 bytes[RECORD_BYTES];
+    uint32 i;
+
+    number++;
+    if (hex == NULL)
+      continue;
+    hex += 7;
+    for (i = 0; i < RECORD_BYTES; i++) {
+      unsigned int byte;
+
+      if (sscanf(hex + i * 2, "%2x", &byte) != 1)
+        break;
+      bytes[i] = byte;
+    }
+    if (i < RECORD_BYTES || count == TRACE_MAX) {
+      fprintf(stderr, "%s:%u: %s, skipped\n", path, number, i < RECORD_BYTES ? "bad trace line" : "too many records");
+      continue;
+    }
+    record_from_bytes(bytes, &trace[count++]);
+  }
+  fclose(f);
+  return count;
+}
+
+int main(int argc, char **argv) {
+  uint32 speed = 1;
+  bool ok = true;
+  int i, files = 0;
+
+  host_verbose = getenv("HOST_VERBOSE") != NULL;
+  for (i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "-q") == 0) {
+      quiet = true;
+    } else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc) {
+      speed = strtoul(argv[++i], NULL, 10);
+      if (speed == 0)
+        speed = 1;
+    } else if (argv[i][0] == '-') {
+      fprintf(stderr, "usage: %s [-q] [-s speed] [uart log ...]\n", argv[0]);
+      return 2;
+    }
+  }
+
+  for (i = 1; i < argc; i++) {
+    sint32 count;
+
+    if (argv[i][0] == '-') {
+      if (strcmp(argv[i], "-s") == 0)
+        i++;
+      continue;
+    }
+    files++;
+    count = read_log(argv[i]);
+    if (count < 0)
+      return 1;
+    ok &= replay(argv[i], trace, count, speed);
+  }
+
+  // Nothing on the command line: the traces in event_traces.h
+  if (files == 0)
+    ok &= replay("trace_two_clients", trace_two_clients,
+                 sizeof(trace_two_clients) / sizeof(trace_two_clients[0]), speed);
+
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,34 @@
+// Host stand-in for the SDK's c_types.h (see test/host/sdk_stubs.h). Same type
+// names, and the attributes that put things in flash or IRAM do nothing.
+
+#ifndef _C_TYPES_H_
+#define _C_TYPES_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+typedef uint8_t uint8;
+typedef int8_t sint8;
+typedef uint16_t uint16;
+typedef int16_t sint16;
+typedef uint32_t uint32;
+typedef int32_t sint32;
+typedef uint64_t uint64;
+typedef int64_t sint64;
+
+typedef uint8_t u8;
+typedef uint16_t u16;
+typedef uint32_t u32;
+
+#define LOCAL                 static
+
+// 32 bits like on the lx106, not an unsigned long
+#define BIT(nr)               ((uint32)1 << (nr))
+
+#define ICACHE_FLASH_ATTR
+#define ICACHE_RODATA_ATTR
+#define ICACHE_RAM_ATTR
+#define STORE_ATTR            __attribute__((aligned(4)))
+
+#endif
@@ -0,0 +1,7 @@
+// Host stand-in for the SDK's espconn.h. Empty: the host tests build without
+// CTRL_UDP_ESPCONN_BENCH, so nothing of espconn gets used.
+
+#ifndef __ESPCONN_H__
+#define __ESPCONN_H__
+
+#endif
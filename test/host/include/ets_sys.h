@@ -0,0 +1,85 @@
+// Host stand-in for the SDK's ets_sys.h (and the bits of eagle_soc.h it pulls
+// in). The GPIO registers are an array in sdk_stubs.c, the pin mux does nothing.
+
+#ifndef _ETS_SYS_H
+#define _ETS_SYS_H
+
+#include "c_types.h"
+
+#define BIT31   0x80000000
+#define BIT30   0x40000000
+#define BIT29   0x20000000
+#define BIT28   0x10000000
+#define BIT27   0x08000000
+#define BIT26   0x04000000
+#define BIT25   0x02000000
+#define BIT24   0x01000000
+#define BIT23   0x00800000
+#define BIT22   0x00400000
+#define BIT21   0x00200000
+#define BIT20   0x00100000
+#define BIT19   0x00080000
+#define BIT18   0x00040000
+#define BIT17   0x00020000
+#define BIT16   0x00010000
+#define BIT15   0x00008000
+#define BIT14   0x00004000
+#define BIT13   0x00002000
+#define BIT12   0x00001000
+#define BIT11   0x00000800
+#define BIT10   0x00000400
+#define BIT9    0x00000200
+#define BIT8    0x00000100
+#define BIT7    0x00000080
+#define BIT6    0x00000040
+#define BIT5    0x00000020
+#define BIT4    0x00000010
+#define BIT3    0x00000008
+#define BIT2    0x00000004
+#define BIT1    0x00000002
+#define BIT0    0x00000001
+
+// GPIO registers (offsets, like PERIPHS_GPIO_BASEADDR + ...)
+#define GPIO_OUT_ADDRESS              0x00
+#define GPIO_OUT_W1TS_ADDRESS         0x04
+#define GPIO_OUT_W1TC_ADDRESS         0x08
+#define GPIO_ENABLE_ADDRESS           0x0c
+#define GPIO_ENABLE_W1TS_ADDRESS      0x10
+#define GPIO_ENABLE_W1TC_ADDRESS      0x14
+#define GPIO_IN_ADDRESS               0x18
+#define GPIO_STATUS_ADDRESS           0x1c
+#define GPIO_STATUS_W1TS_ADDRESS      0x20
+#define GPIO_STATUS_W1TC_ADDRESS      0x24
+#define GPIO_PIN0_ADDRESS             0x28
+#define GPIO_SIGMA_DELTA              0x68
+
+#define GPIO_REG_READ(reg)            host_gpio_read(reg)
+#define GPIO_REG_WRITE(reg, val)      host_gpio_write((reg), (val))
+
+uint32 host_gpio_read(uint32 reg);
+void host_gpio_write(uint32 reg, uint32 val);
+
+// Pin mux: nothing to switch on a PC
+#define PERIPHS_IO_MUX_GPIO2_U        0
+#define PERIPHS_IO_MUX_GPIO4_U        0
+#define PERIPHS_IO_MUX_GPIO5_U        0
+#define PERIPHS_IO_MUX_MTDI_U         0
+#define PERIPHS_IO_MUX_MTCK_U         0
+#define PERIPHS_IO_MUX_MTMS_U         0
+#define PERIPHS_IO_MUX_MTDO_U         0
+#define FUNC_GPIO2                    0
+#define FUNC_GPIO4                    0
+#define FUNC_GPIO5                    0
+#define FUNC_GPIO12                   3
+#define FUNC_GPIO13                   3
+#define FUNC_GPIO14                   3
+#define FUNC_GPIO15                   3
+#define PIN_FUNC_SELECT(reg, func)    do { (void)(reg); (void)(func); } while (0)
+
+void ets_intr_lock(void);
+void ets_intr_unlock(void);
+
+#define ETS_INTR_LOCK()               ets_intr_lock()
+#define ETS_INTR_UNLOCK()             ets_intr_unlock()
+
+#endif
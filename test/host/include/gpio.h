@@ -0,0 +1,34 @@
+// Host stand-in for the SDK's gpio.h (and gpio_register.h). gpio_output_set
+// works on the fake output register in sdk_stubs.c, so tests can see what the
+// firmware drives.
+
+#ifndef _GPIO_H_
+#define _GPIO_H_
+
+#include "ets_sys.h"
+
+#define GPIO_ID_PIN0                  0
+#define GPIO_ID_PIN(n)                (GPIO_ID_PIN0 + (n))
+#define GPIO_PIN_ADDR(i)              (GPIO_PIN0_ADDRESS + (i) * 4)
+
+#define GPIO_PIN_SOURCE_MASK          0x00000001
+#define GPIO_PIN_SOURCE_SET(x)        (((x) & 1) << 0)
+#define GPIO_AS_PIN_SOURCE            0
+#define SIGMA_AS_PIN_SOURCE           1
+
+#define SIGMA_DELTA_ENABLE            1
+#define SIGMA_DELTA_ENABLE_S          16
+#define SIGMA_DELTA_SETTING_PRESCALE  0xff
+#define SIGMA_DELTA_SETTING_PRESCALE_S 8
+#define SIGMA_DELTA_TARGET            0xff
+#define SIGMA_DELTA_TARGET_S          0
+
+#define GPIO_OUTPUT_SET(gpio_no, bit_value) \
+  gpio_output_set((bit_value) << (gpio_no), ((~(bit_value)) & 1) << (gpio_no), 1 << (gpio_no), 0)
+#define GPIO_INPUT_GET(gpio_no)       ((gpio_input_get() >> (gpio_no)) & 1)
+
+void gpio_init(void);
+void gpio_output_set(uint32 set_mask, uint32 clear_mask, uint32 enable_mask, uint32 disable_mask);
+uint32 gpio_input_get(void);
+
+#endif
@@ -0,0 +1,51 @@
+// Host stand-in for lwIP's pbuf.h: the fields and calls our code uses, laid
+// out like lwIP 1.4's (plus one for the fake at the end). The pbufs come from malloc (see lwip_stubs.c), the
+// payload in its own block of exactly the size asked for, so ASan catches a
+// read past the end of a datagram.
+
+#ifndef __LWIP_PBUF_H__
+#define __LWIP_PBUF_H__
+
+#include "c_types.h"
+
+typedef uint8 u8_t;
+typedef uint16 u16_t;
+typedef uint32 u32_t;
+typedef sint8 err_t;
+
+#define ERR_OK      0
+#define ERR_MEM     -1
+#define ERR_BUF     -2
+#define ERR_VAL     -6
+#define ERR_USE     -8
+
+typedef enum {
+  PBUF_TRANSPORT,
+  PBUF_IP,
+  PBUF_LINK,
+  PBUF_RAW
+} pbuf_layer;
+
+typedef enum {
+  PBUF_RAM,
+  PBUF_ROM,
+  PBUF_REF,
+  PBUF_POOL
+} pbuf_type;
+
+struct pbuf {
+  struct pbuf *next;
+  void *payload;
+  u16_t tot_len;
+  u16_t len;
+  u8_t type;
+  u8_t flags;
+  u16_t ref;
+  void *host_block;     // not lwIP's: the block lwip_stubs.c allocated the payload in
+};
+
+struct pbuf *pbuf_alloc(pbuf_layer layer, u16_t length, pbuf_type type);
+u8_t pbuf_free(struct pbuf *p);
+void pbuf_ref(struct pbuf *p);
+
+#endif
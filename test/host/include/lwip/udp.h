@@ -0,0 +1,30 @@
+// Host stand-in for lwIP's udp.h (raw API), see lwip_stubs.c for what the
+// calls do.
+
+#ifndef __LWIP_UDP_H__
+#define __LWIP_UDP_H__
+
+#include "lwip/pbuf.h"
+#include "ip_addr.h"
+
+#define IP_ADDR_ANY     ((ip_addr_t *)&ip_addr_any)
+extern const ip_addr_t ip_addr_any;
+
+struct udp_pcb;
+
+typedef void (*udp_recv_fn)(void *arg, struct udp_pcb *pcb, struct pbuf *p, ip_addr_t *addr, u16_t port);
+
+struct udp_pcb {
+  ip_addr_t local_ip;
+  u16_t local_port;
+  udp_recv_fn recv;
+  void *recv_arg;
+};
+
+struct udp_pcb *udp_new(void);
+void udp_remove(struct udp_pcb *pcb);
+err_t udp_bind(struct udp_pcb *pcb, ip_addr_t *ipaddr, u16_t port);
+void udp_recv(struct udp_pcb *pcb, udp_recv_fn recv, void *recv_arg);
+err_t udp_sendto(struct udp_pcb *pcb, struct pbuf *p, ip_addr_t *dst_ip, u16_t dst_port);
+
+#endif
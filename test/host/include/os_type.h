@@ -0,0 +1,36 @@
+// Host stand-in for the SDK's os_type.h: the timer and task event types, laid
+// out like the real ones.
+
+#ifndef _OS_TYPES_H_
+#define _OS_TYPES_H_
+
+#include "c_types.h"
+
+typedef uint32 ETSSignal;
+typedef uint32 ETSParam;
+
+typedef struct ETSEventTag {
+  ETSSignal sig;
+  ETSParam par;
+} ETSEvent;
+
+typedef void (*ETSTask)(ETSEvent *e);
+
+typedef void ETSTimerFunc(void *timer_arg);
+
+typedef struct _ETSTIMER_ {
+  struct _ETSTIMER_ *timer_next;
+  uint32 timer_expire;        // here: system_get_time() it fires at
+  uint32 timer_period;        // here: us, 0 for a one shot
+  ETSTimerFunc *timer_func;
+  void *timer_arg;
+} ETSTimer;
+
+#define os_signal_t       ETSSignal
+#define os_param_t        ETSParam
+#define os_event_t        ETSEvent
+#define os_task_t         ETSTask
+#define os_timer_t        ETSTimer
+#define os_timer_func_t   ETSTimerFunc
+
+#endif
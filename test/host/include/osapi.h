@@ -0,0 +1,38 @@
+// Host stand-in for the SDK's osapi.h. The string and memory functions are the C
+// library's, os_printf only prints with host_verbose set and the timers run on
+// the fake clock in sdk_stubs.c.
+
+#ifndef _OSAPI_H_
+#define _OSAPI_H_
+
+#include <string.h>
+#include <stdio.h>
+#include "c_types.h"
+#include "os_type.h"
+
+#define os_bzero(s, n)              memset((s), 0, (n))
+#define os_memcmp                   memcmp
+#define os_memcpy                   memcpy
+#define os_memmove                  memmove
+#define os_memset                   memset
+#define os_strcat                   strcat
+#define os_strchr                   strchr
+#define os_strcmp                   strcmp
+#define os_strcpy                   strcpy
+#define os_strlen                   strlen
+#define os_strncmp                  strncmp
+#define os_strncpy                  strncpy
+#define os_strstr                   strstr
+#define os_sprintf                  sprintf
+#define os_snprintf                 snprintf
+
+int host_printf(const char *format, ...) __attribute__((format(printf, 1, 2)));
+#define os_printf                   host_printf
+
+void os_delay_us(uint32 us);
+
+void os_timer_setfn(os_timer_t *ptimer, os_timer_func_t *pfunction, void *parg);
+void os_timer_arm(os_timer_t *ptimer, uint32 milliseconds, bool repeat_flag);
+void os_timer_disarm(os_timer_t *ptimer);
+
+#endif
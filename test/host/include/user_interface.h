@@ -0,0 +1,166 @@
+// Host stand-in for the SDK's user_interface.h. The WiFi event structs are laid
+// out exactly like the SDK's (System_Event_t is 44 bytes on both), so the raw
+// event bytes in the fuzz corpus mean the same thing here as on a unit.
+
+#ifndef __USER_INTERFACE_H__
+#define __USER_INTERFACE_H__
+
+#include "c_types.h"
+#include "os_type.h"
+#include "ip_addr.h"
+
+// System
+enum flash_size_map {
+  FLASH_SIZE_4M_MAP_256_256 = 0,
+  FLASH_SIZE_2M,
+  FLASH_SIZE_8M_MAP_512_512,
+  FLASH_SIZE_16M_MAP_512_512,
+  FLASH_SIZE_32M_MAP_512_512,
+  FLASH_SIZE_16M_MAP_1024_1024,
+  FLASH_SIZE_32M_MAP_1024_1024,
+  FLASH_SIZE_32M_MAP_2048_2048,
+  FLASH_SIZE_64M_MAP_1024_1024,
+  FLASH_SIZE_128M_MAP_1024_1024
+};
+
+typedef void (*init_done_cb_t)(void);
+
+uint32 system_get_time(void);
+uint8 system_get_cpu_freq(void);
+uint32 system_get_free_heap_size(void);
+enum flash_size_map system_get_flash_size_map(void);
+void system_init_done_cb(init_done_cb_t cb);
+bool system_rtc_mem_read(uint8 src_addr, void *des_addr, uint16 load_size);
+bool system_rtc_mem_write(uint8 des_addr, const void *src_addr, uint16 save_size);
+void system_phy_set_max_tpw(uint8 max_tpw);
+
+// Tasks
+enum {
+  USER_TASK_PRIO_0 = 0,
+  USER_TASK_PRIO_1,
+  USER_TASK_PRIO_2,
+  USER_TASK_PRIO_MAX
+};
+
+bool system_os_task(os_task_t task, uint8 prio, os_event_t *queue, uint8 qlen);
+bool system_os_post(uint8 prio, os_signal_t sig, os_param_t par);
+
+// softAP
+#define STATION_IF      0x00
+#define SOFTAP_IF       0x01
+
+typedef enum _auth_mode {
+  AUTH_OPEN = 0,
+  AUTH_WEP,
+  AUTH_WPA_PSK,
+  AUTH_WPA2_PSK,
+  AUTH_WPA_WPA2_PSK,
+  AUTH_MAX
+} AUTH_MODE;
+
+struct softap_config {
+  uint8 ssid[32];
+  uint8 password[64];
+  uint8 ssid_len;
+  uint8 channel;
+  AUTH_MODE authmode;
+  uint8 ssid_hidden;
+  uint8 max_connection;
+  uint16 beacon_interval;
+};
+
+bool wifi_softap_get_config(struct softap_config *config);
+bool wifi_softap_set_config(struct softap_config *config);
+bool wifi_softap_set_config_current(struct softap_config *config);
+uint8 wifi_softap_get_station_num(void);
+bool wifi_softap_deauth(uint8 mac[6]);
+bool wifi_get_ip_info(uint8 if_index, struct ip_info *info);
+
+// WiFi events
+enum {
+  EVENT_STAMODE_CONNECTED = 0,
+  EVENT_STAMODE_DISCONNECTED,
+  EVENT_STAMODE_AUTHMODE_CHANGE,
+  EVENT_STAMODE_GOT_IP,
+  EVENT_STAMODE_DHCP_TIMEOUT,
+  EVENT_SOFTAPMODE_STACONNECTED,
+  EVENT_SOFTAPMODE_STADISCONNECTED,
+  EVENT_SOFTAPMODE_PROBEREQRECVED,
+  EVENT_OPMODE_CHANGED,
+  EVENT_SOFTAPMODE_DISTRIBUTE_STA_IP,
+  EVENT_MAX
+};
+
+typedef struct {
+  uint8 ssid[32];
+  uint8 ssid_len;
+  uint8 bssid[6];
+  uint8 channel;
+} Event_StaMode_Connected_t;
+
+typedef struct {
+  uint8 ssid[32];
+  uint8 ssid_len;
+  uint8 bssid[6];
+  uint8 reason;
+} Event_StaMode_Disconnected_t;
+
+typedef struct {
+  uint8 old_mode;
+  uint8 new_mode;
+} Event_StaMode_AuthMode_Change_t;
+
+typedef struct {
+  struct ip_addr ip;
+  struct ip_addr mask;
+  struct ip_addr gw;
+} Event_StaMode_Got_IP_t;
+
+typedef struct {
+  uint8 mac[6];
+  uint8 aid;
+} Event_SoftAPMode_StaConnected_t;
+
+typedef struct {
+  uint8 mac[6];
+  struct ip_addr ip;
+  uint8 aid;
+} Event_SoftAPMode_Distribute_Sta_IP_t;
+
+typedef struct {
+  uint8 mac[6];
+  uint8 aid;
+} Event_SoftAPMode_StaDisconnected_t;
+
+typedef struct {
+  int rssi;
+  uint8 mac[6];
+} Event_SoftAPMode_ProbeReqRecved_t;
+
+typedef struct {
+  uint8 old_opmode;
+  uint8 new_opmode;
+} Event_OpMode_Change_t;
+
+typedef union {
+  Event_StaMode_Connected_t connected;
+  Event_StaMode_Disconnected_t disconnected;
+  Event_StaMode_AuthMode_Change_t auth_change;
+  Event_StaMode_Got_IP_t got_ip;
+  Event_SoftAPMode_StaConnected_t sta_connected;
+  Event_SoftAPMode_Distribute_Sta_IP_t distribute_sta_ip;
+  Event_SoftAPMode_StaDisconnected_t sta_disconnected;
+  Event_SoftAPMode_ProbeReqRecved_t ap_probereqrecved;
+  Event_OpMode_Change_t opmode_changed;
+} Event_Info_u;
+
+typedef struct _esp_event {
+  uint32 event;
+  Event_Info_u event_info;
+} System_Event_t;
+
+typedef void (*wifi_event_handler_cb_t)(System_Event_t *event);
+
+void wifi_set_event_handler_cb(wifi_event_handler_cb_t cb);
+
+#endif
@@ -0,0 +1,244 @@
+// The IR transmitter's edge schedule (ir_tx.c) against a simulated FRC1.
+//
+// ir_tx.c is #included, and hw_timer_* are replaced by a model of the FRC1:
+// started with a load value it fires that many ticks later, in auto reload mode
+// it keeps firing every load ticks from the first, no matter when the interrupt
+// got serviced. Every interrupt is serviced late by a random latency (0 up to a
+// limit) on the fake CCOUNT, and every change of the IR pin is recorded with
+// its time. CCOUNT starts just below the wrap so it wraps mid code.
+//
+// The NEC test code is sent with no latency, a little and nearly a half period
+// of it, and for every mark:
+//   - edge k (k = 0 is the rising edge that starts the mark) comes at
+//     mark start + k half periods, late by no more than the latency limit.
+//     That's the whole point of auto reload: the lateness doesn't build up
+//   - the number of edges matches the carrier cycles asked for, the pin
+//     alternates and there are no glitches (two changes in one interrupt)
+//   - from one mark to the next is exactly the mark and the space, plus at
+//     most one latency per segment boundary (the timer is restarted from a
+//     late interrupt there)
+//   - what ir_tx measured itself (edge gaps, segment error) is in those bounds
+// and with no latency the carrier comes out at IR_TX_CARRIER_HZ to 0.1%.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "ir_tx.c"
+#include "ir_codes.h"
+#include "sdk_stubs.h"
+
+#define P               HALF_PERIOD_TICKS
+#define EDGES_MAX       4096
+#define CCOUNT_START    0xfff00000
+
+// Simulated FRC1
+
+LOCAL struct {
+  hw_timer_cb_t cb;
+  void *arg;
+  bool claimed;
+  bool armed;
+  bool repeat;
+  uint32 load;
+  uint32 next;          // CCOUNT of the next interrupt (before latency)
+} frc1;
+
+bool hw_timer_claim(hw_timer_cb_t cb, void *arg) {
+  if (frc1.claimed)
+    return false;
+  frc1.claimed = true;
+  frc1.cb = cb;
+  frc1.arg = arg;
+  return true;
+}
+
+void hw_timer_release(void) {
+  frc1.claimed = false;
+  frc1.armed = false;
+}
+
+void hw_timer_start(uint32 ticks, bool repeat) {
+  HOST_CHECK(ticks >= HW_TIMER_MIN_TICKS && ticks <= HW_TIMER_MAX_TICKS);
+  frc1.load = ticks;
+  frc1.repeat = repeat;
+  frc1.armed = true;
+  frc1.next = get_ccount() + ticks;
+}
+
+void hw_timer_reload(uint32 ticks) {
+  frc1.load = ticks;
+}
+
+void hw_timer_stop(void) {
+  frc1.armed = false;
+}
+
+// The pin
+
+LOCAL struct {
+  uint32 time;
+  uint16 segment;       // ir.idx when it happened
+  bool high;
+} edges[EDGES_MAX];
+LOCAL uint32 edge_count;
+LOCAL bool pin_high;
+
+LOCAL void pin_changed(uint32 out) {
+  bool high = (out & PIN_BIT) != 0;
+
+  if (high == pin_high)
+    return;
+  pin_high = high;
+  if (edge_count < EDGES_MAX) {
+    edges[edge_count].time = host_ccount;
+    edges[edge_count].segment = ir.idx;
+    edges[edge_count].high = high;
+  }
+  edge_count++;
+}
+
+LOCAL uint32 random_state = 0x1d872b41;
+
+LOCAL uint32 latency(uint32 max) {
+  random_state ^= random_state << 13;
+  random_state ^= random_state >> 17;
+  random_state ^= random_state << 5;
+  return max == 0 ? 0 : random_state % (max + 1);
+}
+
+// Send a code, servicing every FRC1 interrupt up to latency_max cycles late
+LOCAL void send(const uint16 *code, uint16 len, uint32 latency_max) {
+  host_reset();
+  host_ccount_manual = true;
+  host_ccount = CCOUNT_START;
+  os_bzero(&frc1, sizeof(frc1));
+  ir_tx_init();
+  host_gpio_changed = pin_changed;
+  pin_high = false;
+  edge_count = 0;
+
+  HOST_CHECK(ir_tx_send(code, len));
+  HOST_CHECK(!ir_tx_send(code, len));
+  while (frc1.armed) {
+    uint32 fire = frc1.next;
+
+    if (frc1.repeat)
+      frc1.next += frc1.load;
+    else
+      frc1.armed = false;
+    host_ccount = fire + latency(latency_max);
+    frc1.cb(frc1.arg);
+  }
+  HOST_CHECK(!ir_tx_busy());
+  HOST_CHECK(!pin_high);
+  HOST_CHECK(edge_count <= EDGES_MAX);
+
+  // The done timer gives the FRC1 back
+  HOST_CHECK(frc1.claimed);
+  host_advance_ms(20);
+  HOST_CHECK(!frc1.claimed);
+}
+
+// Half periods in a mark of us microseconds
+LOCAL uint32 half_periods(uint32 us) {
+  uint32 n = (uint32)((uint64)us * 2 * IR_TX_CARRIER_HZ / 1000 + 500) / 1000;
+  return n == 0 ? 1 : n;
+}
+
+LOCAL void check_schedule(const uint16 *code, uint16 len, uint32 latency_max) {
+  uint32 e = 0, seg;
+  uint32 prev_start = 0;
+  uint32 prev_n = 0;
+
+  for (seg = 0; seg < len; seg += 2) {
+    uint32 n = half_periods(code[seg]);
+    uint32 want = n + (n & 1);
+    uint32 start, k;
+
+    // Every edge of this mark, the falling one at its end included
+    if (e >= edge_count || edges[e].segment / 2 != seg / 2 || !edges[e].high) {
+      fprintf(stderr, "mark %u: doesn't start with a rising edge\n", seg);
+      host_failures++;
+      return;
+    }
+    start = edges[e].time;
+    for (k = 0; e + k < edge_count && edges[e + k].segment / 2 == seg / 2; k++) {
+      sint32 late = (sint32)(edges[e + k].time - (start + k * P));
+
+      if (edges[e + k].high != (k % 2 == 0) || late < 0 || late > (sint32)latency_max) {
+        fprintf(stderr, "mark %u, edge %u: %s, %d cycles late (latency up to %u)\n",
+                seg, k, edges[e + k].high ? "rising" : "falling", late, latency_max);
+        host_failures++;
+        return;
+      }
+    }
+    if (k != want) {
+      fprintf(stderr, "mark %u: %u edges, expected %u\n", seg, k, want);
+      host_failures++;
+    }
+
+    // From the last mark: its half periods, the space, and one latency for each
+    // of the two segment changes
+    if (seg > 0) {
+      sint32 late = (sint32)(start - (prev_start + prev_n * P + code[seg - 1] * HW_TIMER_TICKS_PER_US));
+      if (late < 0 || late > 2 * (sint32)latency_max) {
+        fprintf(stderr, "mark %u: starts %d cycles late (latency up to %u)\n", seg, late, latency_max);
+        host_failures++;
+      }
+    }
+    prev_start = start;
+    prev_n = n;
+    e += k;
+  }
+  HOST_CHECK(e == edge_count);
+
+  // What ir_tx measured
+  HOST_CHECK(ir.edge_min >= P - latency_max);
+  HOST_CHECK(ir.edge_max <= P + latency_max);
+  HOST_CHECK(ir.segment_err_max <= latency_max + P);
+}
+
+// Average carrier frequency over the 9ms leader
+LOCAL void check_carrier(void) {
+  uint32 n = half_periods(ir_code_nec_00_45[0]);
+  uint32 last_rise = (n - 1) & ~1;
+  uint32 cycles = edges[last_rise].time - edges[0].time;
+  double hz = 80e6 * (last_rise / 2) / cycles;
+
+  HOST_CHECK(hz > IR_TX_CARRIER_HZ * 0.999 && hz < IR_TX_CARRIER_HZ * 1.001);
+  printf("carrier %.1f Hz\n", hz);
+}
+
+int main(void) {
+  static const uint32 latencies[] = { 0, 200, P - 100 };
+  static const uint16 one_half_period[] = { 10, 100, 10 };
+  uint32 i;
+
+  host_verbose = getenv("HOST_VERBOSE") != NULL;
+  for (i = 0; i < sizeof(latencies) / sizeof(latencies[0]); i++) {
+    uint32 errors = host_failures;
+
+    send(ir_code_nec_00_45, sizeof(ir_code_nec_00_45) / sizeof(ir_code_nec_00_45[0]), latencies[i]);
+    check_schedule(ir_code_nec_00_45, sizeof(ir_code_nec_00_45) / sizeof(ir_code_nec_00_45[0]), latencies[i]);
+    if (latencies[i] == 0)
+      check_carrier();
+    printf("latency up to %u cycles: %u edges, edge gap %u-%u, worst segment error %u cycles%s\n",
+           latencies[i], edge_count, ir.edge_min, ir.edge_max, ir.segment_err_max,
+           host_failures == errors ? "" : " FAILED");
+  }
+
+  // Marks shorter than a half period still get one
+  send(one_half_period, 3, 0);
+  check_schedule(one_half_period, 3, 0);
+
+  // The FRC1 is taken
+  host_reset();
+  frc1.claimed = true;
+  HOST_CHECK(!ir_tx_send(ir_code_nec_00_45, 4));
+
+  if (host_failures != 0) {
+    printf("ir tx test: %d checks failed\n", host_failures);
+    return 1;
+  }
+  printf("ir tx test: all checks held\n");
+  return 0;
+}
@@ -0,0 +1,166 @@
+// Fake lwIP for host builds ... see lwip_stubs.h.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "lwip_stubs.h"
+
+#define PCBS_MAX        8
+#define UDP_HLEN        8
+
+const ip_addr_t ip_addr_any;
+
+sint32 host_pbufs;
+uint8 host_udp_sent[HOST_UDP_SENT_MAX];
+uint16 host_udp_sent_len;
+uint32 host_udp_sends;
+bool host_udp_hold;
+
+LOCAL struct udp_pcb *bound[PCBS_MAX];
+LOCAL struct pbuf *held[HOST_UDP_HELD_MAX];
+
+// The pbufs from the last test are the test's business (a leak shows up in
+// host_pbufs before this)
+void host_lwip_reset(void) {
+  host_pbufs = 0;
+  host_udp_sent_len = 0;
+  host_udp_sends = 0;
+  host_udp_hold = false;
+  memset(bound, 0, sizeof(bound));
+  memset(held, 0, sizeof(held));
+}
+
+// Headroom for the transport and IP headers, like lwIP leaves for PBUF_TRANSPORT.
+// PBUF_REF and PBUF_ROM get no memory, the caller points payload at its own.
+struct pbuf *pbuf_alloc(pbuf_layer layer, u16_t length, pbuf_type type) {
+  uint32 headroom = layer == PBUF_TRANSPORT ? 54 : layer == PBUF_IP ? 34 : layer == PBUF_LINK ? 14 : 0;
+  bool ref = type == PBUF_REF || type == PBUF_ROM;
+  struct pbuf *p = calloc(1, sizeof(*p));
+  uint8 *block = ref ? NULL : malloc(headroom + length);
+
+  if (p == NULL || (block == NULL && !ref)) {
+    free(p);
+    free(block);
+    return NULL;
+  }
+  p->payload = ref ? NULL : block + headroom;
+  p->tot_len = length;
+  p->len = length;
+  p->type = type;
+  p->ref = 1;
+  p->host_block = block;
+  host_pbufs++;
+  return p;
+}
+
+u8_t pbuf_free(struct pbuf *p) {
+  if (p == NULL || p->ref == 0) {
+    fprintf(stderr, "lwip stubs: pbuf_free of a free pbuf\n");
+    abort();
+  }
+  if (--p->ref > 0)
+    return 0;
+  free(p->host_block);
+  free(p);
+  host_pbufs--;
+  return 1;
+}
+
+void pbuf_ref(struct pbuf *p) {
+  p->ref++;
+}
+
+struct udp_pcb *udp_new(void) {
+  return calloc(1, sizeof(struct udp_pcb));
+}
+
+void udp_remove(struct udp_pcb *pcb) {
+  uint32 i;
+
+  for (i = 0; i < PCBS_MAX; i++)
+    if (bound[i] == pcb)
+      bound[i] = NULL;
+  free(pcb);
+}
+
+err_t udp_bind(struct udp_pcb *pcb, ip_addr_t *ipaddr, u16_t port) {
+  uint32 i, free_slot = PCBS_MAX;
+
+  for (i = 0; i < PCBS_MAX; i++) {
+    if (bound[i] != NULL && bound[i] != pcb && bound[i]->local_port == port)
+      return ERR_USE;
+    if ((bound[i] == NULL || bound[i] == pcb) && free_slot == PCBS_MAX)
+      free_slot = i;
+  }
+  if (free_slot == PCBS_MAX)
+    return ERR_MEM;
+  pcb->local_ip = *ipaddr;
+  pcb->local_port = port;
+  bound[free_slot] = pcb;
+  return ERR_OK;
+}
+
+void udp_recv(struct udp_pcb *pcb, udp_recv_fn recv, void *recv_arg) {
+  pcb->recv = recv;
+  pcb->recv_arg = recv_arg;
+}
+
+err_t udp_sendto(struct udp_pcb *pcb, struct pbuf *p, ip_addr_t *dst_ip, u16_t dst_port) {
+  uint32 i;
+
+  if (p->len > HOST_UDP_SENT_MAX || p->next != NULL)
+    return ERR_VAL;
+  memcpy(host_udp_sent, p->payload, p->len);
+  host_udp_sent_len = p->len;
+  host_udp_sends++;
+
+  // Our header goes in front, in the pbuf's own headroom. lwIP chains a header
+  // pbuf in front of a PBUF_REF instead (which then holds the ref on it), that
+  // doesn't move anything.
+  if (p->type != PBUF_REF && p->type != PBUF_ROM) {
+    if ((uint8 *)p->payload - UDP_HLEN < (uint8 *)p->host_block)
+      return ERR_BUF;
+    p->payload = (uint8 *)p->payload - UDP_HLEN;
+    p->len += UDP_HLEN;
+    p->tot_len += UDP_HLEN;
+  }
+
+  if (host_udp_hold) {
+    for (i = 0; i < HOST_UDP_HELD_MAX && held[i] != NULL; i++)
+      ;
+    if (i == HOST_UDP_HELD_MAX)
+      return ERR_MEM;
+    pbuf_ref(p);
+    held[i] = p;
+  }
+  return ERR_OK;
+}
+
+void host_udp_release_held(void) {
+  uint32 i;
+
+  for (i = 0; i < HOST_UDP_HELD_MAX; i++) {
+    if (held[i] != NULL)
+      pbuf_free(held[i]);
+    held[i] = NULL;
+  }
+}
+
+// A datagram from 192.168.4.2:5353 to whoever is bound to port
+bool host_udp_deliver(u16_t port, const void *data, u16_t len) {
+  ip_addr_t from;
+  struct pbuf *p;
+  uint32 i;
+
+  for (i = 0; i < PCBS_MAX && (bound[i] == NULL || bound[i]->local_port != port || bound[i]->recv == NULL); i++)
+    ;
+  if (i == PCBS_MAX)
+    return false;
+  p = pbuf_alloc(PBUF_RAW, len, PBUF_RAM);
+  if (p == NULL)
+    return false;
+  memcpy(p->payload, data, len);
+  IP4_ADDR(&from, 192, 168, 4, 2);
+  bound[i]->recv(bound[i]->recv_arg, bound[i], p, &from, 5353);
+  return true;
+}
@@ -0,0 +1,31 @@
+// A fake lwIP (raw UDP and pbufs) for host tests of our UDP services.
+//
+//   - pbuf_alloc mallocs, pbuf_free frees when the last ref goes, and
+//     host_pbufs counts the ones still around so a test can see a leak
+//   - udp_bind remembers the pcb so host_udp_deliver can hand it a datagram
+//     the way lwIP's input path would (in a pbuf of exactly that size)
+//   - udp_sendto keeps a copy of what was sent in host_udp_sent. Like the real
+//     one it moves the payload pointer back over the 8 byte UDP header, and with
+//     host_udp_hold set it keeps a ref on the pbuf like the WiFi driver does
+//     until the frame is on the air (host_udp_release_held lets go)
+
+#ifndef LWIP_STUBS_H
+#define LWIP_STUBS_H
+
+#include "lwip/pbuf.h"
+#include "lwip/udp.h"
+
+#define HOST_UDP_SENT_MAX   1500
+#define HOST_UDP_HELD_MAX   16
+
+extern sint32 host_pbufs;
+extern uint8 host_udp_sent[HOST_UDP_SENT_MAX];
+extern uint16 host_udp_sent_len;
+extern uint32 host_udp_sends;
+extern bool host_udp_hold;
+
+void host_lwip_reset(void);
+bool host_udp_deliver(u16_t port, const void *data, u16_t len);
+void host_udp_release_held(void);
+
+#endif
@@ -0,0 +1,340 @@
+// Fake SDK for host builds ... see sdk_stubs.h.
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "ets_sys.h"
+#include "osapi.h"
+#include "gpio.h"
+#include "user_interface.h"
+#include "ccount.h"
+#include "sdk_stubs.h"
+
+#define TIMERS_MAX      32
+#define TASK_PRIOS      3
+#define TASK_RUNS_MAX   100000    // per host_run_tasks, so a task that keeps posting itself can't hang a test
+
+bool host_verbose;
+uint32 host_time_us;
+bool host_ccount_manual;
+uint32 host_ccount;
+uint8 host_stations;
+uint32 host_deauths;
+struct softap_config host_softap_config;
+uint32 host_softap_config_fails;
+uint8 host_max_tpw;
+init_done_cb_t host_init_done_cb;
+wifi_event_handler_cb_t host_event_cb;
+int host_failures;
+void (*host_gpio_changed)(uint32 out);
+
+LOCAL os_timer_t *timers[TIMERS_MAX];
+
+LOCAL struct {
+  os_task_t task;
+  os_event_t *queue;
+  uint8 length;
+  uint8 head;
+  uint8 count;
+} tasks[TASK_PRIOS];
+
+LOCAL uint32 gpio_regs[0x80 / 4];
+
+// Everything back to power on (the firmware's own variables are the test's job)
+void host_reset(void) {
+  host_time_us = 0;
+  host_ccount_manual = false;
+  host_ccount = 0;
+  host_stations = 0;
+  host_deauths = 0;
+  memset(&host_softap_config, 0, sizeof(host_softap_config));
+  host_softap_config_fails = 0;
+  host_max_tpw = 82;
+  host_init_done_cb = NULL;
+  host_event_cb = NULL;
+  memset(timers, 0, sizeof(timers));
+  memset(tasks, 0, sizeof(tasks));
+  memset(gpio_regs, 0, sizeof(gpio_regs));
+  host_gpio_changed = NULL;
+}
+
+int host_printf(const char *format, ...) {
+  va_list args;
+  int n;
+
+  if (!host_verbose)
+    return 0;
+  va_start(args, format);
+  n = vprintf(format, args);
+  va_end(args);
+  return n;
+}
+
+// Clock
+
+uint32 system_get_time(void) {
+  return host_time_us;
+}
+
+uint8 system_get_cpu_freq(void) {
+  return 80;
+}
+
+uint32 get_ccount(void) {
+  struct timespec ts;
+
+  if (host_ccount_manual)
+    return host_ccount;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint32)((uint64)ts.tv_sec * 80000000 + (uint64)ts.tv_nsec * 80 / 1000);
+}
+
+void os_delay_us(uint32 us) {
+}
+
+void ets_intr_lock(void) {
+}
+
+void ets_intr_unlock(void) {
+}
+
+// Timers
+
+void os_timer_setfn(os_timer_t *ptimer, os_timer_func_t *pfunction, void *parg) {
+  ptimer->timer_func = pfunction;
+  ptimer->timer_arg = parg;
+}
+
+void os_timer_disarm(os_timer_t *ptimer) {
+  uint32 i;
+
+  for (i = 0; i < TIMERS_MAX; i++)
+    if (timers[i] == ptimer)
+      timers[i] = NULL;
+}
+
+void os_timer_arm(os_timer_t *ptimer, uint32 milliseconds, bool repeat_flag) {
+  uint32 i, free = TIMERS_MAX;
+
+  ptimer->timer_expire = host_time_us + milliseconds * 1000;
+  ptimer->timer_period = repeat_flag ? (milliseconds > 0 ? milliseconds : 1) * 1000 : 0;
+  for (i = 0; i < TIMERS_MAX; i++) {
+    if (timers[i] == ptimer)
+      return;
+    if (timers[i] == NULL && free == TIMERS_MAX)
+      free = i;
+  }
+  if (free == TIMERS_MAX) {
+    fprintf(stderr, "sdk stubs: more than %d timers armed\n", TIMERS_MAX);
+    host_failures++;
+    return;
+  }
+  timers[free] = ptimer;
+}
+
+uint32 host_timers_armed(void) {
+  uint32 i, n = 0;
+
+  for (i = 0; i < TIMERS_MAX; i++)
+    if (timers[i] != NULL)
+      n++;
+  return n;
+}
+
+// Fire every timer that's due up to time_us, earliest first, running the tasks
+// after each one. The clock ends up at time_us.
+void host_run_until(uint32 time_us) {
+  for (;;) {
+    os_timer_t *next = NULL;
+    uint32 i;
+
+    for (i = 0; i < TIMERS_MAX; i++) {
+      os_timer_t *t = timers[i];
+      if (t != NULL && (sint32)(t->timer_expire - time_us) <= 0 &&
+          (next == NULL || (sint32)(t->timer_expire - next->timer_expire) < 0))
+        next = t;
+    }
+    if (next == NULL)
+      break;
+
+    if ((sint32)(next->timer_expire - host_time_us) > 0)
+      host_time_us = next->timer_expire;
+    if (next->timer_period != 0)
+      next->timer_expire += next->timer_period;
+    else
+      os_timer_disarm(next);
+    next->timer_func(next->timer_arg);
+    host_run_tasks();
+  }
+  host_time_us = time_us;
+}
+
+void host_advance_ms(uint32 ms) {
+  host_run_until(host_time_us + ms * 1000);
+}
+
+// Tasks
+
+bool system_os_task(os_task_t task, uint8 prio, os_event_t *queue, uint8 qlen) {
+  if (prio >= TASK_PRIOS)
+    return false;
+  tasks[prio].task = task;
+  tasks[prio].queue = queue;
+  tasks[prio].length = qlen;
+  tasks[prio].head = 0;
+  tasks[prio].count = 0;
+  return true;
+}
+
+bool system_os_post(uint8 prio, os_signal_t sig, os_param_t par) {
+  os_event_t *e;
+
+  if (prio >= TASK_PRIOS || tasks[prio].task == NULL || tasks[prio].count >= tasks[prio].length)
+    return false;
+  e = &tasks[prio].queue[(tasks[prio].head + tasks[prio].count++) % tasks[prio].length];
+  e->sig = sig;
+  e->par = par;
+  return true;
+}
+
+// Run queued task events, highest priority first, until every queue is empty.
+// Returns how many ran.
+uint32 host_run_tasks(void) {
+  uint32 runs = 0;
+  sint32 prio;
+
+  while (runs < TASK_RUNS_MAX) {
+    os_event_t e;
+
+    for (prio = TASK_PRIOS - 1; prio >= 0 && tasks[prio].count == 0; prio--)
+      ;
+    if (prio < 0)
+      break;
+
+    e = tasks[prio].queue[tasks[prio].head];
+    tasks[prio].head = (tasks[prio].head + 1) % tasks[prio].length;
+    tasks[prio].count--;
+    tasks[prio].task(&e);
+    runs++;
+  }
+  return runs;
+}
+
+// GPIO
+
+uint32 host_gpio_read(uint32 reg) {
+  return gpio_regs[(reg & 0x7f) / 4];
+}
+
+void host_gpio_write(uint32 reg, uint32 val) {
+  uint32 out = gpio_regs[GPIO_OUT_ADDRESS / 4];
+
+  switch (reg) {
+    case GPIO_OUT_W1TS_ADDRESS:
+      gpio_regs[GPIO_OUT_ADDRESS / 4] |= val;
+      break;
+    case GPIO_OUT_W1TC_ADDRESS:
+      gpio_regs[GPIO_OUT_ADDRESS / 4] &= ~val;
+      break;
+    case GPIO_ENABLE_W1TS_ADDRESS:
+      gpio_regs[GPIO_ENABLE_ADDRESS / 4] |= val;
+      break;
+    case GPIO_ENABLE_W1TC_ADDRESS:
+      gpio_regs[GPIO_ENABLE_ADDRESS / 4] &= ~val;
+      break;
+    default:
+      gpio_regs[(reg & 0x7f) / 4] = val;
+      break;
+  }
+  if (host_gpio_changed != NULL && gpio_regs[GPIO_OUT_ADDRESS / 4] != out)
+    host_gpio_changed(gpio_regs[GPIO_OUT_ADDRESS / 4]);
+}
+
+uint32 host_gpio_out(void) {
+  return gpio_regs[GPIO_OUT_ADDRESS / 4];
+}
+
+void gpio_init(void) {
+}
+
+void gpio_output_set(uint32 set_mask, uint32 clear_mask, uint32 enable_mask, uint32 disable_mask) {
+  host_gpio_write(GPIO_OUT_W1TS_ADDRESS, set_mask);
+  host_gpio_write(GPIO_OUT_W1TC_ADDRESS, clear_mask);
+  host_gpio_write(GPIO_ENABLE_W1TS_ADDRESS, enable_mask);
+  host_gpio_write(GPIO_ENABLE_W1TC_ADDRESS, disable_mask);
+}
+
+uint32 gpio_input_get(void) {
+  return gpio_regs[GPIO_IN_ADDRESS / 4];
+}
+
+// System
+
+uint32 system_get_free_heap_size(void) {
+  return 40000;
+}
+
+enum flash_size_map system_get_flash_size_map(void) {
+  return FLASH_SIZE_32M_MAP_1024_1024;
+}
+
+void system_init_done_cb(init_done_cb_t cb) {
+  host_init_done_cb = cb;
+}
+
+bool system_rtc_mem_read(uint8 src_addr, void *des_addr, uint16 load_size) {
+  return false;
+}
+
+bool system_rtc_mem_write(uint8 des_addr, const void *src_addr, uint16 save_size) {
+  return false;
+}
+
+void system_phy_set_max_tpw(uint8 max_tpw) {
+  host_max_tpw = max_tpw;
+}
+
+// softAP
+
+bool wifi_softap_get_config(struct softap_config *config) {
+  *config = host_softap_config;
+  return true;
+}
+
+bool wifi_softap_set_config(struct softap_config *config) {
+  if (host_softap_config_fails > 0) {
+    host_softap_config_fails--;
+    return false;
+  }
+  host_softap_config = *config;
+  return true;
+}
+
+bool wifi_softap_set_config_current(struct softap_config *config) {
+  host_softap_config = *config;
+  return true;
+}
+
+uint8 wifi_softap_get_station_num(void) {
+  return host_stations;
+}
+
+bool wifi_softap_deauth(uint8 mac[6]) {
+  host_deauths++;
+  return true;
+}
+
+bool wifi_get_ip_info(uint8 if_index, struct ip_info *info) {
+  memset(info, 0, sizeof(*info));
+  if (if_index == SOFTAP_IF) {
+    IP4_ADDR(&info->ip, 192, 168, 4, 1);
+    IP4_ADDR(&info->netmask, 255, 255, 255, 0);
+    IP4_ADDR(&info->gw, 192, 168, 4, 1);
+  }
+  return true;
+}
+
+void wifi_set_event_handler_cb(wifi_event_handler_cb_t cb) {
+  host_event_cb = cb;
+}
@@ -0,0 +1,56 @@
+// A fake SDK so firmware modules build and run on a PC (make host-test).
+//
+// The stub headers in test/host/include stand in for the SDK's and sdk_stubs.c
+// does what the SDK would, just enough for our code:
+//   - a clock (system_get_time) that only moves when a test says so, with the
+//     os_timers firing in order as it does
+//   - the three task queues, run after every callback like the SDK does
+//   - a GPIO output register, so a test can see the status LED (or be told about
+//     every change of it)
+//   - the softAP: its config (which can be made to fail), a station count, the
+//     TX power and the callbacks the firmware registers (init done, WiFi events)
+// get_ccount counts real time at 80 cycles per us unless a test sets
+// host_ccount_manual and moves host_ccount itself.
+//
+// Tests that need a module's LOCAL variables #include the .c file instead of
+// linking it.
+
+#ifndef SDK_STUBS_H
+#define SDK_STUBS_H
+
+#include <stdio.h>
+#include "c_types.h"
+#include "os_type.h"
+#include "user_interface.h"
+
+extern bool host_verbose;           // let os_printf through
+extern uint32 host_time_us;         // what system_get_time returns
+extern bool host_ccount_manual;
+extern uint32 host_ccount;
+extern uint8 host_stations;         // what wifi_softap_get_station_num returns
+extern uint32 host_deauths;
+extern struct softap_config host_softap_config;
+extern uint32 host_softap_config_fails;  // wifi_softap_set_config fails this many more times
+extern uint8 host_max_tpw;              // the last system_phy_set_max_tpw (82 at power on)
+extern init_done_cb_t host_init_done_cb;
+extern wifi_event_handler_cb_t host_event_cb;
+extern int host_failures;
+extern void (*host_gpio_changed)(uint32 out);   // called whenever the GPIO output register changes
+
+void host_reset(void);
+uint32 host_run_tasks(void);
+void host_run_until(uint32 time_us);
+void host_advance_ms(uint32 ms);
+uint32 host_gpio_out(void);
+uint32 host_timers_armed(void);
+
+// Count a failed check (the test exits non zero if there were any) and go on
+#define HOST_CHECK(cond)                                                      \
+  do {                                                                        \
+    if (!(cond)) {                                                            \
+      fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+      host_failures++;                                                        \
+    }                                                                         \
+  } while (0)
+
+#endif
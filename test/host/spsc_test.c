@@ -0,0 +1,221 @@
+// spsc_ring.h on the host: ordering, wrap around and overflow counting, then
+// how fast it is.
+//
+//   1. Interleaving: one thread plays both sides and picks at random which one
+//      goes next, so fills, drains, full rings and every batch size come up.
+//      head and tail start just below 2^32 so the counters wrap early on.
+//      What goes in must come out in order, every refused push is counted in
+//      overflows, and the count never goes past the size.
+//   2. Two threads: a real producer and consumer racing on one ring (this is
+//      where the barriers matter). Every item must arrive exactly once, in
+//      order.
+//   3. Throughput: items per second through push / pop_batch, on one thread
+//      and on two. Only a comparison between changes on the same PC ... the
+//      lx106 is a lot slower, and the sanitizers slow this down too (see the
+//      Makefile). On a one core PC the two thread number mostly measures the
+//      hand over between threads, not the ring.
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "spsc_ring.h"
+#include "sdk_stubs.h"
+
+#define RING_SIZE       64
+#define RANDOM_STEPS    2000000
+#define THREAD_ITEMS    1000000
+#define BENCH_ITEMS     4000000
+#define BATCH_MAX       16
+
+SPSC_RING_DECLARE(test_ring, uint32, RING_SIZE)
+
+LOCAL struct test_ring ring;
+
+LOCAL double now_s(void) {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Fast, repeatable randomness (xorshift32)
+LOCAL uint32 random_state = 0x2545f491;
+
+LOCAL uint32 random_next(void) {
+  random_state ^= random_state << 13;
+  random_state ^= random_state >> 17;
+  random_state ^= random_state << 5;
+  return random_state;
+}
+
+// 1. Both sides on one thread, in random order
+
+LOCAL void test_interleaving(void) {
+  uint32 next_in = 0, next_out = 0, refused = 0, wraps = 0;
+  uint32 out[BATCH_MAX];
+  uint32 step;
+
+  test_ring_reset(&ring);
+  ring.head = ring.tail = 0xffffffff - RING_SIZE / 2;
+
+  for (step = 0; step < RANDOM_STEPS; step++) {
+    uint32 r = random_next();
+    uint32 head_before = ring.head;
+    // Mostly pushes for 512 steps, then as many pops, so the ring runs full and runs dry
+    bool push = (step / 512) % 2 == 0 ? (r >> 8) % 16 != 0 : (r >> 8) % 2 == 0;
+
+    if (push) {
+      if (test_ring_push(&ring, next_in))
+        next_in++;
+      else
+        refused++;
+    } else {
+      uint32 max = 1 + (r >> 16) % BATCH_MAX;
+      uint32 n = test_ring_pop_batch(&ring, out, max);
+      uint32 i;
+
+      HOST_CHECK(n <= max);
+      for (i = 0; i < n; i++) {
+        if (out[i] != next_out) {
+          fprintf(stderr, "spsc: step %u: got %u, expected %u\n", step, out[i], next_out);
+          host_failures++;
+          return;
+        }
+        next_out++;
+      }
+    }
+    if (ring.head < head_before)
+      wraps++;
+    HOST_CHECK(test_ring_count(&ring) <= RING_SIZE);
+    HOST_CHECK(test_ring_count(&ring) == next_in - next_out);
+  }
+
+  HOST_CHECK(ring.overflows == refused);
+  HOST_CHECK(wraps == 1);
+  HOST_CHECK(refused > 0);
+  printf("interleaving: %u steps, %u items through, %u refused when full\n", RANDOM_STEPS, next_out, refused);
+}
+
+// 2. and 3. A producer and a consumer thread
+
+// A side that keeps finding the ring full (or empty) spins a while, then sleeps
+// so the other side gets the CPU even when the test box has only one core
+// (sched_yield doesn't reliably hand it over)
+LOCAL void backoff(uint32 *misses) {
+  static const struct timespec pause = { 0, 1000 };
+
+  if (++*misses >= 64) {
+    nanosleep(&pause, NULL);
+    *misses = 0;
+  }
+}
+
+struct thread_run {
+  uint32 items;
+  bool spin;        // pause at random now and then, to shake the timing up
+  uint32 errors;
+};
+
+LOCAL void *producer(void *arg) {
+  struct thread_run *run = arg;
+  uint32 state = 0x9e3779b9;
+  uint32 i = 0, misses = 0;
+
+  while (i < run->items) {
+    if (test_ring_push(&ring, i))
+      i++;
+    else
+      backoff(&misses);
+    if (run->spin) {
+      state ^= state << 13;
+      state ^= state >> 17;
+      state ^= state << 5;
+      if ((state & 0xff) == 0) {
+        volatile uint32 n;
+        for (n = 0; n < (state >> 24); n++)
+          ;
+      }
+    }
+  }
+  return NULL;
+}
+
+LOCAL void consume(struct thread_run *run) {
+  uint32 out[BATCH_MAX];
+  uint32 expected = 0, misses = 0;
+
+  while (expected < run->items) {
+    uint32 n = test_ring_pop_batch(&ring, out, BATCH_MAX);
+    uint32 i;
+
+    if (n == 0)
+      backoff(&misses);
+    for (i = 0; i < n; i++) {
+      if (out[i] != expected && run->errors++ < 10)
+        fprintf(stderr, "spsc: got %u, expected %u\n", out[i], expected);
+      expected = out[i] + 1;
+    }
+  }
+}
+
+// Returns the seconds it took
+LOCAL double run_threads(struct thread_run *run) {
+  pthread_t thread;
+  double start;
+
+  test_ring_reset(&ring);
+  ring.head = ring.tail = 0xffffffff - RING_SIZE / 2;
+  start = now_s();
+  pthread_create(&thread, NULL, producer, run);
+  consume(run);
+  pthread_join(thread, NULL);
+  return now_s() - start;
+}
+
+LOCAL void test_threads(void) {
+  struct thread_run run = { THREAD_ITEMS, true, 0 };
+
+  run_threads(&run);
+  HOST_CHECK(run.errors == 0);
+  HOST_CHECK(test_ring_count(&ring) == 0);
+  printf("two threads: %u items, %u out of order or missing\n", THREAD_ITEMS, run.errors);
+}
+
+LOCAL void bench(void) {
+  struct thread_run run = { BENCH_ITEMS, false, 0 };
+  uint32 out[BATCH_MAX];
+  uint32 i, sum = 0;
+  double start, seconds;
+
+  // One thread: push a batch, pop it back
+  test_ring_reset(&ring);
+  start = now_s();
+  for (i = 0; i < BENCH_ITEMS; i += BATCH_MAX) {
+    uint32 j, n;
+
+    for (j = 0; j < BATCH_MAX; j++)
+      test_ring_push(&ring, i + j);
+    n = test_ring_pop_batch(&ring, out, BATCH_MAX);
+    for (j = 0; j < n; j++)
+      sum += out[j];
+  }
+  seconds = now_s() - start;
+  printf("bench, one thread: %.1f M items/s (checksum %08x)\n", BENCH_ITEMS / seconds / 1e6, sum);
+
+  seconds = run_threads(&run);
+  HOST_CHECK(run.errors == 0);
+  printf("bench, two threads: %.1f M items/s\n", BENCH_ITEMS / seconds / 1e6);
+}
+
+int main(void) {
+  test_interleaving();
+  test_threads();
+  bench();
+  if (host_failures != 0) {
+    printf("spsc test: %d checks failed\n", host_failures);
+    return 1;
+  }
+  printf("spsc test: all checks held\n");
+  return 0;
+}
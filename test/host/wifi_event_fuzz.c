@@ -0,0 +1,122 @@
+// libFuzzer target for the WiFi event handler (make fuzz).
+//
+// An input is a list of steps, 45 bytes each:
+//   byte 0      how long before the event, in 10ms steps (timers and tasks run
+//               in between, like on a unit)
+//   bytes 1-44  a System_Event_t, exactly the bytes the SDK would hand over
+// so event ids we don't handle, AIDs way out of range, a disconnect before its
+// connect, the same AID twice and so on all come up. The event goes to the
+// callback the firmware registered with wifi_set_event_handler_cb (the event
+// bus), the way the SDK delivers it.
+//
+// The firmware is user_main.c and the core modules with the default features of
+// user_config.h, booted fresh for every input. After every step, and once more
+// 10 seconds after the last one:
+//   - the handler's own checks (check_invariants) haven't failed
+//   - the status LED is busy (its timer armed or the connect sequence running)
+//     exactly when there are clients
+//   - no handler call took longer than HANDLER_LIMIT_US
+// Out of bounds accesses are ASan's and UBSan's job. A failed check aborts so
+// libFuzzer keeps the input.
+//
+// Built with -DFUZZ_STANDALONE (make host-test) there's no libFuzzer: main runs
+// every file on the command line through the same checks. That's how the seed
+// corpus in corpus/wifi_event gets run on every change. HOST_VERBOSE=1 in the
+// environment shows what the firmware prints.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "user_main.c"
+#include "sdk_stubs.h"
+
+#define STEP_BYTES          (1 + sizeof(System_Event_t))
+#define STEP_MS             10
+#define SETTLE_MS           10000
+// Real time on the PC, generous because of the sanitizers
+#define HANDLER_LIMIT_US    (10 * WIFI_HANDLER_BUDGET_US)
+
+_Static_assert(sizeof(System_Event_t) == 44, "System_Event_t doesn't match the SDK's");
+
+LOCAL void fail(uint32 step, const char *what) {
+  fprintf(stderr, "wifi event fuzz: step %u: %s (clients %d, AIDs 0x%08x, state %d)\n",
+          step, what, clients, client_aids, app_fsm_state());
+  abort();
+}
+
+LOCAL void check(uint32 step) {
+  if (handler_stats.invariant_failures != 0)
+    fail(step, "the handler's invariant check failed");
+  if ((clients > 0) != status_led_busy())
+    fail(step, clients > 0 ? "clients but the status LED is idle" : "no clients but the status LED is busy");
+  if (handler_stats.cycles_max / system_get_cpu_freq() > HANDLER_LIMIT_US)
+    fail(step, "handler too slow");
+}
+
+// Power on: user_init, then the SDK's init done callback
+LOCAL void boot(void) {
+  // What the last input left behind
+  stop_blinking();
+  coro_stop(&connect_coro);
+
+  host_reset();
+  client_aids = 0;
+  clients = 0;
+  refused_aids = 0;
+  os_bzero(&handler_stats, sizeof(handler_stats));
+  heap_min = 0;
+  softap_failed = false;
+  ap_started = false;
+
+  user_init();
+  host_run_tasks();
+  host_init_done_cb();
+  host_run_tasks();
+}
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+  System_Event_t event;
+  uint32 step;
+
+  boot();
+  if (host_event_cb == NULL || app_fsm_state() != APP_AP_IDLE)
+    fail(0, "didn't boot");
+
+  for (step = 0; (step + 1) * STEP_BYTES <= size; step++) {
+    const uint8_t *p = data + step * STEP_BYTES;
+
+    host_advance_ms(p[0] * STEP_MS);
+    os_memcpy(&event, p + 1, sizeof(event));
+    host_event_cb(&event);
+    host_run_tasks();
+    check(step);
+  }
+
+  host_advance_ms(SETTLE_MS);
+  check(step);
+  return 0;
+}
+
+#ifdef FUZZ_STANDALONE
+
+int main(int argc, char **argv) {
+  static uint8_t data[1 << 16];
+  int i;
+
+  host_verbose = getenv("HOST_VERBOSE") != NULL;
+  for (i = 1; i < argc; i++) {
+    FILE *f = fopen(argv[i], "rb");
+    size_t size;
+
+    if (f == NULL) {
+      perror(argv[i]);
+      return 1;
+    }
+    size = fread(data, 1, sizeof(data), f);
+    fclose(f);
+    LLVMFuzzerTestOneInput(data, size);
+  }
+  printf("wifi event fuzz: %d inputs, all checks held\n", argc - 1);
+  return 0;
+}
+
+#endif
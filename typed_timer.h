@@ -0,0 +1,26 @@
+// Typed os_timer callbacks. os_timer_setfn takes a void (*)(void *) and we used
+// to cast whatever function we had to that, which means the compiler can't tell us
+// when the callback and its argument don't match. TYPED_TIMER_SETFN does the same
+// thing but first checks (at compile time) that fn takes exactly the type of ctx.
+//
+//   LOCAL void blink_step(struct led_blink *b);
+//   TYPED_TIMER_SETFN(&b->timer, blink_step, b);      // fine
+//   TYPED_TIMER_SETFN(&b->timer, blink_step, NULL);   // compile error
+//
+// For callbacks that don't need a context, declare them with a void *arg and
+// pass NULL.
+
+#ifndef TYPED_TIMER_H
+#define TYPED_TIMER_H
+
+#include "osapi.h"
+
+#define TYPED_TIMER_SETFN(timer, fn, ctx)                                        \
+  do {                                                                           \
+    _Static_assert(__builtin_types_compatible_p(__typeof__(&(fn)),              \
+                                                void (*)(__typeof__(ctx))),      \
+                   "timer callback " #fn " doesn't take a " #ctx);               \
+    os_timer_setfn((timer), (os_timer_func_t *)(fn), (void *)(ctx));             \
+  } while (0)
+
+#endif
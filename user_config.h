@@ -0,0 +1,235 @@
+// Project wide configuration. Everything that you might want to tweak for a
+// particular unit lives here instead of being buried in the source files.
+
+#ifndef USER_CONFIG_H
+#define USER_CONFIG_H
+
+//
+// Features
+//
+// Which optional subsystems go into the image. The Makefile decides this (for
+// example "make FEATURE_IR_TX=1 FEATURE_TELEMETRY=0"): it only compiles and links
+// the sources of the features that are on and passes the same choice to the
+// compiler as -DFEATURE_...=1 or 0. The defaults below only matter if a file gets
+// compiled some other way, and they match the Makefile's.
+#ifndef FEATURE_LOGIC_CAPTURE
+#define FEATURE_LOGIC_CAPTURE          0    // logic analyzer capture
+#endif
+#ifndef FEATURE_FREQ_CAPTURE
+#define FEATURE_FREQ_CAPTURE           0    // frequency / pulse width capture
+#endif
+#ifndef FEATURE_ADC_LIGHT
+#define FEATURE_ADC_LIGHT              0    // ambient light dimming of the status LED
+#endif
+#ifndef FEATURE_HSPI_OUT
+#define FEATURE_HSPI_OUT               0    // LED panel on the HSPI
+#endif
+#ifndef FEATURE_IR_TX
+#define FEATURE_IR_TX                  0    // IR transmitter
+#endif
+#ifndef FEATURE_STATS
+#define FEATURE_STATS                  1    // WiFi event statistics
+#endif
+#ifndef FEATURE_TELEMETRY
+#define FEATURE_TELEMETRY              1    // print the reports every 30 seconds
+#endif
+#ifndef FEATURE_IMAGE_CRC
+#define FEATURE_IMAGE_CRC              0    // CRC the firmware once the softAP is up
+#endif
+#ifndef FEATURE_FLASH_BENCH
+#define FEATURE_FLASH_BENCH            0    // time calls into flash once the softAP is up
+#endif
+#ifndef FEATURE_EVENT_TRACE
+#define FEATURE_EVENT_TRACE            0    // record or replay WiFi event traces
+#endif
+#ifndef FEATURE_POST
+#define FEATURE_POST                   0    // power-on self test of GPIO2, timers and flash
+#endif
+#ifndef FEATURE_SOFTAP_BENCH
+#define FEATURE_SOFTAP_BENCH           0    // try softAP settings once it's up and time the clients
+#endif
+#ifndef FEATURE_MAC_FILTER
+#define FEATURE_MAC_FILTER             0    // only let the stations in mac_filter_list.h be clients
+#endif
+#ifndef FEATURE_CAPTIVE_DNS
+#define FEATURE_CAPTIVE_DNS            0    // answer every DNS query with the softAP address
+#endif
+#ifndef FEATURE_NET_BENCH
+#define FEATURE_NET_BENCH              0    // UDP and TCP sinks on port 5001 to measure throughput
+#endif
+#ifndef FEATURE_CTRL_UDP
+#define FEATURE_CTRL_UDP               0    // UDP control service on port 4210
+#endif
+
+//
+// Logic analyzer capture (logic_capture.c)
+//
+// With FEATURE_LOGIC_CAPTURE a capture starts once the softAP is up.
+// We sample LOGIC_CAPTURE_CHANNELS neighbouring GPIOs starting at
+// LOGIC_CAPTURE_FIRST_GPIO. Channels must be 1, 2, 4 or 8 so that a sample never
+// straddles two bytes of the buffer.
+#define LOGIC_CAPTURE_FIRST_GPIO       4
+#define LOGIC_CAPTURE_CHANNELS         2
+#define LOGIC_CAPTURE_BUFFER_BYTES     4096
+#define LOGIC_CAPTURE_RATE_HZ          100000
+#define LOGIC_CAPTURE_TRIGGER          LOGIC_CAPTURE_TRIGGER_RISING
+#define LOGIC_CAPTURE_TRIGGER_CHANNEL  0
+#define LOGIC_CAPTURE_OUTPUT           LOGIC_CAPTURE_OUT_UDP
+// Where the UDP stream goes ... the first client on the softAP usually gets 192.168.4.2
+#define LOGIC_CAPTURE_UDP_IP           192, 168, 4, 2
+#define LOGIC_CAPTURE_UDP_PORT         5000
+// Bytes sent per batch and the pause (ms) between batches
+#define LOGIC_CAPTURE_BATCH_BYTES      1024
+#define LOGIC_CAPTURE_BATCH_MS         5
+
+//
+// Frequency / pulse width capture (freq_capture.c)
+//
+// FREQ_CAPTURE_PINS is the list of GPIOs to watch (4, 5, 12, 13 or 14).
+// FREQ_CAPTURE_RING_SIZE is the number of edges buffered per pin and has to be a
+// power of two. The stats window is FREQ_CAPTURE_WINDOW_MS long.
+#define FREQ_CAPTURE_PINS              { 5 }
+#define FREQ_CAPTURE_RING_SIZE         64
+#define FREQ_CAPTURE_WINDOW_MS         1000
+
+//
+// Ambient light adaptive LED brightness (adc_light.c)
+//
+// With FEATURE_ADC_LIGHT the LED on GPIO2 is driven by the sigma-delta modulator
+// so it can be dimmed. ADC_LIGHT_TRIM samples are dropped from each end of a
+// sorted burst before averaging. Brightness only follows the light once the
+// reading has moved by ADC_LIGHT_HYSTERESIS counts (out of 1023).
+#define ADC_LIGHT_PERIOD_MS            500
+#define ADC_LIGHT_BURST                32
+#define ADC_LIGHT_TRIM                 8
+#define ADC_LIGHT_CLK_DIV              8
+#define ADC_LIGHT_HYSTERESIS           24
+#define ADC_LIGHT_MIN_BRIGHTNESS       8
+#define ADC_LIGHT_MAX_BRIGHTNESS       255
+#define ADC_LIGHT_SIGMA_DELTA_PRESCALE 16
+
+//
+// HSPI LED panel output (hspi_out.c)
+//
+// HSPI_OUT_DEVICE is HSPI_OUT_74HC595 or HSPI_OUT_MAX7219 and HSPI_OUT_CHAIN is
+// the number of chips in the chain. The SPI clock is 80MHz / PREDIV / CNT
+// (10MHz is the most a MAX7219 will take). HSPI_OUT_INTENSITY is 0 - 15 and only
+// matters for the MAX7219.
+#define HSPI_OUT_DEVICE                HSPI_OUT_74HC595
+#define HSPI_OUT_CHAIN                 4
+#define HSPI_OUT_CLK_PREDIV            2
+#define HSPI_OUT_CLK_CNT               4
+#define HSPI_OUT_INTENSITY             4
+
+//
+// IR transmitter (ir_tx.c)
+//
+// With FEATURE_IR_TX the unit sends IR_TX_CONNECT_CODE (from ir_codes.h) every
+// time a client connects to the softAP.
+#define IR_TX_PIN                      4
+#define IR_TX_CARRIER_HZ               38000
+#define IR_TX_CONNECT_CODE             ir_code_nec_00_45
+
+//
+// WiFi event handler (user_main.c)
+//
+// A handler call that takes longer than this counts as slow (see handler_report)
+#define WIFI_HANDLER_BUDGET_US         1000
+
+//
+// Coroutines (coro.c)
+//
+// With CORO_BENCH_STEPS > 0 the unit times that many steps through a coroutine
+// and through a plain callback once the softAP is up, and prints both.
+#define CORO_BENCH_STEPS               0
+
+//
+// Long running jobs (slice_sched.c)
+//
+// A job gets SLICE_SCHED_SLICE_US of CPU at a time before the SDK gets a turn.
+// Keep it to a few milliseconds or the WiFi suffers.
+#define SLICE_SCHED_SLICE_US           2000
+
+//
+// Flash benchmark (flash_bench.c)
+//
+// How many times each flash function gets timed, cold and warm
+#define FLASH_BENCH_ROUNDS             16
+
+//
+// Periodic tasks (rate_exec.c)
+//
+// RATE_EXEC_BUDGET_US is how long the work in one 20ms tick may take before it
+// counts as an overrun. The telemetry doesn't count, it's deferred to the
+// background task (see rate_exec.h).
+#define RATE_EXEC_BUDGET_US            4000
+
+//
+// Task queues (tasks.c)
+//
+// How many posts each of the three SDK task queues can hold. A post that doesn't
+// fit isn't lost, it gets merged with the next one (and counted as "full").
+#define TASK_QUEUE_URGENT              8
+#define TASK_QUEUE_NORMAL              8
+#define TASK_QUEUE_BACKGROUND          2
+
+//
+// WiFi event traces (event_trace.c)
+//
+// EVENT_TRACE_RECORD prints every WiFi event once the softAP is up,
+// EVENT_TRACE_REPLAY plays the trace in event_traces.h back instead,
+// EVENT_TRACE_REPLAY_SPEED times faster than it happened (1 is real time).
+// A replay runs the real handlers: the state machine, the LED, the stats and
+// the MAC filter all see the replayed clients, so look at the numbers after a
+// replay with that in mind (or reboot). Real WiFi events are dropped while it
+// runs, so replay with nobody connected, and the MAC filter doesn't deauth
+// anybody for a replayed event.
+#define EVENT_TRACE_MODE               EVENT_TRACE_RECORD
+#define EVENT_TRACE_REPLAY_SPEED       10
+
+//
+// softAP settings (init_done_callback, softap_tune.c)
+//
+// What the softAP boots with. softap_tune_apply can change them later without a
+// reboot. A longer beacon interval saves a bit of power but clients take longer to
+// find us, and a hidden SSID only works for clients that already know it.
+#define SOFTAP_MAX_CONNECTION          4      // 1 - 8
+#define SOFTAP_BEACON_INTERVAL         100    // ms, 100 - 60000
+#define SOFTAP_HIDDEN                  0
+#define SOFTAP_CHANNEL                 1      // 1 - 13
+// If the SDK won't take these at boot the unit blinks fast (DEGRADED) and tries
+// again every 10s (rate_task_stations) until it does.
+
+//
+// Power saving (power.c)
+//
+// With nobody connected for POWER_IDLE_SLEEP_S seconds (0 = never) the LED goes
+// off and the TX power goes down to POWER_SLEEP_TPW until a probe request or a
+// client shows up. TX power is in 0.25dBm steps, 0 - 82 (82 = 20.5dBm, the most
+// the SDK does).
+#define POWER_IDLE_SLEEP_S             120
+#define POWER_SLEEP_TPW                40
+#define POWER_FULL_TPW                 82
+
+//
+// MAC filter (mac_filter.c)
+//
+// MAC_FILTER_ALLOW: only the stations in mac_filter_list.h count as clients.
+// MAC_FILTER_DENY: everybody except them does.
+// A station that doesn't count gets kicked (MAC_FILTER_DEAUTH) or stays connected
+// but doesn't make the LED blink (MAC_FILTER_IGNORE).
+// With MAC_FILTER_BENCH_LOOKUPS > 0 the unit times that many lookups in a 10000
+// MAC list once the softAP is up (the list costs 80KB of flash).
+#define MAC_FILTER_MODE                MAC_FILTER_ALLOW
+#define MAC_FILTER_ACTION              MAC_FILTER_DEAUTH
+#define MAC_FILTER_BENCH_LOOKUPS       0
+
+//
+// UDP control service (ctrl_udp.c)
+//
+// With CTRL_UDP_ESPCONN_BENCH 1 the same service also runs through espconn on the
+// next port up, to compare the two (send the same requests to both and ask
+// either one for "bench").
+#define CTRL_UDP_ESPCONN_BENCH         0
+
+#endif
@@ -28,6 +28,31 @@
 // os_type.h: this includes our defines for signal, event, and timer types 
 // user_interfaces.h: this gets us the flash maps and the System_Event_t struct
 // c_types.h: Also gets us the flash maps and all kinds of other attributes
+// logic_capture.h: our logic analyzer capture mode (see user_config.h to turn it on)
+// freq_capture.h: frequency and pulse width measurement on GPIO inputs
+// adc_light.h: ambient light measurement that sets the LED brightness
+// sigma_delta.h: the sigma-delta modulator we use to dim the LED
+// hspi_out.h: shift register / LED matrix panels on the HSPI
+// ir_tx.h and ir_codes.h: the IR transmitter and the codes it can send
+// typed_timer.h: os_timer_setfn with a compile time check of the callback type
+// led_blink.h: blinks any number of LEDs from a pool of timers
+// event_bus.h: passes each WiFi event on to everybody that wants it
+// app_fsm.h: the softAP lifecycle state machine that decides what we do when WiFi things happen
+// tasks.h: the three SDK task priorities and who runs on them
+// coro.h: coroutines, so a sequence of steps can be written one after the other
+// slice_sched.h: runs long jobs a slice at a time so the WiFi doesn't starve
+// image_crc.h: one of those jobs, the CRC of our own firmware
+// flash_bench.h: another one, times calls into flash for the flash mode we run in
+// event_trace.h and event_traces.h: records WiFi events, or plays recorded ones back
+// post.h: the power-on self test
+// ctrl_udp.h: the UDP control service (ping, stats, softAP settings, MAC filter)
+// net_bench.h: UDP and TCP sinks to measure throughput with iperf
+// captive_dns.h: answers every DNS lookup from our clients with our own address
+// mac_filter.h: which stations are allowed to be our clients
+// softap_tune.h and softap_bench.h: change the softAP settings on the fly, and try a bunch of them
+// rate_exec.h: the one timer that runs everything periodic (LED panel, stats, reports)
+// wifi_stats.h: counts of WiFi events and clients for the reports
+// ccount.h: the CPU cycle counter, to time the WiFi event handler
 
 #include "credentials.h"
 #include "ets_sys.h"
@@ -37,6 +62,35 @@
 #include "user_config.h"
 #include "user_interface.h"
 #include "c_types.h"
+#include "logic_capture.h"
+#include "freq_capture.h"
+#include "adc_light.h"
+#include "sigma_delta.h"
+#include "hspi_out.h"
+#include "ir_tx.h"
+#include "ir_codes.h"
+#include "typed_timer.h"
+#include "led_blink.h"
+#include "event_bus.h"
+#include "app_fsm.h"
+#include "tasks.h"
+#include "coro.h"
+#include "slice_sched.h"
+#include "image_crc.h"
+#include "flash_bench.h"
+#include "event_trace.h"
+#include "event_traces.h"
+#include "post.h"
+#include "softap_tune.h"
+#include "softap_bench.h"
+#include "mac_filter.h"
+#include "captive_dns.h"
+#include "net_bench.h"
+#include "ctrl_udp.h"
+#include "rate_exec.h"
+#include "wifi_stats.h"
+#include "power.h"
+#include "ccount.h"
 
 // RF Pre-Init function ... according to SDK API reference this needs to be
 // in user_main.c even though we aren't using it.  It can be used to set RF
@@ -93,23 +147,53 @@ uint32 ICACHE_FLASH_ATTR user_rf_cal_sector_set(void)
 // access it outside this source file.
 LOCAL void init_done_callback(void);
 
-// Declare the WiFi event handler callback function. This is the function
-// that will execute when the SoC detects a WiFi event. We will evaluate
-// the event and if it is a connection we will kick off our timer.
-// Yes the System_Event_t type is mixed case it's defined that way in user_interface.h.
-LOCAL void wifi_event_handler_callback(System_Event_t *event);
-
-// Declare the timer function
-LOCAL void timer_function (void);
-
-// Create the software timer
-LOCAL os_timer_t the_timer;
-
-// Define the system init done callback function. Inside this function setup the WiFi.
-// Why are we using a callback function for this??? Because it allows the SoC
-// time to get everything setup!
-// Once the WiFi setup is complete then register the WiFi event handler callback function.
-LOCAL void init_done_callback (void) {
+// No software timers of our own in here anymore. The status LED gets one from
+// the led_blink pool and everything periodic runs off the rate_exec tick (see the
+// rate_task_ functions at the bottom).
+
+// The status LED on GPIO2 (NULL while it isn't blinking) and its patterns.
+// A pattern step is 1 = on, 0 = off.
+LOCAL struct led_blink *status_led;
+LOCAL const uint8 blink_pattern[] = { 1, 0 };
+LOCAL const uint8 hello_pattern[] = { 1, 0, 1, 0, 1, 0 };
+
+// The coroutine that greets a new client, and the event it waits for
+LOCAL struct coro connect_coro;
+#define CORO_EV_DHCP  BIT0   // the DHCP server gave a client an address
+
+// Clients connected to our AP right now, by AID (bit n set = the station with
+// AID n is here) and how many that is. Counting AIDs instead of just events means
+// a duplicate connect or a disconnect we never saw the connect for can't throw
+// the count off.
+LOCAL uint32 client_aids;
+LOCAL uint8 clients;
+
+// Stations the MAC filter turned away, by AID, so their disconnect (and their
+// DHCP) don't look like one of our clients
+LOCAL uint32 refused_aids;
+
+// Odd things the WiFi event handler has seen, and checks that failed
+LOCAL struct {
+  uint32 duplicate_connects;    // connect for an AID that's already here
+  uint32 unknown_disconnects;   // disconnect for an AID that isn't
+  uint32 bad_aids;              // AID too big for client_aids
+  uint32 refused;               // stations the MAC filter turned away
+  uint32 invariant_failures;
+  uint32 slow;                  // handler took longer than WIFI_HANDLER_BUDGET_US
+  uint32 cycles_max;
+} handler_stats;
+
+// Lowest free heap we've seen (sampled once a second)
+LOCAL uint32 heap_min;
+
+// The SDK didn't take our softAP config (rate_task_stations tries again), and
+// whether app_action_ap_up has started everything yet
+LOCAL bool softap_failed;
+LOCAL bool ap_started;
+
+// Set up the softAP from WIFI_SSID and the settings in user_config.h. Returns
+// false if the SDK won't take it.
+LOCAL bool ICACHE_FLASH_ATTR softap_configure(void) {
 
   char const *SSID = WIFI_SSID;
   char const *PASSWORD = WIFI_PASSWORD;
@@ -130,56 +214,438 @@ LOCAL void init_done_callback (void) {
   os_bzero(&config.password, 64);
   os_memcpy(&config.password, PASSWORD, 10);
   config.authmode = AUTH_WPA2_PSK;
-  wifi_softap_set_config(&config);
 
-  // Now register the WiFi event handler callback function. The SoC will call this
-  // function (wifi_event_handler_callback) when it detects a WiFi event. We've got
-  // code in wifi_event_handler_callback) to check the type of event and if it is
-  // a connection event then we will kick off the timer.
-  wifi_set_event_handler_cb(wifi_event_handler_callback);
+  // And the rest of the settings from user_config.h instead of whatever the SDK
+  // has saved from some earlier firmware (softap_tune can change them later)
+  config.max_connection = SOFTAP_MAX_CONNECTION;
+  config.beacon_interval = SOFTAP_BEACON_INTERVAL;
+  config.ssid_hidden = SOFTAP_HIDDEN;
+  config.channel = SOFTAP_CHANNEL;
+
+  return wifi_softap_set_config(&config);
+}
+
+// Define the system init done callback function. Inside this function setup the WiFi.
+// Why are we using a callback function for this??? Because it allows the SoC
+// time to get everything setup!
+// Once the WiFi setup is complete then register the WiFi event handler callback function.
+LOCAL void init_done_callback (void) {
+
+  // Now register the event bus as the WiFi event handler callback function. The SoC
+  // will call event_bus_dispatch when it detects a WiFi event and the bus passes it
+  // on to everybody that subscribed (see the table in event_bus.c). One of them is
+  // our wifi_event_handler_callback, which turns the WiFi events into state machine
+  // events.
+  wifi_set_event_handler_cb(event_bus_dispatch);
+
+  // Tell the state machine the AP is up ... or that it isn't (then
+  // rate_task_stations keeps trying and tells it when it worked)
+  softap_failed = !softap_configure();
+  app_fsm_dispatch(softap_failed ? APP_EV_FAULT : APP_EV_INIT_DONE);
+
+}
 
+LOCAL bool status_led_busy(void);
+
+// Is this station one the MAC filter turns away? If so kick it off (unless the
+// filter is set to just ignore it). Never with the filter left out, and never
+// for a replayed event: that MAC isn't connected, or it's a real client.
+LOCAL bool ICACHE_FLASH_ATTR station_refused(uint8 *mac) {
+#if FEATURE_MAC_FILTER
+  if (mac_filter_allowed(mac))
+    return false;
+#if MAC_FILTER_ACTION == MAC_FILTER_DEAUTH
+#if FEATURE_EVENT_TRACE
+  if (!event_trace_replaying())
+#endif
+    wifi_softap_deauth(mac);
+#endif
+  return true;
+#else
+  return false;
+#endif
 }
 
-// Define the WiFi event handler callback f unction. This is where we'll wait for an event.
-// Once we have the event we will evaluate and if it is a WiFi connection event, we will 
-// setup our timer and arm the timer. It (the timer that is) will then flash 
-// an LED once per second to indicate that a client is connected to our ESP AP. Don't forget to 
-// use os_delay_us to give the SoC time to do other stuff!
+// Things that must be true after every WiFi event. If one isn't, say so (once
+// per event) and count it.
+LOCAL void ICACHE_FLASH_ATTR check_invariants(uint32 event) {
+  const char *failed = NULL;
+  uint8 state = app_fsm_state();
+
+  if (clients != __builtin_popcount(client_aids))
+    failed = "client count doesn't match the AIDs";
+  else if (state == APP_SERVING && clients == 0)
+    failed = "serving nobody";
+  else if (state == APP_SERVING && !status_led_busy())
+    failed = "serving but the status LED isn't blinking";
+  else if (state == APP_AP_IDLE && status_led_busy())
+    failed = "idle but the status LED is blinking";
+  else if (state == APP_SLEEPING && clients != 0)
+    failed = "sleeping with clients";
+
+  if (failed != NULL) {
+    handler_stats.invariant_failures++;
+    os_printf("wifi handler: after event %u: %s\n", event, failed);
+  }
+}
+
+// Define the WiFi event handler callback f unction. It's declared in event_bus.h because
+// it's a static subscriber of the event bus (so it can't be LOCAL).
+// We don't decide anything in here anymore ... we just turn the WiFi event into a
+// state machine event and let the transition table (app_fsm.c) pick the action.
+// The SDK doesn't promise the events make sense (a station can drop out before we
+// heard it connect, or show up twice) so we check the AID before we count.
+// Don't forget to use os_delay_us to give the SoC time to do other stuff!
 // Yes ... the System_Event_t type is mixed case ... it's defined that way in user_interface.h.
-LOCAL void ICACHE_FLASH_ATTR wifi_event_handler_callback(System_Event_t *event) {
+void ICACHE_FLASH_ATTR wifi_event_handler_callback(System_Event_t *event) {
+  uint32 start = get_ccount();
+  uint32 aid;
 
   switch (event->event) {
     case EVENT_SOFTAPMODE_STACONNECTED:
-      // Disarm the timer ... it takes a pointer so pass the address of the_timer
-      os_timer_disarm(&the_timer);
-
-      // Setup the timer ... the timer will call timer_function when it runs
-      // Pass timer_function to the procedure by casting it as a pointer to a timer function
-      // Our timer_function doesn't take any parameters so use NULL as the last argument
-      os_timer_setfn(&the_timer, (os_timer_func_t *)timer_function, NULL);
-
-      // Arm the timer ... 1000ms = 1 second and 1 means it repeats
-      // Our timer will kick off every second and run the function bound to it in the above
-      // statement (os_timer_setfn)
-      os_timer_arm(&the_timer, 1000, 1);
+      aid = event->event_info.sta_connected.aid;
+      if (aid >= 32) {
+        handler_stats.bad_aids++;
+        break;
+      }
+      if (client_aids & BIT(aid)) {
+        handler_stats.duplicate_connects++;
+        break;
+      }
+      if (station_refused(event->event_info.sta_connected.mac)) {
+        refused_aids |= BIT(aid);
+        handler_stats.refused++;
+        break;
+      }
+      refused_aids &= ~BIT(aid);
+      client_aids |= BIT(aid);
+      clients++;
+      app_fsm_dispatch(APP_EV_STA_CONNECTED);
+      break;
+
+    case EVENT_SOFTAPMODE_STADISCONNECTED:
+      aid = event->event_info.sta_disconnected.aid;
+      if (aid >= 32) {
+        handler_stats.bad_aids++;
+        break;
+      }
+      if (refused_aids & BIT(aid)) {
+        refused_aids &= ~BIT(aid);
+        break;
+      }
+      if (!(client_aids & BIT(aid))) {
+        handler_stats.unknown_disconnects++;
+        break;
+      }
+      client_aids &= ~BIT(aid);
+      clients--;
+      app_fsm_dispatch(clients == 0 ? APP_EV_NO_CLIENTS : APP_EV_STA_LEFT);
+      break;
+
+    case EVENT_SOFTAPMODE_DISTRIBUTE_STA_IP:
+      aid = event->event_info.distribute_sta_ip.aid;
+      if (aid < 32 && (refused_aids & BIT(aid)))
+        break;
+      coro_signal(CORO_EV_DHCP);
+      break;
+
+    default:
+      // Not one of ours (the event bus shouldn't send us these)
       break;
   }
 
+  check_invariants(event->event);
+
   os_delay_us(100);
 
+  start = get_ccount() - start;
+  if (start > handler_stats.cycles_max)
+    handler_stats.cycles_max = start;
+  if (start > WIFI_HANDLER_BUDGET_US * system_get_cpu_freq())
+    handler_stats.slow++;
 }
- 
-// Define the timer function ... read the status of GPIO2 ... if it is HIGH set it
-// to LOW and vice versa. Don't forget the os_delay_us to allow the SoC
-// time to do other functions!
-LOCAL void timer_function (void) {
-  if (GPIO_REG_READ(GPIO_OUT_ADDRESS) & BIT2)
-    gpio_output_set(0, BIT2, BIT2, 0);
-  else
-    gpio_output_set(BIT2, 0, BIT2, 0);
-  os_delay_us(100);
+
+// What the WiFi event handler has put up with so far
+LOCAL void ICACHE_FLASH_ATTR handler_report(void) {
+  os_printf("wifi handler: %d clients (AIDs 0x%08x), %u duplicate connects, %u unknown disconnects, "
+            "%u bad AIDs, %u refused, %u failed checks, %u slow, max %u us\n",
+            clients, client_aids, handler_stats.duplicate_connects, handler_stats.unknown_disconnects,
+            handler_stats.bad_aids, handler_stats.refused, handler_stats.invariant_failures, handler_stats.slow,
+            handler_stats.cycles_max / system_get_cpu_freq());
+}
+
+// Is the status LED doing anything (blinking, or the connect sequence running)?
+LOCAL bool ICACHE_FLASH_ATTR status_led_busy(void) {
+  return status_led != NULL || coro_running(&connect_coro);
+}
+
+// Stop blinking the status LED and leave it off
+LOCAL void ICACHE_FLASH_ATTR stop_blinking(void) {
+  led_blink_stop(status_led);
+  status_led = NULL;
+}
+
+// Start (or restart) playing a pattern on the status LED, step_ms per step. If the
+// LED is dimmed by the ambient light, GPIO2 belongs to the sigma-delta modulator and
+// the blinker takes care of setting the brightness.
+LOCAL void ICACHE_FLASH_ATTR start_pattern(const uint8 *pattern, uint8 length, uint32 step_ms) {
+  stop_blinking();
+#if FEATURE_ADC_LIGHT
+  status_led = led_blink_start(BIT2, pattern, length, step_ms, adc_light_brightness);
+#else
+  status_led = led_blink_start(BIT2, pattern, length, step_ms, NULL);
+#endif
+}
+
+// Plain blink, toggling every period_ms
+LOCAL void ICACHE_FLASH_ATTR start_blinking(uint32 period_ms) {
+  start_pattern(blink_pattern, sizeof(blink_pattern), period_ms);
+}
+
+// What we do when a client connects, step by step: blink 3 times fast, wait for
+// the DHCP server to give the client an address (5 seconds at most, some clients
+// use a static IP) and then blink once per second for as long as it stays.
+// Remember: no local variables across the CORO_ lines (see coro.h).
+LOCAL uint8 ICACHE_FLASH_ATTR connect_sequence(struct coro *c) {
+  CORO_BEGIN(c);
+
+  start_pattern(hello_pattern, sizeof(hello_pattern), 100);
+  CORO_AWAIT_TIMER(c, sizeof(hello_pattern) * 100);
+  stop_blinking();
+
+  CORO_WAIT(c, CORO_EV_DHCP, 5000);
+  if (c->events == 0)
+    os_printf("connect: no DHCP request, client has a static IP?\n");
+
+  start_blinking(1000);
+  CORO_END(c);
+}
+
+// State machine actions (the table in app_fsm.c says when each one runs)
+
+// BOOTING -> AP_IDLE: the softAP is configured. Starts everything that needs the
+// softAP, once (the services keep running through a fault and a recovery).
+void ICACHE_FLASH_ATTR app_action_ap_up(void) {
+  // Nobody here yet: count down to sleep
+  power_idle();
+
+  if (ap_started)
+    return;
+  ap_started = true;
+
+  // If this unit is set up as a logic analyzer then start sampling now that the
+  // WiFi is up (we need it to stream the capture out over UDP).
+#if FEATURE_LOGIC_CAPTURE
+  logic_capture_init();
+  logic_capture_start(LOGIC_CAPTURE_RATE_HZ, LOGIC_CAPTURE_TRIGGER);
+#endif
+
+  // How much does a coroutine step cost compared to a plain callback?
+  coro_bench(CORO_BENCH_STEPS);
+
+  // Check the firmware (in the background, it takes a while)
+#if FEATURE_IMAGE_CRC
+  image_crc_start();
+#endif
+
+  // How fast is code in flash with the flash mode and clock of this image?
+#if FEATURE_FLASH_BENCH
+  flash_bench_start();
+#endif
+
+  // Print the WiFi events as they come, or play a recorded trace back through
+  // the handler (see user_config.h)
+#if FEATURE_EVENT_TRACE
+#if EVENT_TRACE_MODE == EVENT_TRACE_REPLAY
+  event_trace_replay(trace_two_clients, sizeof(trace_two_clients) / sizeof(trace_two_clients[0]),
+                     EVENT_TRACE_REPLAY_SPEED);
+#else
+  event_trace_record_start();
+#endif
+#endif
+
+  // Point every name our clients look up at us
+#if FEATURE_CAPTIVE_DNS
+  captive_dns_start();
+#endif
+
+  // Take commands over UDP
+#if FEATURE_CTRL_UDP
+  ctrl_udp_start();
+#endif
+
+  // Open the throughput sinks for iperf
+#if FEATURE_NET_BENCH
+  net_bench_start();
+#endif
+
+  // How long does a MAC filter lookup take with a big list?
+#if FEATURE_MAC_FILTER
+  mac_filter_bench(MAC_FILTER_BENCH_LOOKUPS);
+#endif
+
+  // Try the softAP settings in softap_bench.c one after the other
+#if FEATURE_SOFTAP_BENCH
+  softap_bench_start();
+#endif
+}
+
+// A client connected: run the connect sequence (ends up blinking once per second
+// to show somebody is connected to our ESP AP)
+void ICACHE_FLASH_ATTR app_action_client_joined(void) {
+  power_awake();
+  coro_start(&connect_coro, connect_sequence);
+
+  // Tell the IR devices nearby (if this unit has an IR LED)
+#if FEATURE_IR_TX
+  ir_tx_send(IR_TX_CONNECT_CODE, sizeof(IR_TX_CONNECT_CODE) / sizeof(uint16));
+#endif
+}
+
+// The last client left: nothing to show, count down to sleep
+void ICACHE_FLASH_ATTR app_action_all_left(void) {
+  coro_stop(&connect_coro);
+  stop_blinking();
+  power_idle();
+}
+
+// Something went wrong: blink fast so somebody notices (and don't go to sleep on
+// them)
+void ICACHE_FLASH_ATTR app_action_degraded(void) {
+  power_awake();
+  coro_stop(&connect_coro);
+  start_blinking(200);
 }
 
+// DEGRADED -> AP_IDLE: the softAP took its config after all. Stop the fast blink
+// and do what we would have done at boot.
+void ICACHE_FLASH_ATTR app_action_recovered(void) {
+  coro_stop(&connect_coro);
+  stop_blinking();
+  app_action_ap_up();
+}
+
+// Nobody came for POWER_IDLE_SLEEP_S: LED off, TX power down
+void ICACHE_FLASH_ATTR app_action_sleep(void) {
+  coro_stop(&connect_coro);
+  stop_blinking();
+  power_sleep();
+}
+
+// SLEEPING -> AP_IDLE: somebody is looking for networks. Full power so they find
+// us, and start counting down again.
+void ICACHE_FLASH_ATTR app_action_wake(void) {
+  power_idle();
+}
+
+// Periodic tasks (the schedule in rate_exec.c says how often each one runs)
+
+// 50Hz: push out whatever rows of the LED panel changed. No ICACHE_FLASH_ATTR,
+// this runs a lot.
+void rate_task_panel(void) {
+#if FEATURE_HSPI_OUT
+  hspi_out_tick();
+#endif
+}
+
+// 1Hz: keep track of the free heap low water mark
+void ICACHE_FLASH_ATTR rate_task_stats(void) {
+  uint32 heap = system_get_free_heap_size();
+
+  if (heap_min == 0 || heap < heap_min)
+    heap_min = heap;
+}
+
+// Every 10s: ask the softAP how many stations it has and complain if that's not
+// what the events told us. (No RSSI here ... in softAP mode the SDK doesn't
+// tell us the RSSI of the stations.) Stations the MAC filter ignored are still
+// connected as far as the softAP is concerned.
+// If the softAP config failed at boot, try it again instead (there is no softAP
+// to ask) and tell the state machine once it worked.
+void ICACHE_FLASH_ATTR rate_task_stations(void) {
+  uint8 stations;
+  uint8 expected;
+
+  if (softap_failed) {
+    softap_failed = !softap_configure();
+    if (!softap_failed)
+      app_fsm_dispatch(APP_EV_RECOVERED);
+    return;
+  }
+
+  stations = wifi_softap_get_station_num();
+  expected = clients + __builtin_popcount(refused_aids);
+  if (stations != expected)
+    os_printf("stations: softAP says %d, we counted %d\n", stations, expected);
+}
+
+// Every 30s: the reports
+void ICACHE_FLASH_ATTR rate_task_telemetry(void) {
+#if FEATURE_TELEMETRY
+  os_printf("heap: %u free, %u lowest\n", system_get_free_heap_size(), heap_min);
+#if FEATURE_STATS
+  wifi_stats_report();
+#endif
+  event_bus_report();
+  handler_report();
+  app_fsm_report();
+  power_report();
+#if FEATURE_MAC_FILTER
+  mac_filter_report();
+#endif
+#if FEATURE_CAPTIVE_DNS
+  captive_dns_report();
+#endif
+#if FEATURE_NET_BENCH
+  net_bench_report();
+#endif
+#if FEATURE_CTRL_UDP
+  ctrl_udp_report();
+#endif
+#if FEATURE_HSPI_OUT
+  hspi_out_report();
+#endif
+#if FEATURE_IR_TX
+  ir_tx_report();
+#endif
+#if FEATURE_ADC_LIGHT
+  adc_light_report();
+#endif
+#if FEATURE_FREQ_CAPTURE
+  freq_capture_report();
+#endif
+  task_report();
+  slice_sched_report();
+  rate_exec_report();
+#endif
+}
+
+#if FEATURE_TELEMETRY
+// A client coming or going shouldn't wait up to 30s for the next report, so the
+// telemetry also subscribes to those events (event_bus.c). Printing takes far too
+// long for the event handler: the subscriber only posts what happened to the
+// background task and the line is printed from there. Two posts can arrive as
+// one (see tasks.h), so par is a set of these bits.
+#define TELEMETRY_JOINED  BIT0
+#define TELEMETRY_LEFT    BIT1
+
+LOCAL sint8 telemetry_client = -1;
+
+LOCAL void ICACHE_FLASH_ATTR telemetry_task(uint32 par) {
+  os_printf("telemetry: station %s, %d clients (AIDs 0x%08x), state %d, heap %u free\n",
+            (par & TELEMETRY_JOINED) ? ((par & TELEMETRY_LEFT) ? "joined and left" : "joined") : "left",
+            clients, client_aids, app_fsm_state(), system_get_free_heap_size());
+}
+
+// Event bus subscriber (connects and disconnects only)
+void ICACHE_FLASH_ATTR telemetry_on_event(System_Event_t *event) {
+  if (telemetry_client < 0)
+    return;
+  task_post(TASK_PRIO_BACKGROUND, telemetry_client,
+            event->event == EVENT_SOFTAPMODE_STACONNECTED ? TELEMETRY_JOINED : TELEMETRY_LEFT);
+}
+#endif
+
 // Entry function ... execution starts here.  Note the use of attribute
 // ICACHE_FLASH_ATTR which directs the ESP to store the user code in flash
 // instead of RAM.
@@ -198,6 +664,12 @@ void ICACHE_FLASH_ATTR user_init (void) {
   // Initialize the GPIO sub-system
   gpio_init();  
 
+  // The task queues come first, a lot of what follows posts to them
+  task_init();
+#if FEATURE_TELEMETRY
+  telemetry_client = task_register(TASK_PRIO_BACKGROUND, telemetry_task);
+#endif
+
   // Set GPIO2 to be GPIO2 ... yeah it sounds stupid to do this but you
   // don't know how GPIO2 was previously configured ... it could have been
   // configured for something completely different
@@ -206,6 +678,53 @@ void ICACHE_FLASH_ATTR user_init (void) {
   // Set GPIO2 as output and set it to LOW
   gpio_output_set(0, BIT2, BIT2, 0);
 
+  // Self test while GPIO2 is still ours (before the sigma-delta gets it). The
+  // result shows up on the UART about POST_TIMER_MS later.
+#if FEATURE_POST
+  post_start();
+#endif
+
+  // Dimmable LED: hand GPIO2 to the sigma-delta modulator (LED off for now) and
+  // start following the ambient light
+#if FEATURE_ADC_LIGHT
+  sigma_delta_enable(ADC_LIGHT_SIGMA_DELTA_PRESCALE);
+  sigma_delta_set_target(0);
+  sigma_delta_attach(2);
+  adc_light_init();
+#endif
+
+  // IR LED
+#if FEATURE_IR_TX
+  ir_tx_init();
+#endif
+
+  // LED panel on the HSPI (rate_task_panel keeps it up to date)
+#if FEATURE_HSPI_OUT
+  hspi_out_init();
+#endif
+
+  // Start measuring the capture inputs (if this unit is set up to do that)
+#if FEATURE_FREQ_CAPTURE
+  freq_capture_init();
+#endif
+
+  // Check the MAC filter list before the first station shows up
+#if FEATURE_MAC_FILTER
+  mac_filter_init();
+#endif
+
+  // Coroutines and long jobs run from the task queues, set them up before anybody
+  // starts one
+  coro_init();
+  slice_sched_init();
+
+  // Start the periodic tasks
+  rate_exec_init();
+
+  // Everything starts in the BOOTING state, awake
+  app_fsm_init();
+  power_init();
+
   // And here is our system init done callback. Once the SoC has done its 
   // setup it will execute the function init_done_callback.
   system_init_done_cb(init_done_callback);
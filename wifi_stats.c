@@ -0,0 +1,42 @@
+// WiFi statistics ... see wifi_stats.h.
+
+#include "ets_sys.h"
+#include "osapi.h"
+#include "user_interface.h"
+#include "wifi_stats.h"
+
+LOCAL struct wifi_stats stats;
+
+// Event bus subscriber
+void ICACHE_FLASH_ATTR wifi_stats_on_event(System_Event_t *event) {
+  if (event->event >= EVENT_MAX)
+    return;
+
+  stats.events[event->event]++;
+  stats.last_event_us = system_get_time();
+
+  switch (event->event) {
+    case EVENT_SOFTAPMODE_STACONNECTED:
+      stats.clients++;
+      if (stats.clients > stats.clients_peak)
+        stats.clients_peak = stats.clients;
+      break;
+
+    case EVENT_SOFTAPMODE_STADISCONNECTED:
+      if (stats.clients > 0)
+        stats.clients--;
+      break;
+  }
+}
+
+const struct wifi_stats * ICACHE_FLASH_ATTR wifi_stats_get(void) {
+  return &stats;
+}
+
+void ICACHE_FLASH_ATTR wifi_stats_report(void) {
+  os_printf("wifi: %d clients (peak %d), %u connects, %u disconnects, %u probe requests\n",
+            stats.clients, stats.clients_peak,
+            stats.events[EVENT_SOFTAPMODE_STACONNECTED],
+            stats.events[EVENT_SOFTAPMODE_STADISCONNECTED],
+            stats.events[EVENT_SOFTAPMODE_PROBEREQRECVED]);
+}
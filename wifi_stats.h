@@ -0,0 +1,21 @@
+// WiFi statistics: how many of each SDK event we've seen, how many clients are
+// connected now and the most we've ever had at once. Fed by the event bus.
+
+#ifndef WIFI_STATS_H
+#define WIFI_STATS_H
+
+#include "c_types.h"
+#include "user_interface.h"
+
+struct wifi_stats {
+  uint32 events[EVENT_MAX];
+  uint32 last_event_us;     // system_get_time() of the last event
+  uint8 clients;
+  uint8 clients_peak;
+};
+
+void wifi_stats_on_event(System_Event_t *event);
+const struct wifi_stats *wifi_stats_get(void);
+void wifi_stats_report(void);
+
+#endif